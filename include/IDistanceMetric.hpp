@@ -7,6 +7,8 @@ Description: Header file for IDistanceMetric to define the interface for distanc
 */
 
 #pragma once
+#include <cstddef>
+#include <limits>
 #include <vector>
 #include <string>
 #include "metricFactory.hpp"
@@ -21,7 +23,29 @@ public:
     // Virtual destructor to ensure proper cleanup of derived classes
     virtual ~IDistanceMetric() = default;
 
-    virtual float compute(const std::vector<float> &features1, const std::vector<float> &features2) const = 0;
+    // Distance between two vectors of n floats, e.g. a query and one row of a contiguous feature matrix
+    virtual float compute(const float *features1, const float *features2, size_t n) const = 0;
+
+    // Distances from query to each of the n contiguous rows of dim floats in matrix, written to out[0 .. n).
+    // rowNorms optionally holds the Euclidean norm of every row (used by the cosine distance), or nullptr.
+    virtual void computeMany(const float *query, const float *matrix, size_t n, size_t dim, float *out,
+                             const float *rowNorms) const
+    {
+        (void)rowNorms;
+        for (size_t i = 0; i < n; ++i)
+            out[i] = compute(query, matrix + i * dim, dim);
+    }
+
+    // Distance between two feature vectors; INFINITY if their lengths differ (callers check and report
+    // dimension mismatches once, outside their loops)
+    virtual float compute(const std::vector<float> &features1, const std::vector<float> &features2) const
+    {
+        if (features1.size() != features2.size())
+        {
+            return std::numeric_limits<float>::infinity();
+        }
+        return compute(features1.data(), features2.data(), features1.size());
+    }
     virtual std::string type() { return MetricFactory::metricTypeToString(type_); }
 
 protected:
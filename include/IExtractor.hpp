@@ -8,19 +8,28 @@ Description: Declares the IExtractor interface for feature extraction.
 
 #pragma once
 
+#include "dbMetadata.hpp"
 #include "extractorFactory.hpp"
 #include "regionAnalyzer.hpp"
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <string>
 
 /*
 IExtractor is an abstract base class that defines the interface for feature extractors.
+Every extractor produces fixed-length vectors of dim() floats. The *Into entry points write into
+caller-owned storage of that length, so a caller that keeps one buffer per extractor extracts without
+allocating; the std::vector entry points size the vector and forward to them.
 */
 class IExtractor
 {
 public:
     virtual ~IExtractor() = default;
+
+    // Loads models and warms up so that the first extraction is not slow; returns 0 on success
+    virtual int initialize() { return 0; }
+
     virtual int extract(const char *imagePath, std::vector<float> *out) const
     {
         // Load the image from the given path
@@ -31,6 +40,34 @@ public:
     }
 
     virtual int extractMat(const cv::Mat &image, std::vector<float> *out) const = 0;
+
+    // Number of floats in a feature vector (0 when unknown, e.g. the model cannot be loaded)
+    virtual int dim() const { return 0; }
+
+    // Writes the feature vector of image into out[0 .. dim()); the default goes through extractMat
+    virtual int extractInto(const cv::Mat &image, float *out) const
+    {
+        std::vector<float> features;
+        if (!out || extractMat(image, &features) != 0 || static_cast<int>(features.size()) != dim())
+            return -1;
+        std::copy(features.begin(), features.end(), out);
+        return 0;
+    }
+
+    // Extracts one feature vector per image; extractors that can batch inference override this
+    virtual int extractBatch(const std::vector<cv::Mat> &images, std::vector<std::vector<float>> *out) const
+    {
+        if (!out)
+            return -1;
+        out->resize(images.size());
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            if (extractMat(images[i], &(*out)[i]) != 0)
+                return -1;
+        }
+        return 0;
+    }
+
     virtual int extractRegion(const RegionFeatures &region, std::vector<float> *out) const
     {
         (void)region;
@@ -38,8 +75,22 @@ public:
         return -1;
     }
 
+    // Writes the feature vector of a detected region into out[0 .. dim()); only region-based extractors support it
+    virtual int extractRegionInto(const RegionFeatures &region, float *out) const
+    {
+        (void)region;
+        (void)out;
+        return -1;
+    }
+
     virtual std::string type() const { return ExtractorFactory::extractorTypeToString(type_); }
 
+    // Side length of the square, rotation-normalized crop (utilities::prepEmbeddingImage) this extractor consumes
+    virtual int inputSize() const { return 224; }
+
+    // Metadata recorded in (and checked against) the feature database this extractor writes
+    virtual DbMetadata metadata() const { return {{"extractor", type()}}; }
+
 protected:
     ExtractorType type_;
     explicit IExtractor(ExtractorType type) : type_(type) {}
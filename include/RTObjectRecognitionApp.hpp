@@ -13,6 +13,7 @@ Description: Declares the RTObjectRecognitionApp class for real-time object reco
 #include <filesystem>
 #include <opencv2/opencv.hpp>
 #include "extractorFactory.hpp"
+#include "featureMatcher.hpp"
 #include "preProcessor.hpp"
 
 /*
@@ -23,6 +24,8 @@ struct AppState
 {
     bool baselineOn = false;
     bool cnnOn = false;
+    bool histOn = false;
+    bool hogOn = false;
     bool debugOn = false;
     bool showThresholdWindow = false;
     bool showCleanedWindow = false;
@@ -45,16 +48,27 @@ struct AppState
     float cnnDistance = 0.0f;
     float baselineUnknownThreshold = 1.3f;
     float cnnUnknownThreshold = 30.0f;
+    float histUnknownThreshold = 0.4f; // histogram intersection distance (1 - overlap)
+    float hogUnknownThreshold = 18.0f; // scaled Euclidean over the 324 HOG dimensions
+    // Label decision of the baseline, color histogram and HOG matches: nearest entry or a vote over matchK entries
+    LabelVote matchVote = MIN_DISTANCE;
+    size_t matchK = 5;
     std::vector<cv::Rect> predictedBoxes;
     std::vector<std::string> predictedTexts;
-    std::vector<std::string> cachedCnnLabels;
-    std::vector<float> cachedCnnDistances;
 
     bool recordingOn = false;
     cv::VideoWriter writer;
     double fps = 24.0;
-    int cnnIntervalFrames = 3; // run CNN every N frames
-    int maxCnnRegionsPerFrame = 2; // cap CNN inference count per frame
+    double cnnBudgetMs = 15.0; // CNN inference time granted per frame (see CnnScheduler)
+    double cnnCostMs = 0.0;    // current CNN cost estimate per job, for display
+    double cnnCacheHitRate = 0.0; // embedding cache hit rate, for display
+
+    // Cascade: the baseline decides confident matches, the CNN only ambiguous or unknown ones
+    bool cascadeOn = false;
+    float cascadeMinMargin = 0.3f;     // min baseline best/second-best (other label) distance margin
+    size_t cascadeBaselineDecided = 0; // region classifications settled by the baseline
+    size_t cascadeCnnDecided = 0;      // region classifications escalated to the CNN
+    bool cnnInt8 = false;      // the CNN model is INT8-quantized; it uses features_cnn_int8.csv
 
     std::filesystem::path resultsDir = "./results/";
     std::filesystem::path dataDir = "./data/";
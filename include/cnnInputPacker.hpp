@@ -0,0 +1,56 @@
+/*
+Claire Liu, Yu-Jing Wei
+cnnInputPacker.hpp
+
+Path: include/cnnInputPacker.hpp
+Description: Header file for cnnInputPacker.cpp to pack 8-bit images into normalized NCHW CNN input.
+*/
+
+#pragma once // Include guard
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+/*
+CnnInputPacker converts an 8-bit BGR (or gray/BGRA) image into the planar, normalized RGB float
+tensor expected by the CNN in a single pass. For every output row it bilinearly samples the two
+source rows it needs, folds (x/255 - mean)/std into one scale and bias per channel and writes the
+three planar float rows directly, replacing the resize -> cvtColor -> convertTo -> scatter chain.
+Sampling follows cv::resize(INTER_LINEAR) pixel-center conventions; results differ from that chain
+only by its intermediate 8-bit rounding (< 1 gray level before normalization).
+- setNormalization(mean, stdv): Sets the per-channel (R,G,B) mean/std in [0,1] units.
+- pack(src, outW, outH, dst): Writes 3*outH*outW floats to dst in CHW order. Lookup tables and
+                    row buffers are cached between calls, so repeated calls with the same
+                    source/output sizes do not allocate (the buffered rows themselves are
+                    refilled on every call). Returns false on unsupported input.
+*/
+class CnnInputPacker
+{
+public:
+    CnnInputPacker();
+
+    void setNormalization(const float mean[3], const float stdv[3]);
+    bool pack(const cv::Mat &src, int outW, int outH, float *dst);
+
+private:
+    void prepareTables(int srcW, int srcH, int outW, int outH, int cn);
+    void horizontalRow(const uchar *srcRow, float *planes);
+
+    // Folded normalization: out = pixel * scale + bias (per output plane R,G,B)
+    float scale_[3];
+    float bias_[3];
+
+    // Cached geometry for the current source/output sizes
+    int srcW_ = -1, srcH_ = -1, outW_ = -1, outH_ = -1, cn_ = -1;
+    bool identityX_ = false;
+    std::vector<int> xOfs_;   // per output x: byte offset of the left source pixel
+    std::vector<int> xOfs1_;  // per output x: byte offset of the right source pixel
+    std::vector<float> xW_;   // per output x: weight of the right source pixel
+    std::vector<int> yIdx_;   // per output y: top source row
+    std::vector<int> yIdx1_;  // per output y: bottom source row
+    std::vector<float> yW_;   // per output y: weight of the bottom source row
+
+    // Two horizontally-interpolated source rows, each stored as 3 planes of outW floats
+    std::vector<float> rowBuf_;
+    int bufRow_[2] = {-1, -1};
+};
@@ -0,0 +1,141 @@
+/*
+Claire Liu, Yu-Jing Wei
+cnnRunner.hpp
+
+Path: include/cnnRunner.hpp
+Description: Header file for cnnRunner.cpp to run CNN inference with ONNX Runtime or OpenCV DNN.
+*/
+
+#pragma once // Include guard
+
+#include "cnnInputPacker.hpp"
+#include "extractor.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+
+#if defined(ENABLE_ONNXRUNTIME)
+#include <onnxruntime/onnxruntime_cxx_api.h>
+#endif
+
+/*
+ICnnRunner is the inference backend behind CNNExtractor. A runner owns one loaded network and turns
+8-bit BGR (or gray/BGRA) crops into embeddings; 4-D (NxCxHxW) tap points with H*W > 1 are global-average-pooled
+per channel, so every backend produces the same embedding layout.
+- acquire(const CNNExtractor::Params &params): Returns the process-wide runner for the given parameters,
+                    creating it on first use so that every extractor sharing the same model, backend and
+                    thread settings also shares one network. params.backend selects "ort" (ONNX Runtime),
+                    "dnn" (OpenCV DNN) or "" (ONNX Runtime when built with it, OpenCV DNN otherwise).
+- infer(img, outVec): Runs inference on one image and writes the embedding into outVec. Returns 0 on success.
+- inferBatch(imgs, outVecs): Runs inference on several images; the default runs infer() per image.
+- warmup(runs): Runs the network runs times and returns the elapsed milliseconds.
+- loadedFromCache(): True when a cached optimized graph was loaded instead of optimizing the model.
+- backendName(): "ort" or "dnn".
+- inputSize(): Square input side. Models with fixed spatial dims use their own size; models exported
+                    with dynamic spatial dims use params.inputSize (224 when unset).
+- outputName(): Name of the model output used as the embedding (the tap point).
+- outputDim(): Embedding dimension.
+- precision(): "int8" for a quantized model, "fp32" otherwise (see modelPrecision()).
+- modelPrecision(modelPath): Detects INT8 quantization (dynamic, QDQ or QOperator) from the operators
+                    in the ONNX file. Quantized models need no other handling: both backends run them
+                    as is, with the same FP32 pre-processing and output.
+*/
+class ICnnRunner
+{
+public:
+    virtual ~ICnnRunner() = default;
+
+    static std::shared_ptr<ICnnRunner> acquire(const CNNExtractor::Params &params);
+    static std::string modelPrecision(const std::string &modelPath);
+
+    virtual int infer(const cv::Mat &img, std::vector<float> *outVec) = 0;
+    virtual int inferBatch(const std::vector<cv::Mat> &imgs, std::vector<std::vector<float>> *outVecs);
+    virtual double warmup(int runs) = 0;
+    virtual bool loadedFromCache() const { return false; }
+    virtual const char *backendName() const = 0;
+    int inputSize() const { return inputSize_; }
+    const std::string &outputName() const { return outputName_; }
+    size_t outputDim() const { return outputDim_; }
+    const std::string &precision() const { return precision_; }
+
+protected:
+    int inputSize_ = 224;
+    std::string outputName_;
+    size_t outputDim_ = 0;
+    std::string precision_ = "fp32";
+};
+
+#if defined(ENABLE_ONNXRUNTIME)
+/*
+OrtResNet18Runner owns an ONNX Runtime session together with preallocated input and output
+tensors that are bound to the session once through an Ort::IoBinding. Pre-processing writes
+the normalized NCHW image straight into the bound input buffer and the session writes its
+result into the bound output buffer, so steady-state inference performs no heap allocations.
+Graph optimization runs once per model; the optimized graph is cached in params.cacheDir.
+*/
+class OrtResNet18Runner : public ICnnRunner
+{
+public:
+    explicit OrtResNet18Runner(const CNNExtractor::Params &params);
+
+    int infer(const cv::Mat &img, std::vector<float> *outVec) override;
+    double warmup(int runs) override;
+    bool loadedFromCache() const override { return loadedFromCache_; }
+    const char *backendName() const override { return "ort"; }
+
+private:
+    static Ort::Env &env();
+    static Ort::SessionOptions sessionOptions(
+        const CNNExtractor::Params &params, bool preOptimized, const std::string &saveOptimizedTo);
+
+    std::unique_ptr<Ort::Session> session_;
+    std::unique_ptr<Ort::IoBinding> binding_;
+    Ort::MemoryInfo memInfo_{nullptr};
+    Ort::RunOptions runOptions_{nullptr};
+    std::string inputName_;
+
+    bool loadedFromCache_ = false;
+
+    // Bound input (1x3xHxW) and output buffers, allocated once in the constructor
+    std::vector<float> inputBuf_;
+    std::vector<float> outputBuf_;
+    size_t poolSize_ = 1; // spatial positions averaged per channel (1 = no pooling)
+    Ort::Value inputTensor_{nullptr};
+    Ort::Value outputTensor_{nullptr};
+
+    // Fused resize/normalize/NCHW kernel writing into inputBuf_
+    CnnInputPacker packer_;
+
+    // Serializes inference; the bound buffers are shared state
+    std::mutex mutex_;
+};
+#endif
+
+/*
+DnnResNet18Runner runs the same ONNX model with OpenCV DNN (cv::dnn::readNetFromONNX on the CPU
+backend), so CNN mode also works on hosts without ONNX Runtime. Batches of crops are packed with
+cv::dnn::blobFromImages and run in one forward pass; the per-channel ImageNet std, which
+blobFromImages cannot apply, is folded into the blob afterwards.
+*/
+class DnnResNet18Runner : public ICnnRunner
+{
+public:
+    explicit DnnResNet18Runner(const CNNExtractor::Params &params);
+
+    int infer(const cv::Mat &img, std::vector<float> *outVec) override;
+    int inferBatch(const std::vector<cv::Mat> &imgs, std::vector<std::vector<float>> *outVecs) override;
+    double warmup(int runs) override;
+    const char *backendName() const override { return "dnn"; }
+
+private:
+    cv::Mat forward(const std::vector<cv::Mat> &imgs);
+
+    cv::dnn::Net net_;
+    std::vector<cv::Mat> single_; // reused one-element batch for infer()
+
+    // Serializes inference; cv::dnn::Net is not thread-safe
+    std::mutex mutex_;
+};
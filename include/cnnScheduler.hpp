@@ -0,0 +1,82 @@
+/*
+Claire Liu, Yu-Jing Wei
+cnnScheduler.hpp
+
+Path: include/cnnScheduler.hpp
+Description: Header file for cnnScheduler.cpp to choose which regions get CNN inference within a latency budget.
+*/
+
+#pragma once // Include guard
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "cnnWorker.hpp"
+
+/*
+CnnScheduler decides which tracked regions are sent to the CNN worker each frame. Every frame adds
+budgetMs of inference time to a credit (capped so idle frames cannot bank an unbounded burst) and every
+submitted job spends the current estimate of one inference, an exponential moving average of the measured
+job cost. Candidates are ranked by priority class, then by area (large first):
+    0. never classified, or starving (no fresh result for starvationFrames, oldest first)
+    1. stale (result at least staleFrames old)
+    2. low confidence (failed, a failure newer than the match, or distance above lowConfidenceRatio * unknown
+       threshold)
+    3. everything else (refreshed only with spare budget)
+Ages count from the latest attempt, failed or not. Tracks with a job in flight or an attempt from the current
+frame are not scheduled.
+- observe(trackId, result): Feeds the latest mailbox result of a track; a result not seen before updates
+                    the track state and the cost estimate.
+- schedule(candidates, frameId, unknownThreshold): Returns the track ids to submit, in priority order.
+- forget(trackId): Releases the state of a track that is gone.
+- costEstimateMs(): Current per-inference cost estimate.
+*/
+class CnnScheduler
+{
+public:
+    struct Params
+    {
+        double budgetMs;          // inference time granted per frame
+        double initialCostMs;     // cost estimate before the first measurement
+        double emaAlpha;          // weight of a new cost measurement
+        int staleFrames;          // result age that makes a track stale
+        int starvationFrames;     // result age that promotes a track to the top class
+        float lowConfidenceRatio; // fraction of the unknown threshold above which a match is low-confidence
+
+        Params(double budgetMs_ = 15.0, double initialCostMs_ = 20.0, double emaAlpha_ = 0.2,
+               int staleFrames_ = 15, int starvationFrames_ = 60, float lowConfidenceRatio_ = 0.8f)
+            : budgetMs(budgetMs_), initialCostMs(initialCostMs_), emaAlpha(emaAlpha_),
+              staleFrames(staleFrames_), starvationFrames(starvationFrames_),
+              lowConfidenceRatio(lowConfidenceRatio_) {}
+    };
+
+    struct Candidate
+    {
+        int trackId;
+        int area;
+        bool pending; // a job for this track is queued or running
+    };
+
+    explicit CnnScheduler(const Params &params = Params());
+
+    void observe(int trackId, const CnnResult &result);
+    std::vector<int> schedule(const std::vector<Candidate> &candidates, size_t frameId, float unknownThreshold);
+    void forget(int trackId);
+    double costEstimateMs() const { return costMs_; }
+
+private:
+    struct TrackState
+    {
+        bool classified = false;
+        bool ok = false;
+        float distance = 0.0f;
+        size_t resultFrame = 0;
+        size_t failedFrame = 0; // failed attempt newer than resultFrame (0 = none)
+        size_t firstSeen = 0;
+    };
+
+    Params params_;
+    double costMs_;
+    double creditMs_ = 0.0;
+    std::unordered_map<int, TrackState> tracks_;
+};
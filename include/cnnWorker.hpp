@@ -0,0 +1,116 @@
+/*
+Claire Liu, Yu-Jing Wei
+cnnWorker.hpp
+
+Path: include/cnnWorker.hpp
+Description: Header file for cnnWorker.cpp to run CNN classification off the capture/display thread.
+*/
+
+#pragma once // Include guard
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "IExtractor.hpp"
+#include "embeddingCache.hpp"
+#include "metricFactory.hpp"
+#include "regionAnalyzer.hpp"
+
+/*
+CnnResult holds the latest CNN classification of one track.
+- ok: Extraction and matching succeeded (label/distance are valid).
+- label / distance: Best database match.
+- frameId: Frame the crop was taken from; the caller derives the result age from it.
+- failedFrameId: Frame of a failed job newer than frameId (0 = none). A failure does not replace a valid
+                    match in the mailbox; the match is kept and the failure is recorded here.
+- cached: The latest job took its embedding from the cache (no inference ran).
+- costMs: Wall time of the latest job (crop, embedding and match), failed or not.
+*/
+struct CnnResult
+{
+    bool ok = false;
+    std::string label;
+    float distance = 0.0f;
+    size_t frameId = 0;
+    size_t failedFrameId = 0;
+    bool cached = false;
+    float costMs = 0.0f;
+};
+
+/*
+CnnWorker runs CNN embedding extraction and database matching on dedicated threads so the capture and
+display loop never blocks on ONNX Runtime. Jobs (a frame plus the region to crop from it) enter a bounded
+queue; each job is cropped with utilities::prepEmbeddingImage, embedded and matched on a worker thread and
+its result is published to a per-track mailbox that always holds the latest result. An EmbeddingCache in front
+of the extractor returns the stored embedding when a region has not changed since it was last embedded.
+- submit(trackId, frameId, frame, region): Queues a job. A queued job for the same track is replaced by the
+                    newer one; when the queue is full the oldest job is dropped. The frame is shared, not
+                    copied, so the caller must not write into it afterwards.
+- latest(trackId, out): Copies the latest result of the track. Returns false if there is none yet.
+- pending(trackId): True while a job for the track is queued or running.
+- forget(trackId): Releases the mailbox entry of a track that is gone and drops its queued job; a job of the
+                    track that is already running finishes without publishing.
+- cacheStats(): Hit/miss counters of the embedding cache.
+*/
+class CnnWorker
+{
+public:
+    struct Params
+    {
+        size_t queueCapacity;          // max queued jobs
+        int threads;                   // worker threads
+        EmbeddingCache::Params cache;  // embedding cache (capacity 0 disables it)
+
+        Params(size_t queueCapacity_ = 4, int threads_ = 1,
+               const EmbeddingCache::Params &cache_ = EmbeddingCache::Params())
+            : queueCapacity(queueCapacity_), threads(threads_), cache(cache_) {}
+    };
+
+    CnnWorker(std::shared_ptr<IExtractor> extractor, std::string dbPath, MetricType metricType,
+              const Params &params = Params());
+    ~CnnWorker();
+
+    CnnWorker(const CnnWorker &) = delete;
+    CnnWorker &operator=(const CnnWorker &) = delete;
+
+    void submit(int trackId, size_t frameId, const cv::Mat &frame, const RegionFeatures &region);
+    bool latest(int trackId, CnnResult &out) const;
+    bool pending(int trackId) const;
+    void forget(int trackId);
+    EmbeddingCache::Stats cacheStats() const { return cache_.stats(); }
+
+private:
+    struct Job
+    {
+        int trackId;
+        size_t frameId;
+        cv::Mat frame;
+        RegionFeatures region;
+    };
+
+    void loop();
+    CnnResult classify(const Job &job);
+
+    std::shared_ptr<IExtractor> extractor_;
+    std::string dbPath_;
+    MetricType metricType_;
+    Params params_;
+    EmbeddingCache cache_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> queue_;
+    std::unordered_map<int, int> inFlight_; // track id -> jobs being processed
+    std::unordered_map<int, CnnResult> results_;
+    std::unordered_set<int> live_; // tracks submitted and not forgotten since
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
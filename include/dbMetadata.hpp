@@ -0,0 +1,32 @@
+/*
+Claire Liu, Yu-Jing Wei
+dbMetadata.hpp
+
+Path: include/dbMetadata.hpp
+Description: Header file for dbMetadata.cpp to read and write feature database metadata.
+*/
+
+#pragma once // Include guard
+
+#include <map>
+#include <string>
+
+/*
+DbMetadata holds key=value pairs describing how a feature database was produced
+(extractor, model, tap layer, dimension, ...). It is stored as the first line of the
+feature CSV in the form "#meta,key=value,key=value"; readers skip lines starting with '#'.
+*/
+using DbMetadata = std::map<std::string, std::string>;
+
+// This namespace contains helpers for reading, writing and comparing database metadata.
+namespace dbMetadata
+{
+    // Read the metadata header of a feature CSV. Returns false if the file has no header.
+    bool read(const std::string &csvPath, DbMetadata &meta);
+
+    // Truncate the feature CSV and write the metadata header line. Returns 0 on success.
+    int write(const std::string &csvPath, const DbMetadata &meta);
+
+    // Check that every key present in both maps has the same value; reason receives the first mismatch.
+    bool compatible(const DbMetadata &stored, const DbMetadata &expected, std::string *reason = nullptr);
+}
@@ -0,0 +1,41 @@
+/*
+Claire Liu, Yu-Jing Wei
+descriptorKernels.hpp
+
+Path: include/descriptorKernels.hpp
+Description: Header file for descriptorKernels.cpp, the vectorized per-row kernels behind the cheap descriptors.
+*/
+
+#pragma once // Include guard
+
+#include <opencv2/opencv.hpp>
+
+// This namespace contains row kernels shared by the image-based extractors. Each kernel processes one
+// row of 8-bit pixels, with a SIMD main loop (OpenCV universal intrinsics) and a scalar tail that
+// computes the same values.
+namespace descriptorKernels
+{
+    // Near-black pixels (B+G+R below this) have no reliable chromaticity and count as neutral gray
+    constexpr float kDarkSum = 24.0f;
+
+    /*
+    accumulateRgChroma adds each BGR pixel of a row to a bins x bins rg-chromaticity histogram
+    (r = R/(R+G+B) selects the row, g = G/(R+G+B) the column), skipping pixels whose mask byte is 0.
+    - @param bgr Row of width interleaved 8-bit BGR pixels.
+    - @param mask Row of width mask bytes, or nullptr to count every pixel.
+    - @param hist bins * bins counters.
+    */
+    void accumulateRgChroma(const uchar *bgr, const uchar *mask, int width, int bins, float *hist);
+
+    /*
+    orientedGradientsRow computes the central-difference gradient of one row of a float image padded by
+    one pixel on every side and splits each gradient magnitude between the two nearest of bins unsigned
+    orientation bins (0-180 degrees, bin centres at (k + 0.5) * 180 / bins).
+    - @param above, row, below Padded rows y-1, y and y+1; pixel x of the unpadded row is row[x + 1].
+    - @param gx, gy Scratch rows of width floats.
+    - @param bin0 Receives the lower bin of each pixel, unwrapped: use (bin0 mod bins) and (bin0 + 1) mod bins.
+    - @param w0, w1 Receive the magnitude share of the lower and the upper bin.
+    */
+    void orientedGradientsRow(const float *above, const float *row, const float *below, int width, int bins,
+                              float *gx, float *gy, int *bin0, float *w0, float *w1);
+}
@@ -0,0 +1,389 @@
+/*
+Claire Liu, Yu-Jing Wei
+distanceKernels.hpp
+
+Path: include/distanceKernels.hpp
+Description: Compile-time specialized, vectorized distance kernels for scanning a contiguous feature matrix.
+*/
+
+#pragma once // Include guard
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <opencv2/core/hal/intrin.hpp>
+
+/*
+distanceKernels holds the distance functions as small policy structs instead of virtual calls, so a scan over
+the database is one inlined loop per (metric, dimension) pair:
+- SSD: sum of squared differences.
+- ScaledSSD: scaled Euclidean distance between pre-whitened vectors (rows and query already divided by the
+             per-dimension std-dev), i.e. the square root of their SSD.
+- Cosine: 1 - cosine similarity (1 when either vector is zero); the query norm is computed once per query.
+- HistIntersection: 1 - sum of element-wise minima of two normalized histograms.
+- Dot: inner product (cosineMany turns it into the cosine distance with cached row norms).
+Each policy has `template <int D> float distance(x, y, n)`; D > 0 fixes the length at compile time, D == 0 uses
+the runtime length n. The reductions run on OpenCV universal intrinsics at the widest width the build enables
+(NEON on ARM; on x86, SSE unless the Makefile's ARCH_FLAGS enables AVX2), with two vector accumulators and a
+scalar tail.
+scan(metric, query, rows, count, dim, visit) calls visit(i, distance) for every row, dispatching on dim once:
+the descriptor sizes used in this project (9 shape, 64 color histogram, 324 HOG, 512 and 1000 CNN) get their own
+specialization, any other size runs the generic loop. computeMany and cosineMany write the distances to an array.
+dotBatch is the many-queries counterpart: a cache-blocked SGEMM of the query matrix against the row matrix, from which
+euclideanBatch (sqrt(|q|^2 + |x|^2 - 2 q.x)) and cosineBatch (1 - q.x / (|q| |x|)) derive all query-row distances.
+*/
+namespace distanceKernels
+{
+    // Length of a vector, fixed at compile time when D > 0
+    template <int D>
+    inline int length(int n) { return D > 0 ? D : n; }
+
+    // Element-wise accumulation steps of the reductions, in vector and scalar form
+    struct SquaredDiffOp
+    {
+#if CV_SIMD
+        cv::v_float32 operator()(const cv::v_float32 &acc, const cv::v_float32 &a, const cv::v_float32 &b) const
+        {
+            const cv::v_float32 d = cv::v_sub(a, b);
+            return cv::v_fma(d, d, acc);
+        }
+#endif
+        float operator()(float acc, float a, float b) const
+        {
+            const float d = a - b;
+            return acc + d * d;
+        }
+    };
+
+    struct ProductOp
+    {
+#if CV_SIMD
+        cv::v_float32 operator()(const cv::v_float32 &acc, const cv::v_float32 &a, const cv::v_float32 &b) const
+        {
+            return cv::v_fma(a, b, acc);
+        }
+#endif
+        float operator()(float acc, float a, float b) const { return acc + a * b; }
+    };
+
+    struct MinOp
+    {
+#if CV_SIMD
+        cv::v_float32 operator()(const cv::v_float32 &acc, const cv::v_float32 &a, const cv::v_float32 &b) const
+        {
+            return cv::v_add(acc, cv::v_min(a, b));
+        }
+#endif
+        float operator()(float acc, float a, float b) const { return acc + std::min(a, b); }
+    };
+
+    // Sums op over the element pairs of x and y
+    template <int D, class Op>
+    inline float reduce(const float *x, const float *y, int n, Op op)
+    {
+        const int len = length<D>(n);
+        int k = 0;
+        float sum = 0.0f;
+#if CV_SIMD
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        if (len >= lanes)
+        {
+            cv::v_float32 acc0 = cv::vx_setzero_f32(), acc1 = cv::vx_setzero_f32();
+            for (; k + 2 * lanes <= len; k += 2 * lanes)
+            {
+                acc0 = op(acc0, cv::vx_load(x + k), cv::vx_load(y + k));
+                acc1 = op(acc1, cv::vx_load(x + k + lanes), cv::vx_load(y + k + lanes));
+            }
+            for (; k + lanes <= len; k += lanes)
+                acc0 = op(acc0, cv::vx_load(x + k), cv::vx_load(y + k));
+            sum = cv::v_reduce_sum(cv::v_add(acc0, acc1));
+        }
+#endif
+        for (; k < len; ++k)
+            sum = op(sum, x[k], y[k]);
+        return sum;
+    }
+
+    struct SSD
+    {
+        template <int D>
+        float distance(const float *x, const float *y, int n) const { return reduce<D>(x, y, n, SquaredDiffOp()); }
+    };
+
+    struct ScaledSSD
+    {
+        template <int D>
+        float distance(const float *x, const float *y, int n) const { return std::sqrt(reduce<D>(x, y, n, SquaredDiffOp())); }
+    };
+
+    struct HistIntersection
+    {
+        template <int D>
+        float distance(const float *x, const float *y, int n) const { return 1.0f - reduce<D>(x, y, n, MinOp()); }
+    };
+
+    struct Dot
+    {
+        template <int D>
+        float distance(const float *x, const float *y, int n) const { return reduce<D>(x, y, n, ProductOp()); }
+    };
+
+    struct Cosine
+    {
+        // Norm of the vector passed as x to distance (the query), or a negative value to compute it per call
+        float xNorm = -1.0f;
+
+        Cosine() = default;
+        Cosine(const float *query, int n) : xNorm(std::sqrt(reduce<0>(query, query, n, ProductOp()))) {}
+
+        template <int D>
+        float distance(const float *x, const float *y, int n) const
+        {
+            const float nx = (xNorm >= 0.0f) ? xNorm : std::sqrt(reduce<D>(x, x, n, ProductOp()));
+            const float ny = std::sqrt(reduce<D>(y, y, n, ProductOp()));
+            if (nx == 0.0f || ny == 0.0f)
+                return 1.0f;
+            return 1.0f - reduce<D>(x, y, n, ProductOp()) / (nx * ny);
+        }
+    };
+
+    // Scans count contiguous rows of length D (or dim when D == 0) and reports each distance to visit
+    template <int D, class Metric, class Visitor>
+    inline void scanFixed(const Metric &metric, const float *query, const float *rows, size_t count, int dim,
+                          Visitor &visit)
+    {
+        const size_t stride = static_cast<size_t>(length<D>(dim));
+        const float *row = rows;
+        for (size_t i = 0; i < count; ++i, row += stride)
+            visit(i, metric.template distance<D>(query, row, dim));
+    }
+
+    // Scans count contiguous rows of dim floats, picking the specialization for dim once
+    template <class Metric, class Visitor>
+    inline void scan(const Metric &metric, const float *query, const float *rows, size_t count, int dim,
+                     Visitor &&visit)
+    {
+        switch (dim)
+        {
+        case 9:
+            scanFixed<9>(metric, query, rows, count, dim, visit);
+            break;
+        case 64:
+            scanFixed<64>(metric, query, rows, count, dim, visit);
+            break;
+        case 324:
+            scanFixed<324>(metric, query, rows, count, dim, visit);
+            break;
+        case 512:
+            scanFixed<512>(metric, query, rows, count, dim, visit);
+            break;
+        case 1000:
+            scanFixed<1000>(metric, query, rows, count, dim, visit);
+            break;
+        default:
+            scanFixed<0>(metric, query, rows, count, dim, visit);
+            break;
+        }
+    }
+
+    // Writes the distance from query to each of count contiguous rows of dim floats into out
+    template <class Metric>
+    inline void computeMany(const Metric &metric, const float *query, const float *rows, size_t count, int dim,
+                            float *out)
+    {
+        scan(metric, query, rows, count, dim, [out](size_t i, float d) { out[i] = d; });
+    }
+
+    // Cosine distances with precomputed row norms: one dot product per row
+    inline void cosineMany(const float *query, const float *rows, const float *rowNorms, size_t count, int dim,
+                           float *out)
+    {
+        const float queryNorm = std::sqrt(reduce<0>(query, query, dim, ProductOp()));
+        computeMany(Dot(), query, rows, count, dim, out);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float denom = queryNorm * rowNorms[i];
+            out[i] = (denom == 0.0f) ? 1.0f : 1.0f - out[i] / denom;
+        }
+    }
+
+    // Euclidean norm of each of count contiguous rows of dim floats
+    inline void rowNorms(const float *rows, size_t count, int dim, float *out)
+    {
+        const float *row = rows;
+        for (size_t i = 0; i < count; ++i, row += dim)
+            out[i] = std::sqrt(reduce<0>(row, row, dim, ProductOp()));
+    }
+
+    // Dimensions summed between two checks of boundedSSD
+    constexpr int kAbandonBlock = 16;
+
+    /*
+    boundedSSD sums the squared differences of x and y block by block (kAbandonBlock dimensions) and gives up
+    as soon as the partial sum exceeds limit, since partial sums only grow (early abandoning). Returns the sum,
+    or the partial sum (> limit) when it gave up. The blocked order rounds differently from SSD, so callers that
+    need the exact kernel value recompute it for the rows that survive.
+    */
+    inline float boundedSSD(const float *x, const float *y, int n, float limit)
+    {
+        float sum = 0.0f;
+        for (int k = 0; k < n; k += kAbandonBlock)
+        {
+            sum += reduce<0>(x + k, y + k, std::min(kAbandonBlock, n - k), SquaredDiffOp());
+            if (sum > limit)
+                break;
+        }
+        return sum;
+    }
+
+    // Squared Euclidean norm of each of count contiguous rows of dim floats
+    inline void rowSquaredNorms(const float *rows, size_t count, int dim, float *out)
+    {
+        const float *row = rows;
+        for (size_t i = 0; i < count; ++i, row += dim)
+            out[i] = reduce<0>(row, row, dim, ProductOp());
+    }
+
+    /*
+    dotTile is the register-blocked micro-kernel of dotBatch: the Q x R dot products between Q query rows and
+    R database rows (all dim floats long) are accumulated in Q * R vector registers, so each loaded vector is
+    used R (query) or Q (row) times. Results go to out[q * outStride + r].
+    */
+    template <int Q, int R>
+    inline void dotTile(const float *queries, const float *rows, int dim, float *out, size_t outStride)
+    {
+        float sums[Q][R] = {};
+        int k = 0;
+#if CV_SIMD
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        cv::v_float32 acc[Q][R];
+        for (int q = 0; q < Q; ++q)
+            for (int r = 0; r < R; ++r)
+                acc[q][r] = cv::vx_setzero_f32();
+        for (; k + lanes <= dim; k += lanes)
+        {
+            cv::v_float32 y[R];
+            for (int r = 0; r < R; ++r)
+                y[r] = cv::vx_load(rows + r * dim + k);
+            for (int q = 0; q < Q; ++q)
+            {
+                const cv::v_float32 x = cv::vx_load(queries + q * dim + k);
+                for (int r = 0; r < R; ++r)
+                    acc[q][r] = cv::v_fma(x, y[r], acc[q][r]);
+            }
+        }
+        for (int q = 0; q < Q; ++q)
+            for (int r = 0; r < R; ++r)
+                sums[q][r] = cv::v_reduce_sum(acc[q][r]);
+#endif
+        for (; k < dim; ++k)
+            for (int q = 0; q < Q; ++q)
+                for (int r = 0; r < R; ++r)
+                    sums[q][r] += queries[q * dim + k] * rows[r * dim + k];
+        for (int q = 0; q < Q; ++q)
+            for (int r = 0; r < R; ++r)
+                out[q * outStride + r] = sums[q][r];
+    }
+
+    // Query rows and database rows per micro-kernel tile (4 x 2 keeps the 8 accumulators, both row vectors
+    // and the query vector within the 16 vector registers of x86-64 SSE/AVX2 and well within NEON)
+    constexpr int kTileQueries = 4;
+    constexpr int kTileRows = 2;
+    // Bytes of database rows per cache block: the block stays in L2 while every query tile passes over it
+    constexpr size_t kBlockBytes = 128 * 1024;
+
+    // Runs the micro-kernel for a possibly partial tile of q (1-4) query rows and r (1-2) database rows
+    inline void dotTileAny(int q, int r, const float *queries, const float *rows, int dim, float *out, size_t outStride)
+    {
+        switch ((q - 1) * kTileRows + (r - 1))
+        {
+        case 0:
+            dotTile<1, 1>(queries, rows, dim, out, outStride);
+            break;
+        case 1:
+            dotTile<1, 2>(queries, rows, dim, out, outStride);
+            break;
+        case 2:
+            dotTile<2, 1>(queries, rows, dim, out, outStride);
+            break;
+        case 3:
+            dotTile<2, 2>(queries, rows, dim, out, outStride);
+            break;
+        case 4:
+            dotTile<3, 1>(queries, rows, dim, out, outStride);
+            break;
+        case 5:
+            dotTile<3, 2>(queries, rows, dim, out, outStride);
+            break;
+        case 6:
+            dotTile<4, 1>(queries, rows, dim, out, outStride);
+            break;
+        default:
+            dotTile<4, 2>(queries, rows, dim, out, outStride);
+            break;
+        }
+    }
+
+    /*
+    dotBatch computes out = queries * rows^T, i.e. out[q * rowCount + r] is the dot product of query q and row r
+    (both matrices row-major with dim floats per row). The rows are processed in blocks of about kBlockBytes; each
+    block is swept by all query tiles before moving on, so the database is streamed from memory once per batch
+    instead of once per query.
+    */
+    inline void dotBatch(const float *queries, size_t queryCount, const float *rows, size_t rowCount, int dim, float *out)
+    {
+        const size_t rowBytes = static_cast<size_t>(dim) * sizeof(float);
+        const size_t blockRows = std::max<size_t>(kTileRows, kBlockBytes / std::max<size_t>(1, rowBytes));
+        for (size_t r0 = 0; r0 < rowCount; r0 += blockRows)
+        {
+            const size_t r1 = std::min(rowCount, r0 + blockRows);
+            for (size_t q = 0; q < queryCount; q += kTileQueries)
+            {
+                const int tileQueries = static_cast<int>(std::min<size_t>(kTileQueries, queryCount - q));
+                const float *queryTile = queries + q * dim;
+                for (size_t r = r0; r < r1; r += kTileRows)
+                {
+                    const int tileRows = static_cast<int>(std::min<size_t>(kTileRows, r1 - r));
+                    dotTileAny(tileQueries, tileRows, queryTile, rows + r * dim, dim, out + q * rowCount + r, rowCount);
+                }
+            }
+        }
+    }
+
+    /*
+    euclideanBatch writes the Euclidean distance between every query and every row into out (queryCount x rowCount)
+    from one dotBatch: sqrt(|q|^2 + |x|^2 - 2 q.x), clamped at 0 against rounding. The expansion loses precision
+    when |q|^2 and |x|^2 are large compared to the distance, so callers should pass centered data.
+    */
+    inline void euclideanBatch(const float *queries, size_t queryCount, const float *rows, const float *rowSquaredNorms,
+                               size_t rowCount, int dim, float *out)
+    {
+        dotBatch(queries, queryCount, rows, rowCount, dim, out);
+        for (size_t q = 0; q < queryCount; ++q)
+        {
+            const float *query = queries + q * dim;
+            const float querySquaredNorm = reduce<0>(query, query, dim, ProductOp());
+            float *line = out + q * rowCount;
+            for (size_t r = 0; r < rowCount; ++r)
+                line[r] = std::sqrt(std::max(0.0f, querySquaredNorm + rowSquaredNorms[r] - 2.0f * line[r]));
+        }
+    }
+
+    // Cosine distance between every query and every row (out is queryCount x rowCount), from one dotBatch
+    inline void cosineBatch(const float *queries, size_t queryCount, const float *rows, const float *rowNorms,
+                            size_t rowCount, int dim, float *out)
+    {
+        dotBatch(queries, queryCount, rows, rowCount, dim, out);
+        for (size_t q = 0; q < queryCount; ++q)
+        {
+            const float *query = queries + q * dim;
+            const float queryNorm = std::sqrt(reduce<0>(query, query, dim, ProductOp()));
+            float *line = out + q * rowCount;
+            for (size_t r = 0; r < rowCount; ++r)
+            {
+                const float denom = queryNorm * rowNorms[r];
+                line[r] = (denom == 0.0f) ? 1.0f : 1.0f - line[r] / denom;
+            }
+        }
+    }
+}
@@ -23,9 +23,10 @@ struct SumSquaredDistance : public IDistanceMetric
     // Constructor to initialize the metric type
     SumSquaredDistance(MetricType mt) : IDistanceMetric(mt) {}
     // Override the compute function to calculate the SSD between two vectors
-    float compute(const std::vector<float> &v1,
-                  const std::vector<float> &v2)
-        const override;
+    using IDistanceMetric::compute;
+    float compute(const float *v1, const float *v2, size_t n) const override;
+    void computeMany(const float *query, const float *matrix, size_t n, size_t dim, float *out,
+                     const float *rowNorms) const override;
 };
 
 /*
@@ -38,22 +39,25 @@ struct HistogramIntersection : public IDistanceMetric
     // Constructor to initialize the metric type
     HistogramIntersection(MetricType mt) : IDistanceMetric(mt) {}
     // Override the compute function to calculate the histogram intersection distance between two vectors
-    float compute(const std::vector<float> &v1,
-                  const std::vector<float> &v2)
-        const override;
+    using IDistanceMetric::compute;
+    float compute(const float *v1, const float *v2, size_t n) const override;
+    void computeMany(const float *query, const float *matrix, size_t n, size_t dim, float *out,
+                     const float *rowNorms) const override;
 };
 
 /*
     Cosine Distance metric
     Computes the cosine distance between two feature vectors.
     Lower values indicate more similar features.
+    computeMany costs one dot product per row when the row norms are supplied.
 */
 struct CosDistance : public IDistanceMetric
 {
     // Constructor to initialize the metric type
     CosDistance(MetricType mt) : IDistanceMetric(mt) {}
     // Override the compute function to calculate the cosine distance between two vectors
-    float compute(const std::vector<float> &v1,
-                  const std::vector<float> &v2)
-        const override;
+    using IDistanceMetric::compute;
+    float compute(const float *v1, const float *v2, size_t n) const override;
+    void computeMany(const float *query, const float *matrix, size_t n, size_t dim, float *out,
+                     const float *rowNorms) const override;
 };
@@ -0,0 +1,83 @@
+/*
+Claire Liu, Yu-Jing Wei
+embeddingCache.hpp
+
+Path: include/embeddingCache.hpp
+Description: Header file for embeddingCache.cpp to reuse CNN embeddings of unchanged regions.
+*/
+
+#pragma once // Include guard
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/*
+EmbeddingCache is a bounded LRU cache of CNN embeddings keyed by what a region looks like and where it is.
+The appearance key is a 64-bit perceptual hash (DCT hash) of the 32x32 grayscale embedding crop; the geometry
+key is the region's oriented bounding box. A lookup hits when an entry lies within maxHamming bits of the hash
+and its box has nearly the same centre, size and angle, so a static object is embedded once instead of every
+time it is re-classified. At most capacity embeddings are kept; the least recently used one is evicted.
+Safe to use from several threads.
+- makeKey(crop, obb): Builds the key of an embedding crop (any size, 1/3/4 channels) and its box.
+- lookup(key, out): Copies the embedding of a matching entry into out and refreshes it. Returns false on a miss.
+- insert(key, embedding): Stores an embedding, evicting the least recently used entry when full.
+- stats(): Hit, miss and eviction counters; Stats::hitRate() is hits / lookups.
+*/
+class EmbeddingCache
+{
+public:
+    struct Params
+    {
+        size_t capacity;        // max cached embeddings (0 disables the cache)
+        int maxHamming;         // max differing hash bits for a hit
+        float maxCenterShift;   // max centre shift as a fraction of the larger box side
+        float maxSizeChange;    // max relative change of each box side
+        float maxAngleDeg;      // max box angle change in degrees
+
+        Params(size_t capacity_ = 256, int maxHamming_ = 4, float maxCenterShift_ = 0.1f,
+               float maxSizeChange_ = 0.1f, float maxAngleDeg_ = 10.0f)
+            : capacity(capacity_), maxHamming(maxHamming_), maxCenterShift(maxCenterShift_),
+              maxSizeChange(maxSizeChange_), maxAngleDeg(maxAngleDeg_) {}
+    };
+
+    struct Key
+    {
+        uint64_t hash = 0;
+        cv::RotatedRect box;
+    };
+
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t size = 0;
+
+        double hitRate() const { return (hits + misses) ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+    };
+
+    explicit EmbeddingCache(const Params &params = Params());
+
+    static Key makeKey(const cv::Mat &crop, const cv::RotatedRect &box);
+    bool lookup(const Key &key, std::vector<float> &out);
+    void insert(const Key &key, const std::vector<float> &embedding);
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        Key key;
+        std::vector<float> embedding;
+    };
+
+    bool matches(const Key &a, const Key &b) const;
+
+    Params params_;
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_; // most recently used first
+    Stats stats_;
+};
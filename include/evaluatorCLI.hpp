@@ -0,0 +1,62 @@
+/*
+  Claire Liu, Yu-Jing Wei
+  evaluatorCLI.hpp
+
+  Path: include/evaluatorCLI.hpp
+  Description: Header file for evaluatorCLI.cpp to parse command-line
+                arguments for the extractor evaluator.
+*/
+#pragma once // Include guard
+
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+/*
+EvaluatorCLI class to parse command-line arguments for the evaluator.
+Struct Args:
+    - inputDir: The directory containing labelled sample images (label = file name prefix before '_').
+    - extractorStr: The extractor type to evaluate.
+    - modelPath: The CNN model path.
+    - layers: CNN outputs (tap points) to compare; an empty entry means the model's default output.
+    - inputSize: CNN input resolution for models with dynamic spatial dims (0 = default).
+    - backends: CNN inference backends to compare (ort, dnn); empty = the default backend.
+    - batchSize: Batch size used for the batched-throughput column.
+    - intraOpThreads / interOpThreads: ONNX Runtime thread counts (0 = default).
+    - compareModelPath: INT8-quantized model compared against the FP32 model (latency, accuracy, top-1 agreement).
+    - knn: Number of nearest samples the leave-one-out label is voted from (default 1).
+    - vote: Label vote over those samples: min, majority or weighted (see LabelVote).
+    - benchMetrics: Run the distance-metric microbenchmark instead of an extractor evaluation.
+    - benchSearch: Run the matcher search-index benchmark instead of an extractor evaluation.
+    - benchPacker: Run the CNN input-packer benchmark (fused kernel vs. the OpenCV chain) instead of an evaluation.
+    - showHelp: A flag indicating whether to display the help message.
+public:
+    - parse(int argc, char *argv[]): Parses the command-line arguments and returns an Args struct.
+    - printUsage(const char *prog): Prints the usage information for the program.
+*/
+class EvaluatorCLI
+{
+public:
+    struct Args
+    {
+        std::string inputDir;
+        std::string extractorStr;
+        std::string modelPath;
+        std::vector<std::string> layers;
+        int inputSize = 0;
+        std::vector<std::string> backends;
+        int batchSize = 8;
+        int intraOpThreads = 0;
+        int interOpThreads = 0;
+        std::string compareModelPath;
+        int knn = 1;
+        std::string vote = "min";
+        bool benchMetrics = false;
+        bool benchSearch = false;
+        bool benchPacker = false;
+        bool showHelp = false;
+    };
+
+    static Args parse(int argc, char *argv[]);
+    static void printUsage(const char *prog);
+};
@@ -9,15 +9,25 @@ Description: Header file for extractor.cpp to extract features from images.
 #pragma once
 
 #include "IExtractor.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <opencv2/core.hpp>
 
+class ICnnRunner;
+
 /*
 BaselineExtractor: A simple feature extractor that computes basic geometric and
     shape features from the input image or region.
 CNNExtractor: A more complex feature extractor that uses a Convolutional Neural
     Network (CNN) to extract high-level features from the input image or region.
+ColorHistExtractor: A cheap color descriptor, the normalized rg-chromaticity histogram of the
+    object pixels of the rotation-normalized crop, matched with histogram intersection.
+HOGExtractor: A histogram-of-oriented-gradients descriptor of the small rotation-normalized
+    grayscale crop; captures outline and internal edges at a tiny fraction of the CNN cost.
 */
 struct BaselineExtractor : public IExtractor
 {
@@ -25,11 +35,131 @@ struct BaselineExtractor : public IExtractor
     // Override the extractMat function to implement the feature extraction logic for the baseline extractor
     int extractMat(const cv::Mat &image, std::vector<float> *featureVector) const override;
     int extractRegion(const RegionFeatures &region, std::vector<float> *featureVector) const override;
+    int extractRegionInto(const RegionFeatures &region, float *out) const override;
+    int dim() const override { return kShapeFeatureDim; }
+    DbMetadata metadata() const override;
 };
 
 struct CNNExtractor : public IExtractor
 {
-    CNNExtractor(ExtractorType type) : IExtractor(type) {}
+    /*
+    Params holds the ONNX model path, the embedding tap point, the input resolution and the ONNX Runtime
+    thread configuration. outputName selects the model output used as the embedding (empty = first output);
+    4-D feature maps are global-average-pooled to one value per channel. inputSize is the square input side
+    for models exported with dynamic spatial dims (0 = 224); models with a fixed input use their own size.
+    cacheDir is where the ONNX Runtime optimized graph is persisted (empty = no cache) and warmupRuns the
+    number of inferences initialize() runs before the first real frame. backend selects the inference
+    engine: "ort" (ONNX Runtime), "dnn" (OpenCV DNN) or "" (ONNX Runtime when built with it, else OpenCV DNN).
+    fromEnv() reads RTOR_CNN_MODEL, RTOR_CNN_OUTPUT, RTOR_CNN_INPUT_SIZE, RTOR_CNN_INTRA_THREADS,
+    RTOR_CNN_INTER_THREADS, RTOR_CNN_CACHE_DIR, RTOR_CNN_WARMUP and RTOR_CNN_BACKEND.
+    */
+    struct Params
+    {
+        std::string modelPath;
+        std::string outputName;
+        int inputSize;
+        int intraOpThreads;
+        int interOpThreads;
+        std::string cacheDir;
+        int warmupRuns;
+        std::string backend;
+
+        Params(std::string modelPath_ = "./data/resnet18-v2-7.onnx", std::string outputName_ = "",
+               int inputSize_ = 0, int intraOpThreads_ = 1, int interOpThreads_ = 1,
+               std::string cacheDir_ = "./data/ort_cache", int warmupRuns_ = 1, std::string backend_ = "")
+            : modelPath(std::move(modelPath_)), outputName(std::move(outputName_)), inputSize(inputSize_),
+              intraOpThreads(intraOpThreads_), interOpThreads(interOpThreads_),
+              cacheDir(std::move(cacheDir_)), warmupRuns(warmupRuns_), backend(std::move(backend_)) {}
+
+        static Params fromEnv();
+    };
+
+    explicit CNNExtractor(ExtractorType type, const Params &params = Params::fromEnv())
+        : IExtractor(type), params_(params) {}
+    // Loads the model (through the optimized-model cache) and runs the warm-up inferences
+    int initialize() override;
     // Override the extractMat function to implement the feature extraction logic for the ResNet extractor
     int extractMat(const cv::Mat &image, std::vector<float> *featureVector) const override;
+    // Embeds several crops at once (one forward pass on the OpenCV DNN backend)
+    int extractBatch(const std::vector<cv::Mat> &images, std::vector<std::vector<float>> *featureVectors) const override;
+    // Input resolution of the loaded model (loads the model if needed)
+    int inputSize() const override;
+    // Embedding dimension of the loaded model (loads the model if needed; 0 if it cannot be loaded)
+    int dim() const override;
+    // Records the model file, tap layer, input resolution and embedding dimension (loads the model if needed)
+    DbMetadata metadata() const override;
+
+private:
+    std::shared_ptr<ICnnRunner> runner() const;
+
+    Params params_;
+    // Runner shared with other extractors using the same params, resolved on first use
+    mutable std::shared_ptr<ICnnRunner> runner_;
+    mutable std::mutex runnerMutex_;
+};
+
+struct ColorHistExtractor : public IExtractor
+{
+    /*
+    Params holds the histogram resolution (bins x bins rg-chromaticity bins) and the side of the
+    rotation-normalized crop the histogram is computed on. Object pixels are separated from the
+    white background of the crop with Otsu's threshold; when fewer than minForeground of the pixels
+    are foreground (no usable split), every pixel is counted.
+    */
+    struct Params
+    {
+        int bins;
+        int inputSize;
+        float minForeground;
+
+        Params(int bins_ = 8, int inputSize_ = 64, float minForeground_ = 0.05f)
+            : bins(bins_), inputSize(inputSize_), minForeground(minForeground_) {}
+    };
+
+    explicit ColorHistExtractor(ExtractorType type, const Params &params = Params())
+        : IExtractor(type), params_(params) {}
+    // Computes the normalized bins*bins histogram of an 8-bit BGR (or gray/BGRA) crop
+    int extractMat(const cv::Mat &image, std::vector<float> *featureVector) const override;
+    int extractInto(const cv::Mat &image, float *out) const override;
+    int dim() const override { return params_.bins * params_.bins; }
+    int inputSize() const override { return params_.inputSize; }
+    // Records the histogram resolution, input size and dimension
+    DbMetadata metadata() const override;
+
+private:
+    Params params_;
+};
+
+struct HOGExtractor : public IExtractor
+{
+    /*
+    Params holds the side of the rotation-normalized crop, the cell size in pixels and the number of
+    unsigned orientation bins. Cell histograms are grouped into overlapping 2x2-cell blocks (stride one
+    cell) that are L2-Hys normalized, so the descriptor has (side/cell - 1)^2 * 4 * bins dimensions
+    (324 with the defaults).
+    */
+    struct Params
+    {
+        int inputSize;
+        int cellSize;
+        int bins;
+
+        Params(int inputSize_ = 64, int cellSize_ = 16, int bins_ = 9)
+            : inputSize(inputSize_), cellSize(cellSize_), bins(bins_) {}
+    };
+
+    explicit HOGExtractor(ExtractorType type, const Params &params = Params())
+        : IExtractor(type), params_(params) {}
+    // Computes the block-normalized HOG descriptor of an 8-bit crop (resized to inputSize if needed)
+    int extractMat(const cv::Mat &image, std::vector<float> *featureVector) const override;
+    int extractInto(const cv::Mat &image, float *out) const override;
+    int dim() const override;
+    int inputSize() const override { return params_.inputSize; }
+    // Records the crop size, cell size, bin count and dimension
+    DbMetadata metadata() const override;
+
+private:
+    int cellsPerSide() const { return params_.cellSize > 0 ? params_.inputSize / params_.cellSize : 0; }
+
+    Params params_;
 };
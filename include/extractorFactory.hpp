@@ -21,6 +21,8 @@ enum ExtractorType
 {
     BASELINE,
     CNN,
+    COLOR_HIST,
+    HOG,
     UNKNOWN_EXTRACTOR
 };
 
@@ -31,7 +33,7 @@ based on the specified ExtractorType.
                     shared pointer to an IExtractor instance corresponding to that type.
                     If the type is unrecognized, it returns nullptr.
 - stringToExtractorType(const char *typeStr): A utility method that converts a string
-                    representation of an extractor type (e.g., "baseline", "cnn") to
+                    representation of an extractor type (e.g., "baseline", "cnn", "color_hist", "hog") to
                     the corresponding ExtractorType enum value. If the string does not match
                     any known extractor type, it returns UNKNOWN_EXTRACTOR.
 - extractorTypeToString(ExtractorType type): A utility method that converts an ExtractorType enum
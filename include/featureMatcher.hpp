@@ -9,13 +9,121 @@ Description: Header file for featureMatcher.cpp to
 
 #pragma once // Include guard
 
+#include "dbMetadata.hpp"
 #include "extractorFactory.hpp"
+#include "hnswIndex.hpp"
+#include "ivfIndex.hpp"
 #include "metricFactory.hpp"
 #include "matchResult.hpp"
+#include "pqCodec.hpp"
+
+#include <opencv2/core.hpp>
+
+/*
+Enumeration of the ways the k nearest database entries of a query are aggregated into one label.
+- MIN_DISTANCE: The label with the nearest entry wins (plain nearest neighbour); score is the negated distance.
+- MAJORITY_VOTE: The label with the most entries among the k wins; ties go to the label with the nearer entry.
+- WEIGHTED_VOTE: Each entry votes with weight 1 / distance, so near entries count more than far ones.
+- UNKNOWN_VOTE: A default value for unrecognized vote names.
+*/
+enum LabelVote
+{
+    MIN_DISTANCE,
+    MAJORITY_VOTE,
+    WEIGHTED_VOTE,
+    UNKNOWN_VOTE
+};
+
+/*
+Enumeration of the ways FeatureMatcher::matchKnn can search a database (selected per database).
+- LINEAR_SCAN: Computes the distance to every row.
+- PRUNED_SCAN: Exact search for the SSD metric that skips rows with LAESA pivot bounds and abandons partial
+    distances early; same results as LINEAR_SCAN. Other metrics fall back to the linear scan.
+- HNSW_INDEX: Approximate search for the SSD metric through an HNSW graph over the whitened rows, persisted as
+    <db>.hnsw next to the CSV (see FeatureMatcher::setSearchIndex). Other metrics fall back to the linear scan.
+- IVF_INDEX: Approximate search for the SSD metric that measures only the rows of the nprobe k-means cells nearest
+    to the query, persisted as <db>.ivf. Cheaper to build than HNSW_INDEX. Other metrics fall back to the linear scan.
+- PQ_INDEX: Approximate search for the SSD metric over product-quantized codes of the rows (M bytes per row),
+    persisted with the labels as <db>.pq. Without re-ranking only the codes are kept in memory, and a current
+    <db>.pq is loaded without parsing the CSV; the SSD metric is then the only one available.
+- UNKNOWN_INDEX: A default value for unrecognized index names.
+*/
+enum SearchIndex
+{
+    LINEAR_SCAN,
+    PRUNED_SCAN,
+    HNSW_INDEX,
+    IVF_INDEX,
+    PQ_INDEX,
+    UNKNOWN_INDEX
+};
+
+/*
+SearchStats counts the work of the searches on one database:
+- queries: Searches run.
+- rows: Database rows those searches covered.
+- pivotPruned: Rows skipped by the pivot lower bound, without reading their features.
+- abandoned: Rows whose partial distance passed the bound before the last dimension.
+- notVisited: Rows an approximate index never measured.
+- prunedFraction(): Share of rows skipped any of these ways.
+*/
+struct SearchStats
+{
+    size_t queries = 0;
+    size_t rows = 0;
+    size_t pivotPruned = 0;
+    size_t abandoned = 0;
+    size_t notVisited = 0;
+
+    void add(const SearchStats &other)
+    {
+        queries += other.queries;
+        rows += other.rows;
+        pivotPruned += other.pivotPruned;
+        abandoned += other.abandoned;
+        notVisited += other.notVisited;
+    }
+    double prunedFraction() const
+    {
+        return rows ? static_cast<double>(pivotPruned + abandoned + notVisited) / static_cast<double>(rows) : 0.0;
+    }
+};
+
+/*
+SearchIndexParams tunes the search structure of one database (see FeatureMatcher::setSearchIndex):
+- hnsw: Graph degree and candidate list sizes of HNSW_INDEX (efSearch trades recall for query time).
+- ivf: Cell count and k-means settings of IVF_INDEX (nprobe trades recall for query time).
+- pq: Code size and training of PQ_INDEX; rerank > 0 keeps the exact rows and re-measures that many candidates.
+*/
+struct SearchIndexParams
+{
+    HnswIndex::Params hnsw;
+    IvfIndex::Params ivf;
+    PqCodec::Params pq;
+};
 
 /*
 FeatureMatcher class provides a static method to match features
 between a query image and a database of images.
+- matchKnn(targetFeatures, dbPath, metricType, k, vote, decision): Finds the k nearest entries in one pass
+                    (bounded heap, no sort of the database) and aggregates their labels with vote; match is
+                    matchKnn with k = 1 and MIN_DISTANCE.
+- vote(neighbours, vote, decision): Aggregates a nearest-first neighbour list (e.g. one query of matchBatch)
+                    into the winning label, its runner-up and their score margin.
+- matchBatch(queries, dbPath, metricType, k, results): Matches a batch of queries (one per matrix row) in one
+                    pass over the database, computing the distances as a blocked matrix product, and returns
+                    the k nearest entries of each query.
+- setSearchIndex(dbPath, index, params): Selects the search structure of the database at dbPath (see SearchIndex);
+                    searchStats(dbPath) reports the share of rows the searches pruned.
+- buildIndex(dbPath, index, params): Selects the search structure and builds it now (HNSW / IVF / PQ: writes <db>.hnsw / <db>.ivf / <db>.pq),
+                    e.g. from pretrain, instead of on the first match.
+- preload(dbPath, labels, rows): Installs in-memory features as the cached database of dbPath.
+- setMatchLogging(enabled): Turns the per-query match log lines on or off.
+- requireMetadata(dbPath, expected): Registers the extractor setup the database at dbPath must have been
+                    built with. The stored header is checked whenever the database is (re)loaded; a
+                    mismatching database (e.g. other layer or input resolution) is rejected until the file changes.
+- enroll(dbPath, savedPath, features): Appends a sample to the database file and updates the cached
+                    copy, its normalization statistics and its search structure in place, without reloading the file.
 */
 class FeatureMatcher
 {
@@ -25,4 +133,41 @@ public:
         const std::string &dbPath,
         MetricType metricType,
         MatchResult &bestMatch);
+
+    static bool matchKnn(
+        const std::vector<float> &targetFeatures,
+        const std::string &dbPath,
+        MetricType metricType,
+        size_t k,
+        LabelVote vote,
+        MatchResult &decision);
+
+    static bool vote(const std::vector<MatchResult> &neighbours, LabelVote vote, MatchResult &decision);
+
+    static std::string labelVoteToString(LabelVote vote);
+    static LabelVote stringToLabelVote(const std::string &name);
+
+    static bool matchBatch(
+        const cv::Mat &queries,
+        const std::string &dbPath,
+        MetricType metricType,
+        size_t k,
+        std::vector<std::vector<MatchResult>> &results);
+
+    static void setSearchIndex(const std::string &dbPath, SearchIndex index,
+                               const SearchIndexParams &params = SearchIndexParams());
+    static bool buildIndex(const std::string &dbPath, SearchIndex index,
+                           const SearchIndexParams &params = SearchIndexParams());
+    static SearchStats searchStats(const std::string &dbPath);
+    static void resetSearchStats(const std::string &dbPath);
+    static std::string searchIndexToString(SearchIndex index);
+    static SearchIndex stringToSearchIndex(const std::string &name);
+
+    static bool preload(const std::string &dbPath, const std::vector<std::string> &labels,
+                        const std::vector<std::vector<float>> &rows);
+    static void setMatchLogging(bool enabled);
+
+    static void requireMetadata(const std::string &dbPath, const DbMetadata &expected);
+
+    static int enroll(const std::string &dbPath, const std::string &savedPath, const std::vector<float> &features);
 };
@@ -0,0 +1,44 @@
+/*
+Claire Liu, Yu-Jing Wei
+featureStats.hpp
+
+Path: include/featureStats.hpp
+Description: Header file for featureStats.cpp, the per-dimension statistics behind every feature standardization.
+*/
+
+#pragma once // Include guard
+
+#include <cstddef>
+#include <vector>
+
+/*
+FeatureStats keeps the running mean and sum of squared deviations of each dimension of a set of feature vectors,
+updated one row at a time with Welford's method, which stays accurate where a plain sum of squares cancels (columns
+with a large mean). It is the one standardization shared by the matcher's whitening, the IVF cells and the PQ
+codebooks, so all three agree on the numerics.
+- reset(dim): Empties the statistics for vectors of dim floats.
+- add(row) / addRows(rows, count): Folds in one row / count row-major rows.
+- mean(): Mean of each dimension.
+- sigma(k): Population standard deviation of dimension k.
+- invStd(k): 1 / sigma(k), or 1 for a nearly-constant dimension (sigma <= 1e-6) so its weight cannot explode.
+- standardization(mean, invStd): Writes the mean and invStd of every dimension as floats.
+*/
+class FeatureStats
+{
+public:
+    void reset(int dim);
+    void add(const float *row);
+    void addRows(const float *rows, size_t count);
+
+    int dim() const { return static_cast<int>(mean_.size()); }
+    size_t count() const { return count_; }
+    const std::vector<double> &mean() const { return mean_; }
+    double sigma(int k) const;
+    float invStd(int k) const;
+    void standardization(std::vector<float> &meanOut, std::vector<float> &invStdOut) const;
+
+private:
+    size_t count_ = 0;
+    std::vector<double> mean_;
+    std::vector<double> m2_; // sum of squared deviations from the mean
+};
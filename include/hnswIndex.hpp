@@ -0,0 +1,89 @@
+/*
+Claire Liu, Yu-Jing Wei
+hnswIndex.hpp
+
+Path: include/hnswIndex.hpp
+Description: Header file for hnswIndex.cpp, an HNSW graph for approximate nearest-neighbour search.
+*/
+
+#pragma once // Include guard
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+HnswIndex is a hierarchical navigable small-world graph (Malkov & Yashunin) over squared L2 distances. Every row
+is a node on layer 0, and a geometrically shrinking random subset also sits on layers 1, 2, ...
+A query descends greedily from the single top entry point. On layer 0 it runs a best-first search that keeps the
+ef nearest nodes seen, so it measures a small share of the rows.
+The graph holds only the links. The row vectors stay with the caller (row-major, dim floats, contiguous) and are
+passed to every call, so one graph can serve several copies of a database whose rows are a prefix of each other.
+search() and insert() may run concurrently, from different threads.
+- build(rows, count, dim, threads): Builds the graph of rows 0..count-1, inserting from several threads.
+- insert(rows, count, dim): Adds the rows size()..count-1 (incremental insertion, e.g. after an enrollment).
+- search(rows, count, dim, query, ef, out): Fills out with up to ef (distance, row) pairs, nearest first.
+    Only rows below count are visited. Returns the number of distances computed.
+- save(path, fingerprint) / load(path, dim, fingerprint): Binary persistence. fingerprint identifies the rows
+    the graph was built from, so the caller can detect a stale file.
+*/
+class HnswIndex
+{
+public:
+    struct Params
+    {
+        size_t M;              // links per node on the upper layers (2 * M on layer 0)
+        size_t efConstruction; // candidates kept while inserting a node
+        size_t efSearch;       // candidates kept by a query (raised to k when smaller)
+        unsigned seed;         // seed of the random layer draws
+
+        Params(size_t M_ = 16, size_t efConstruction_ = 200, size_t efSearch_ = 64, unsigned seed_ = 100)
+            : M(M_), efConstruction(efConstruction_), efSearch(efSearch_), seed(seed_) {}
+    };
+
+    explicit HnswIndex(const Params &params = Params());
+
+    void build(const float *rows, size_t count, int dim, unsigned threads = 0);
+    void insert(const float *rows, size_t count, int dim);
+    size_t search(const float *rows, size_t count, int dim, const float *query, size_t ef,
+                  std::vector<std::pair<float, uint32_t>> &out) const;
+    size_t size() const;
+    const Params &params() const { return params_; }
+
+    bool save(const std::string &path, uint64_t fingerprint) const;
+    bool load(const std::string &path, int dim, uint64_t &fingerprint);
+
+private:
+    using Candidate = std::pair<float, uint32_t>; // (squared distance, node)
+
+    uint32_t *links(uint32_t node, int level);
+    const uint32_t *links(uint32_t node, int level) const;
+    size_t maxLinks(int level) const { return level == 0 ? 2 * params_.M : params_.M; }
+    void addNode(const float *rows, uint32_t node, bool locked);
+    void growTo(size_t count);
+    void searchLayer(const float *rows, size_t count, const float *query, uint32_t entry, float entryDistance,
+                     size_t ef, int level, bool locked, std::vector<Candidate> &found, size_t &computed) const;
+    void selectNeighbours(const float *rows, std::vector<Candidate> &candidates, size_t max) const;
+    void copyLinks(uint32_t node, int level, bool locked, std::vector<uint32_t> &out) const;
+
+    // Striped node locks: the links of node n are guarded by nodeLocks_[n % kLockStripes] during a build
+    static constexpr size_t kLockStripes = 1024;
+
+    Params params_;
+    int dim_ = 0;
+    std::vector<uint8_t> levels_;              // top layer of each node
+    std::vector<uint32_t> links0_;             // layer-0 links: per node a count followed by 2 * M slots
+    std::vector<std::vector<uint32_t>> upper_; // layers 1..level of each node, M + 1 slots per layer
+    uint32_t entry_ = 0;
+    int maxLevel_ = -1;
+    std::mt19937 rng_;
+    mutable std::shared_mutex mutex_; // shared by searches, exclusive for build, insert and load
+    std::mutex entryMutex_;           // entry point and top layer during a build
+    mutable std::array<std::mutex, kLockStripes> nodeLocks_;
+};
@@ -0,0 +1,74 @@
+/*
+Claire Liu, Yu-Jing Wei
+ivfIndex.hpp
+
+Path: include/ivfIndex.hpp
+Description: Header file for ivfIndex.cpp, an inverted-file (IVF) index with a k-means coarse quantizer.
+*/
+
+#pragma once // Include guard
+
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+/*
+IvfIndex partitions rows into cells with k-means. It keeps the cell centroids and a posting list per cell, the
+ids of the rows nearest to that centroid. A query measures only the rows of the nprobe cells whose centroids
+are nearest to it. Like HnswIndex it keeps no row vectors: the caller passes them to build and insert, and
+measures the candidate rows itself. Rows and queries are passed raw; the index standardizes them with the
+per-dimension mean and std-dev frozen at build time, and the centroids live in that space, so the cells stay
+valid however the caller's own statistics move as rows are added. Distances to centroids are squared L2.
+probe() and insert() may run concurrently, from different threads.
+- build(rows, count, dim): Freezes the standardization, trains the centroids on a sample of the rows (cv::kmeans,
+    k-means++ seeding) and assigns every row to its nearest centroid, spread over OpenCV's worker threads.
+- insert(rows, count, dim): Assigns the rows size()..count-1 to their nearest centroid (e.g. after an enrollment).
+- trainedRows(): Rows the centroids were trained on; the caller retrains when size() has grown well past it.
+- probe(query, count, nprobe, out): Fills out with the ids below count of the rows in the nprobe nearest cells.
+- save(path, fingerprint) / load(path, dim, fingerprint): Binary persistence (standardization, centroids and
+    posting lists).
+*/
+class IvfIndex
+{
+public:
+    struct Params
+    {
+        size_t lists;        // cells (0 = sqrt of the row count)
+        size_t nprobe;       // cells a query visits
+        int iterations;      // k-means iterations
+        size_t trainPerList; // training rows sampled per cell (all rows when there are fewer)
+
+        Params(size_t lists_ = 0, size_t nprobe_ = 8, int iterations_ = 20, size_t trainPerList_ = 64)
+            : lists(lists_), nprobe(nprobe_), iterations(iterations_), trainPerList(trainPerList_) {}
+    };
+
+    explicit IvfIndex(const Params &params = Params());
+
+    void build(const float *rows, size_t count, int dim);
+    void insert(const float *rows, size_t count, int dim);
+    void probe(const float *query, size_t count, size_t nprobe, std::vector<uint32_t> &out) const;
+    size_t size() const;
+    size_t lists() const;
+    size_t trainedRows() const;
+    const Params &params() const { return params_; }
+
+    bool save(const std::string &path, uint64_t fingerprint) const;
+    bool load(const std::string &path, int dim, uint64_t &fingerprint);
+
+private:
+    void standardize(const float *row, float *out) const;
+    void assign(const float *rows, size_t first, size_t count, std::vector<uint32_t> &cells) const;
+
+    Params params_;
+    int dim_ = 0;
+    size_t rows_ = 0;
+    size_t trained_ = 0;                      // rows at the last build
+    std::vector<float> mean_;                 // standardization frozen at build time
+    std::vector<float> invStd_;
+    std::vector<float> centroids_;            // lists x dim, standardized
+    std::vector<float> centroidSquaredNorms_; // for the batched assignment
+    std::vector<std::vector<uint32_t>> postings_;
+    mutable std::shared_mutex mutex_; // shared by probes, exclusive for build, insert and load
+};
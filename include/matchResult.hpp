@@ -7,6 +7,7 @@ Description: Header file for MatchResult struct to store matching results.
 */
 
 #pragma once
+#include <limits>
 #include <string>
 
 /*
@@ -17,6 +18,13 @@ operation between a query image and a database image. It contains:
     the query image based on the computed distance.
 - distance: A float that represents the computed distance between the feature vector
     of the query image and the feature vector of the matched image in the database.
+- secondDistance: The distance of the closest database entry with a different label
+    (infinity when the database holds a single label).
+- secondLabel: The runner-up label ("" when the database holds a single label).
+- score / secondScore: Label scores of a k-NN vote (see FeatureMatcher::vote): votes, summed
+    weights, or the negated nearest distance of the label and of the runner-up.
+- margin(): secondDistance - distance; a small margin means the match is ambiguous.
+- voteMargin(): score - secondScore, the same ambiguity measure on the vote's own scale.
 */
 struct MatchResult
 {
@@ -26,4 +34,13 @@ struct MatchResult
     std::string filename;
     // The distance value representing the similarity between the query image and the matched image
     float distance;
+    // Distance of the closest entry whose label differs from label
+    float secondDistance = std::numeric_limits<float>::infinity();
+    // Runner-up label and the vote scores of both labels
+    std::string secondLabel;
+    float score = 0.0f;
+    float secondScore = -std::numeric_limits<float>::infinity();
+
+    float margin() const { return secondDistance - distance; }
+    float voteMargin() const { return score - secondScore; }
 };
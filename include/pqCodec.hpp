@@ -0,0 +1,81 @@
+/*
+Claire Liu, Yu-Jing Wei
+pqCodec.hpp
+
+Path: include/pqCodec.hpp
+Description: Header file for pqCodec.cpp, a product-quantization codec for compressed feature storage.
+*/
+
+#pragma once // Include guard
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+/*
+PqCodec compresses feature vectors with product quantization (Jegou et al.). Vectors are first standardized per
+dimension with the mean and standard deviation of the training rows, frozen at training time. They are then
+split into M consecutive sub-vectors. Each sub-vector is replaced by the 8-bit index of its nearest centroid
+among the 256 of that subspace, so a row costs M bytes instead of 4 * dim.
+The squared L2 distance between a query and a code is approximated by asymmetric distance computation (ADC):
+the query stays exact, its distances to the centroids of every subspace are tabulated once, and each code
+then costs M table lookups.
+- train(rows, count, dim): Learns the standardization and the M codebooks (cv::kmeans per subspace, subspaces
+    trained in parallel) from a sample of the rows.
+- encode(rows, count, codes): Writes the M-byte code of each row (count x M bytes).
+- lookupTable(query, table): Fills the M x 256 table of squared distances from the standardized query to every
+    centroid.
+- adc(table, codes, count, out): Approximate squared distances of count codes from one table.
+- subspacesFor(dim): The M that train uses for vectors of dim floats (to check a codec read from disk).
+- trainedRows() / centroids(): Rows the codec was trained from and centroids per subspace (fewer than 256 when
+    it saw fewer rows); the caller retrains a codec its database has outgrown.
+- write(out) / read(in, dim): Binary persistence of the codebooks (the caller stores the codes).
+*/
+class PqCodec
+{
+public:
+    struct Params
+    {
+        size_t subspaces; // M (0 = dim / 8); each subspace has 256 centroids
+        int iterations;   // k-means iterations per subspace
+        size_t trainRows; // rows sampled for training (all rows when there are fewer)
+        size_t rerank;    // candidates re-ranked with the exact vectors (0 = none: only the codes are kept)
+
+        Params(size_t subspaces_ = 0, int iterations_ = 15, size_t trainRows_ = 16384, size_t rerank_ = 0)
+            : subspaces(subspaces_), iterations(iterations_), trainRows(trainRows_), rerank(rerank_) {}
+    };
+
+    static constexpr size_t kCentroids = 256;
+
+    explicit PqCodec(const Params &params = Params());
+
+    void train(const float *rows, size_t count, int dim);
+    void encode(const float *rows, size_t count, uint8_t *codes) const;
+    void lookupTable(const float *query, float *table) const;
+    void adc(const float *table, const uint8_t *codes, size_t count, float *out) const;
+
+    bool trained() const { return dim_ > 0; }
+    int dim() const { return dim_; }
+    size_t codeSize() const { return bounds_.empty() ? 0 : bounds_.size() - 1; }
+    size_t subspacesFor(int dim) const;
+    size_t trainedRows() const { return trainedRows_; }
+    size_t centroids() const { return centroids_; }
+    const Params &params() const { return params_; }
+
+    bool write(std::ostream &out) const;
+    bool read(std::istream &in, int dim);
+
+private:
+    void standardize(const float *row, float *out) const;
+
+    Params params_;
+    int dim_ = 0;
+    size_t centroids_ = 0;     // centroids per subspace (fewer than 256 only for tiny training sets)
+    size_t trainedRows_ = 0;   // rows passed to train
+    std::vector<int> bounds_;  // subspace m covers dimensions bounds_[m] .. bounds_[m + 1] - 1
+    std::vector<float> mean_;  // per-dimension standardization, frozen at training
+    std::vector<float> invStd_;
+    std::vector<float> codebooks_; // subspace m: kCentroids x width floats at offset kCentroids * bounds_[m]
+};
@@ -20,6 +20,13 @@ Struct Args:
     - inputDir: The directory containing input images.
     - extractorStr: The extractor type to use.
     - outputPath: The path to save the extracted features.
+    - modelPath: The CNN model path.
+    - layerName: The CNN output (tap point) used as the embedding.
+    - inputSize: CNN input resolution for models with dynamic spatial dims (0 = default).
+    - backend: CNN inference backend (ort, dnn); empty = default.
+    - intraOpThreads / interOpThreads: ONNX Runtime thread counts for the CNN extractor (0 = default).
+    - int8ModelPath: INT8-quantized CNN model; when set, the input images also build a second, INT8 database.
+    - indexStr: Search index built and saved next to the output database (hnsw, ivf, pq); empty = none.
     - showHelp: A flag indicating whether to display the help message.
 public:
     - parse(int argc, char *argv[]): Parses the command-line arguments and returns an Args struct.
@@ -34,6 +41,13 @@ public:
         std::string extractorStr;
         std::string outputPath;
         std::string modelPath;
+        std::string layerName;
+        int inputSize = 0;
+        std::string backend;
+        int intraOpThreads = 0;
+        int interOpThreads = 0;
+        std::string int8ModelPath;
+        std::string indexStr;
         bool showHelp = false;
     };
 
@@ -42,7 +56,8 @@ public:
         std::string &dirname,
         ExtractorType &extractorType,
         std::string &outputBase,
-        std::string *modelPath = nullptr);
+        std::string *modelPath = nullptr,
+        Args *parsedArgs = nullptr);
     static Args parse(int argc, char *argv[]);
     static void printUsage(const char *prog);
 };
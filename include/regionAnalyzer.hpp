@@ -96,4 +96,8 @@ private:
       float &minE2, float &maxE2);
 };
 
+// Length of the shape feature vector: percent filled, aspect ratio and the 7 Hu moments
+constexpr int kShapeFeatureDim = 9;
+
 std::vector<double> getShapeFeatureVector(const RegionFeatures &r);
+void writeShapeFeatures(const RegionFeatures &r, float *out);
@@ -0,0 +1,53 @@
+/*
+Claire Liu, Yu-Jing Wei
+regionTracker.hpp
+
+Path: include/regionTracker.hpp
+Description: Header file for regionTracker.cpp to keep stable ids for detected regions across frames.
+*/
+
+#pragma once // Include guard
+
+#include <cstddef>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/*
+RegionTracker assigns a stable track id to each detected region so that per-object state (such as the
+latest CNN result) survives the reordering of regions between frames. Boxes are associated greedily to
+the nearest track centre within a gate proportional to the box size; unmatched boxes start new tracks
+and tracks unseen for more than maxMissedFrames are dropped.
+- update(boxes, frameId): Returns the track id of each box, in the same order as boxes.
+- takeDropped(): Returns (and clears) the ids of tracks dropped since the last call.
+*/
+class RegionTracker
+{
+public:
+    struct Params
+    {
+        float gate;          // max centre distance as a fraction of the larger box diagonal
+        int maxMissedFrames; // frames a track may go unseen before it is dropped
+
+        Params(float gate_ = 0.5f, int maxMissedFrames_ = 5)
+            : gate(gate_), maxMissedFrames(maxMissedFrames_) {}
+    };
+
+    explicit RegionTracker(const Params &params = Params());
+
+    const std::vector<int> &update(const std::vector<cv::Rect> &boxes, size_t frameId);
+    std::vector<int> takeDropped();
+
+private:
+    struct Track
+    {
+        int id;
+        cv::Rect box;
+        size_t lastSeen;
+    };
+
+    Params params_;
+    std::vector<Track> tracks_;
+    std::vector<int> ids_;
+    std::vector<int> dropped_;
+    int nextId_ = 0;
+};
@@ -0,0 +1,704 @@
+/*
+Claire Liu, Yu-Jing Wei
+evaluator.cpp
+
+Path: src/offline/evaluator.cpp
+Description: Measures extractor latency and leave-one-out accuracy on a labelled sample set.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include "cnnInputPacker.hpp"
+#include "csvUtil.hpp"
+#include "distanceKernels.hpp"
+#include "evaluatorCLI.hpp"
+#include "extractor.hpp"
+#include "extractorFactory.hpp"
+#include "featureMatcher.hpp"
+#include "IDistanceMetric.hpp"
+#include "metricFactory.hpp"
+#include "preProcessor.hpp"
+#include "readFiles.hpp"
+#include "utilities.hpp"
+
+// namespace for internal helper structures and functions.
+namespace
+{
+    /*
+    Sample holds one labelled image reduced to what the extractors consume: the best detected
+    region and its rotation-normalized crop (CNN, color histogram). Detection runs once, outside the timed section.
+    */
+    struct Sample
+    {
+        std::string label;
+        RegionFeatures region;
+        cv::Mat crop;
+    };
+
+    /*
+    EvalResult holds the latency and accuracy figures for one extractor configuration.
+    */
+    struct EvalResult
+    {
+        size_t dim = 0;
+        size_t count = 0;
+        double meanMs = 0.0;
+        double p95Ms = 0.0;
+        double batchMsPerImage = 0.0; // 0 = not measured
+        double looTop1 = 0.0;
+        std::vector<std::string> predicted; // per sample: LOO k-NN label ("" = not extracted)
+    };
+
+    /*
+    looNeighbours returns, for each feature, its k nearest other features (leave-one-out k-NN) as
+    (distance, index) pairs, nearest first, under the metric the app matches with: SSD is the scaled
+    Euclidean distance (each dimension divided by its standard deviation over the set), other metrics
+    come from MetricFactory. The lists are empty when n < 2.
+    SSD and cosine compute the distances of a block of features to all features as one matrix product
+    (distanceKernels::euclideanBatch / cosineBatch), the same path as FeatureMatcher::matchBatch; SSD works on
+    centered, whitened features. Histogram intersection uses the metric's computeMany per feature.
+    */
+    std::vector<std::vector<std::pair<float, size_t>>> looNeighbours(const std::vector<std::vector<float>> &feats,
+                                                                     MetricType metricType, size_t k)
+    {
+        const size_t n = feats.size();
+        std::vector<std::vector<std::pair<float, size_t>>> neighbours(n);
+        auto metric = MetricFactory::create(metricType);
+        if (n < 2 || !metric)
+            return neighbours;
+
+        // All features in one row-major matrix; for SSD centered and divided by the per-dimension std-dev
+        const size_t dim = feats[0].size();
+        const int d = static_cast<int>(dim);
+        std::vector<float> matrix(n * dim);
+        std::vector<double> mean(dim, 0.0), sqMean(dim, 0.0);
+        std::vector<float> invStd(dim, 1.0f);
+        if (metricType == SSD)
+        {
+            for (const auto &f : feats)
+            {
+                for (size_t k = 0; k < dim; ++k)
+                {
+                    mean[k] += f[k];
+                    sqMean[k] += static_cast<double>(f[k]) * f[k];
+                }
+            }
+            for (size_t k = 0; k < dim; ++k)
+            {
+                mean[k] /= n;
+                const double sigma = std::sqrt(std::max(0.0, sqMean[k] / n - mean[k] * mean[k]));
+                invStd[k] = (sigma > 1e-6) ? static_cast<float>(1.0 / sigma) : 1.0f;
+            }
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t k = 0; k < dim; ++k)
+                matrix[i * dim + k] = static_cast<float>(feats[i][k] - mean[k]) * invStd[k];
+        }
+        std::vector<float> norms(n);
+        if (metricType == SSD)
+            distanceKernels::rowSquaredNorms(matrix.data(), n, d, norms.data());
+        else
+            distanceKernels::rowNorms(matrix.data(), n, d, norms.data());
+
+        // Distances of a block of queries to every feature, then the k nearest other features of each query
+        // (partial sort; ties go to the lower index)
+        constexpr size_t kQueryBlock = 64;
+        std::vector<float> distances(std::min(kQueryBlock, n) * n);
+        std::vector<std::pair<float, size_t>> candidates;
+        for (size_t q0 = 0; q0 < n; q0 += kQueryBlock)
+        {
+            const size_t count = std::min(kQueryBlock, n - q0);
+            const float *queries = matrix.data() + q0 * dim;
+            if (metricType == SSD)
+                distanceKernels::euclideanBatch(queries, count, matrix.data(), norms.data(), n, d, distances.data());
+            else if (metricType == COSINE)
+                distanceKernels::cosineBatch(queries, count, matrix.data(), norms.data(), n, d, distances.data());
+            else
+            {
+                for (size_t q = 0; q < count; ++q)
+                    metric->computeMany(queries + q * dim, matrix.data(), n, dim, distances.data() + q * n, nullptr);
+            }
+            for (size_t q = 0; q < count; ++q)
+            {
+                const size_t i = q0 + q;
+                const float *line = distances.data() + q * n;
+                candidates.clear();
+                for (size_t j = 0; j < n; ++j)
+                {
+                    if (j != i && std::isfinite(line[j]))
+                        candidates.emplace_back(line[j], j);
+                }
+                const size_t keep = std::min(k, candidates.size());
+                std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end());
+                neighbours[i].assign(candidates.begin(), candidates.begin() + keep);
+            }
+        }
+        return neighbours;
+    }
+
+    /*
+    evaluate extracts every sample with the given extractor, timing each extraction, and computes
+    the leave-one-out accuracy of the resulting features: the label of each sample is voted from its
+    k nearest other samples (FeatureMatcher::vote, as in the app).
+    */
+    EvalResult evaluate(const IExtractor &extractor, ExtractorType type, const std::vector<Sample> &samples,
+                        MetricType metricType = SSD, size_t k = 1, LabelVote vote = MIN_DISTANCE)
+    {
+        EvalResult res;
+        std::vector<std::vector<float>> feats;
+        std::vector<std::string> labels;
+        std::vector<double> times;
+        std::vector<float> fv;
+
+        // One untimed warm-up extraction so model loading is not counted
+        if (!samples.empty())
+        {
+            if (type == BASELINE)
+                extractor.extractRegion(samples[0].region, &fv);
+            else
+                extractor.extractMat(samples[0].crop, &fv);
+        }
+
+        std::vector<size_t> sampleIdx; // sample each feature came from
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            const Sample &s = samples[i];
+            const auto t0 = std::chrono::steady_clock::now();
+            const int rc = (type == BASELINE) ? extractor.extractRegion(s.region, &fv)
+                                              : extractor.extractMat(s.crop, &fv);
+            const auto t1 = std::chrono::steady_clock::now();
+            if (rc != 0 || fv.empty() || (!feats.empty() && fv.size() != feats[0].size()))
+                continue;
+            times.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+            feats.push_back(fv);
+            labels.push_back(s.label);
+            sampleIdx.push_back(i);
+        }
+        if (feats.empty())
+            return res;
+
+        res.dim = feats[0].size();
+        res.count = feats.size();
+        double sum = 0.0;
+        for (double t : times)
+            sum += t;
+        res.meanMs = sum / times.size();
+        std::sort(times.begin(), times.end());
+        res.p95Ms = times[std::min(times.size() - 1, static_cast<size_t>(0.95 * times.size()))];
+
+        // Leave-one-out k-NN: predicted label per sample and top-1 accuracy
+        res.predicted.assign(samples.size(), "");
+        const auto neighbours = looNeighbours(feats, metricType, std::max<size_t>(1, k));
+        std::vector<MatchResult> candidates;
+        MatchResult decision;
+        size_t correct = 0;
+        for (size_t i = 0; i < feats.size(); ++i)
+        {
+            candidates.clear();
+            for (const auto &[distance, j] : neighbours[i])
+            {
+                MatchResult m;
+                m.label = labels[j];
+                m.filename = m.label;
+                m.distance = distance;
+                candidates.push_back(m);
+            }
+            if (!FeatureMatcher::vote(candidates, vote, decision))
+                continue;
+            res.predicted[sampleIdx[i]] = decision.label;
+            if (decision.label == labels[i])
+                ++correct;
+        }
+        res.looTop1 = static_cast<double>(correct) / static_cast<double>(feats.size());
+        return res;
+    }
+
+    /*
+    batchMsPerImage times extractBatch over the CNN crops in batches of batchSize and returns the
+    average milliseconds per image (0 if any batch fails).
+    */
+    double batchMsPerImage(const IExtractor &extractor, const std::vector<Sample> &samples, size_t batchSize)
+    {
+        if (samples.empty() || batchSize == 0)
+            return 0.0;
+        std::vector<cv::Mat> batch;
+        std::vector<std::vector<float>> out;
+        double totalMs = 0.0;
+        for (size_t start = 0; start < samples.size(); start += batchSize)
+        {
+            batch.clear();
+            for (size_t i = start; i < std::min(samples.size(), start + batchSize); ++i)
+                batch.push_back(samples[i].crop);
+            const auto t0 = std::chrono::steady_clock::now();
+            const int rc = extractor.extractBatch(batch, &out);
+            totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            if (rc != 0)
+                return 0.0;
+        }
+        return totalMs / static_cast<double>(samples.size());
+    }
+
+    /*
+    top1Agreement returns the fraction of samples that both runs extracted and for which both
+    predicted the same leave-one-out label; shared receives the number of samples both extracted.
+    */
+    double top1Agreement(const EvalResult &a, const EvalResult &b, size_t *shared)
+    {
+        size_t both = 0, agree = 0;
+        for (size_t i = 0; i < std::min(a.predicted.size(), b.predicted.size()); ++i)
+        {
+            if (a.predicted[i].empty() || b.predicted[i].empty())
+                continue;
+            ++both;
+            if (a.predicted[i] == b.predicted[i])
+                ++agree;
+        }
+        if (shared)
+            *shared = both;
+        return both ? static_cast<double>(agree) / static_cast<double>(both) : 0.0;
+    }
+
+    /*
+    referenceDistance is the per-row scalar distance the matcher used before the batch kernels (cosine
+    recomputes both norms in double), kept as the baseline of the metric benchmark.
+    */
+    float referenceDistance(MetricType metricType, const float *x, const float *y, size_t n)
+    {
+        switch (metricType)
+        {
+        case SSD:
+        {
+            float sum = 0.0f;
+            for (size_t i = 0; i < n; ++i)
+                sum += (x[i] - y[i]) * (x[i] - y[i]);
+            return sum;
+        }
+        case HIST_INTERSECTION:
+        {
+            float intersection = 0.0f;
+            for (size_t i = 0; i < n; ++i)
+                intersection += std::min(x[i], y[i]);
+            return 1.0f - intersection;
+        }
+        default:
+        {
+            const double dot = std::inner_product(x, x + n, y, 0.0);
+            const double nx = std::sqrt(std::inner_product(x, x + n, x, 0.0));
+            const double ny = std::sqrt(std::inner_product(y, y + n, y, 0.0));
+            return (nx == 0.0 || ny == 0.0) ? 1.0f : static_cast<float>(1.0 - dot / (nx * ny));
+        }
+        }
+    }
+
+    /*
+    benchMetrics times IDistanceMetric::computeMany against the per-row scalar reference on random data for
+    every metric, dims 9, 512 and 1000 and databases of 1e2 to 1e6 rows (cosine gets the cached row norms, as
+    in the matcher), and prints ns per row, the speedup and the streamed bandwidth. Each cell repeats the
+    scan until about 5e7 floats were read; configurations above 2 GiB are skipped.
+    */
+    void benchMetrics()
+    {
+        const size_t kMaxFloats = (size_t{2} << 30) / sizeof(float);
+        const size_t kMinFloatsPerCell = 50000000;
+        std::mt19937 rng(5330);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+        printf("| metric | dim | rows | scalar ns/row | computeMany ns/row | speedup | GB/s |\n");
+        printf("| --- | --- | --- | --- | --- | --- | --- |\n");
+        for (size_t dim : {size_t{9}, size_t{512}, size_t{1000}})
+        {
+            for (size_t rows = 100; rows <= 1000000; rows *= 10)
+            {
+                if (rows * dim > kMaxFloats)
+                {
+                    printf("| * | %zu | %zu | skipped (> 2 GiB) | | | |\n", dim, rows);
+                    continue;
+                }
+                std::vector<float> matrix(rows * dim), query(dim), out(rows), norms(rows);
+                for (float &v : matrix)
+                    v = uniform(rng);
+                for (float &v : query)
+                    v = uniform(rng);
+                distanceKernels::rowNorms(matrix.data(), rows, static_cast<int>(dim), norms.data());
+                const size_t reps = std::max<size_t>(1, kMinFloatsPerCell / (rows * dim));
+
+                for (MetricType metricType : {SSD, COSINE, HIST_INTERSECTION})
+                {
+                    auto metric = MetricFactory::create(metricType);
+                    volatile float sink = 0.0f; // keeps the timed loops from being optimized away
+                    auto t0 = std::chrono::steady_clock::now();
+                    for (size_t r = 0; r < reps; ++r)
+                    {
+                        for (size_t i = 0; i < rows; ++i)
+                            out[i] = referenceDistance(metricType, query.data(), matrix.data() + i * dim, dim);
+                        sink = out[rows / 2];
+                    }
+                    const double scalarNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() /
+                                            static_cast<double>(reps * rows);
+
+                    const float *rowNorms = (metricType == COSINE) ? norms.data() : nullptr;
+                    t0 = std::chrono::steady_clock::now();
+                    for (size_t r = 0; r < reps; ++r)
+                    {
+                        metric->computeMany(query.data(), matrix.data(), rows, dim, out.data(), rowNorms);
+                        sink = out[rows / 2];
+                    }
+                    const double manyNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() /
+                                          static_cast<double>(reps * rows);
+                    const double gbPerSec = static_cast<double>(dim * sizeof(float)) / manyNs;
+                    (void)sink;
+                    printf("| %s | %zu | %zu | %.1f | %.1f | %.2fx | %.1f |\n",
+                           MetricFactory::metricTypeToString(metricType).c_str(), dim, rows, scalarNs, manyNs,
+                           scalarNs / manyNs, gbPerSec);
+                }
+            }
+        }
+    }
+
+    /*
+    referencePack is the chain CnnInputPacker replaces: cv::resize (INTER_LINEAR), BGR -> RGB, convertTo float
+    in [0, 1], then (x - mean) / std scattered into planar CHW order, with the packer's ImageNet defaults.
+    */
+    void referencePack(const cv::Mat &src, int outW, int outH, float *dst)
+    {
+        const float mean[3] = {0.485f, 0.456f, 0.406f};
+        const float stdv[3] = {0.229f, 0.224f, 0.225f};
+        cv::Mat resized, rgb, scaled;
+        cv::resize(src, resized, cv::Size(outW, outH), 0.0, 0.0, cv::INTER_LINEAR);
+        cv::cvtColor(resized, rgb, cv::COLOR_BGR2RGB);
+        rgb.convertTo(scaled, CV_32F, 1.0 / 255.0);
+        const size_t planeSize = static_cast<size_t>(outW) * outH;
+        for (int y = 0; y < outH; ++y)
+        {
+            const float *row = scaled.ptr<float>(y);
+            for (int x = 0; x < outW; ++x)
+            {
+                for (int c = 0; c < 3; ++c)
+                    dst[c * planeSize + static_cast<size_t>(y) * outW + x] = (row[3 * x + c] - mean[c]) / stdv[c];
+            }
+        }
+    }
+
+    /*
+    benchPacker times CnnInputPacker::pack against referencePack on random BGR images, from a few-row source up to
+    1280x720, packed to 224x224. It prints ms per image for both, the speedup and the largest difference. The
+    intermediate 8-bit rounding of the reference keeps that below one gray level, 1 / (255 * min std) in
+    normalized units. It also checks that the cached packer, fed a second image of the same size, gives exactly
+    what a fresh packer gives. Returns false if any size is over tolerance or fails the reuse check.
+    */
+    bool benchPacker()
+    {
+        constexpr int kOut = 224;
+        constexpr float kTolerance = 1.0f / (255.0f * 0.224f) + 1e-4f;
+        const cv::Size sizes[] = {{320, 1}, {320, 3}, {64, 64}, {640, 480}, {1280, 720}};
+        cv::RNG rng(5330);
+
+        bool passed = true;
+        printf("| source | reference ms | fused ms | speedup | max diff | reuse |\n");
+        printf("| --- | --- | --- | --- | --- | --- |\n");
+        for (const cv::Size &size : sizes)
+        {
+            cv::Mat first(size, CV_8UC3), second(size, CV_8UC3);
+            rng.fill(first, cv::RNG::UNIFORM, 0, 256);
+            rng.fill(second, cv::RNG::UNIFORM, 0, 256);
+            const size_t count = 3 * static_cast<size_t>(kOut) * kOut;
+            std::vector<float> reference(count), fused(count), fresh(count);
+            const int reps = std::max(1, 2000000 / (size.area() + kOut * kOut));
+
+            CnnInputPacker packer;
+            auto t0 = std::chrono::steady_clock::now();
+            for (int r = 0; r < reps; ++r)
+                referencePack(first, kOut, kOut, reference.data());
+            const double referenceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / reps;
+            t0 = std::chrono::steady_clock::now();
+            for (int r = 0; r < reps; ++r)
+                packer.pack(first, kOut, kOut, fused.data());
+            const double fusedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / reps;
+            float maxDiff = 0.0f;
+            for (size_t i = 0; i < count; ++i)
+                maxDiff = std::max(maxDiff, std::fabs(fused[i] - reference[i]));
+
+            // Same geometry, new pixels: nothing of the first image may leak into the second
+            packer.pack(second, kOut, kOut, fused.data());
+            CnnInputPacker().pack(second, kOut, kOut, fresh.data());
+            const bool reuseOk = std::equal(fused.begin(), fused.end(), fresh.begin());
+
+            printf("| %dx%d | %.3f | %.3f | %.2fx | %.4f%s | %s |\n", size.width, size.height, referenceMs, fusedMs,
+                   referenceMs / fusedMs, maxDiff, maxDiff <= kTolerance ? "" : " (over tolerance)",
+                   reuseOk ? "ok" : "STALE ROWS");
+            passed = passed && maxDiff <= kTolerance && reuseOk;
+        }
+        if (!passed)
+            printf("Error: the fused packer disagrees with the reference chain.\n");
+        return passed;
+    }
+
+    /*
+    benchSearch compares the FeatureMatcher search indexes on synthetic clustered embeddings (100 labels, each a
+    Gaussian blob around a random center): for each dimension and database size the same rows are preloaded
+    under every index and searched with the same queries (noisy copies of random rows, SSD, k = 1). It prints
+    the load time (packing, whitening and building the index), ms per query, the share of rows skipped by pivot
+    bounds, by early abandoning and by never being visited (HNSW, IVF, PQ re-ranking), and recall@1: the share of
+    queries whose nearest distance and label equal the linear scan's. PQ is run compressed (codes only, whose
+    distances are approximate, so only its label is compared) and with its 64 best candidates re-ranked.
+    Configurations above 1e8 floats are skipped.
+    */
+    void benchSearch()
+    {
+        constexpr size_t kMaxFloats = 100000000;
+        constexpr size_t kQueries = 200;
+        constexpr int kLabels = 100;
+        std::mt19937 rng(5330);
+        std::normal_distribution<float> gauss(0.0f, 1.0f);
+        FeatureMatcher::setMatchLogging(false);
+        struct BenchIndex
+        {
+            std::string name;
+            SearchIndex index;
+            SearchIndexParams params;
+        };
+        SearchIndexParams rerank;
+        rerank.pq.rerank = 64;
+        const std::vector<BenchIndex> indexes = {{"linear", LINEAR_SCAN, {}}, {"pruned", PRUNED_SCAN, {}},
+                                                 {"hnsw", HNSW_INDEX, {}}, {"ivf", IVF_INDEX, {}},
+                                                 {"pq", PQ_INDEX, {}}, {"pq+rerank64", PQ_INDEX, rerank}};
+
+        printf("| index | dim | rows | load s | ms/query | pivot pruned | abandoned | not visited | recall@1 |\n");
+        printf("| --- | --- | --- | --- | --- | --- | --- | --- | --- |\n");
+        for (size_t dim : {size_t{64}, size_t{512}})
+        {
+            for (size_t rows : {size_t{10000}, size_t{100000}, size_t{1000000}})
+            {
+                if (rows * dim > kMaxFloats)
+                {
+                    printf("| * | %zu | %zu | skipped (> 1e8 floats) | | | | | |\n", dim, rows);
+                    continue;
+                }
+                std::vector<std::vector<float>> centers(kLabels, std::vector<float>(dim));
+                for (auto &c : centers)
+                    for (float &v : c)
+                        v = 3.0f * gauss(rng);
+                std::vector<std::string> labels(rows);
+                std::vector<std::vector<float>> feats(rows, std::vector<float>(dim));
+                for (size_t i = 0; i < rows; ++i)
+                {
+                    const int label = static_cast<int>(rng() % kLabels);
+                    labels[i] = "label" + std::to_string(label);
+                    for (size_t k = 0; k < dim; ++k)
+                        feats[i][k] = centers[label][k] + gauss(rng);
+                }
+                std::vector<std::vector<float>> queries(kQueries);
+                for (auto &q : queries)
+                {
+                    q = feats[rng() % rows];
+                    for (float &v : q)
+                        v += 0.5f * gauss(rng);
+                }
+
+                std::vector<MatchResult> reference(kQueries);
+                for (const BenchIndex &bench : indexes)
+                {
+                    const std::string name = "bench-search-" + bench.name;
+                    const bool exactDistances = !(bench.index == PQ_INDEX && bench.params.pq.rerank == 0);
+                    FeatureMatcher::setSearchIndex(name, bench.index, bench.params);
+                    const auto loadStart = std::chrono::steady_clock::now();
+                    if (!FeatureMatcher::preload(name, labels, feats))
+                        continue;
+                    const double loadSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+                    FeatureMatcher::resetSearchStats(name);
+                    size_t hits = 0;
+                    const auto t0 = std::chrono::steady_clock::now();
+                    for (size_t q = 0; q < kQueries; ++q)
+                    {
+                        MatchResult m;
+                        if (!FeatureMatcher::matchKnn(queries[q], name, SSD, 1, MIN_DISTANCE, m))
+                            continue;
+                        if (bench.index == LINEAR_SCAN)
+                            reference[q] = m;
+                        if (m.label == reference[q].label && (!exactDistances || m.distance == reference[q].distance))
+                            ++hits;
+                    }
+                    const double msPerQuery = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() /
+                                              static_cast<double>(kQueries);
+                    const SearchStats stats = FeatureMatcher::searchStats(name);
+                    const double scanned = std::max<double>(1.0, static_cast<double>(stats.rows));
+                    printf("| %s | %zu | %zu | %.1f | %.3f | %.3f | %.3f | %.3f | %.3f |\n",
+                           bench.name.c_str(), dim, rows, loadSec, msPerQuery,
+                           static_cast<double>(stats.pivotPruned) / scanned, static_cast<double>(stats.abandoned) / scanned,
+                           static_cast<double>(stats.notVisited) / scanned, static_cast<double>(hits) / static_cast<double>(kQueries));
+                    FeatureMatcher::setSearchIndex(name, bench.index); // drops the cached rows
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    EvaluatorCLI::Args args = EvaluatorCLI::parse(argc, argv);
+    if (args.benchMetrics)
+    {
+        benchMetrics();
+        return 0;
+    }
+    if (args.benchSearch)
+    {
+        benchSearch();
+        return 0;
+    }
+    if (args.benchPacker)
+        return benchPacker() ? 0 : -1;
+    if (args.showHelp || args.inputDir.empty() || args.extractorStr.empty())
+    {
+        EvaluatorCLI::printUsage(argv[0]);
+        return args.showHelp ? 0 : -1;
+    }
+    const ExtractorType type = ExtractorFactory::stringToExtractorType(args.extractorStr.c_str());
+    if (type == UNKNOWN_EXTRACTOR)
+    {
+        printf("Error: unknown extractor type.\n\n");
+        EvaluatorCLI::printUsage(argv[0]);
+        return -1;
+    }
+    const LabelVote vote = FeatureMatcher::stringToLabelVote(args.vote);
+    if (vote == UNKNOWN_VOTE || args.knn < 1)
+    {
+        printf("Error: invalid label vote or k.\n\n");
+        EvaluatorCLI::printUsage(argv[0]);
+        return -1;
+    }
+    const size_t k = (vote == MIN_DISTANCE) ? 1 : static_cast<size_t>(args.knn);
+
+    // CNN configuration shared by every tap point; the crop size follows the model input
+    CNNExtractor::Params base = CNNExtractor::Params::fromEnv();
+    if (!args.modelPath.empty())
+        base.modelPath = args.modelPath;
+    if (args.inputSize > 0)
+        base.inputSize = args.inputSize;
+    if (!args.backends.empty())
+        base.backend = args.backends[0];
+    if (args.intraOpThreads > 0)
+        base.intraOpThreads = args.intraOpThreads;
+    if (args.interOpThreads > 0)
+        base.interOpThreads = args.interOpThreads;
+    int cropSize = 0;
+    if (type == CNN)
+        cropSize = CNNExtractor(CNN, base).inputSize();
+    else if (type != BASELINE)
+        cropSize = ExtractorFactory::create(type)->inputSize();
+
+    // Detect the best region of every labelled image once
+    std::vector<std::string> imagePaths;
+    ReadFiles::readFilesInDir((char *)args.inputDir.c_str(), imagePaths);
+    std::vector<Sample> samples;
+    for (const auto &path : imagePaths)
+    {
+        cv::Mat img = cv::imread(path);
+        if (img.empty())
+            continue;
+        DetectionResult det = PreProcessor::detect(img, /*keepAllRegions*/ false);
+        if (!det.valid)
+            continue;
+        Sample s;
+        s.label = csvUtil::getLabel(path);
+        s.region = det.bestRegion;
+        if (type != BASELINE && !utilities::prepEmbeddingImage(img, det.bestRegion, s.crop, cropSize, false))
+            continue;
+        samples.push_back(std::move(s));
+    }
+    printf("Loaded %zu labelled samples from %s\n", samples.size(), args.inputDir.c_str());
+    if (type != BASELINE)
+        printf("%s input %dx%d\n", args.extractorStr.c_str(), cropSize, cropSize);
+    if (vote != MIN_DISTANCE)
+        printf("LOO labels: %s vote over the %zu nearest samples\n", args.vote.c_str(), k);
+    printf("\n");
+
+    printf("| extractor | layer | dim | samples | mean ms | p95 ms | batch%d ms/img | LOO top-1 |\n", args.batchSize);
+    printf("| --- | --- | --- | --- | --- | --- | --- | --- |\n");
+    auto printRow = [](const std::string &name, const std::string &layer, const EvalResult &r)
+    {
+        char batchCol[32] = "-";
+        if (r.batchMsPerImage > 0.0)
+            std::snprintf(batchCol, sizeof(batchCol), "%.2f", r.batchMsPerImage);
+        printf("| %s | %s | %zu | %zu | %.2f | %.2f | %s | %.3f |\n",
+               name.c_str(), layer.c_str(), r.dim, r.count, r.meanMs, r.p95Ms, batchCol, r.looTop1);
+    };
+
+    if (type != CNN)
+    {
+        auto extractor = ExtractorFactory::create(type);
+        // Color histograms are matched with histogram intersection, as in the app
+        const MetricType metric = (type == COLOR_HIST) ? HIST_INTERSECTION : SSD;
+        printRow(args.extractorStr, "-", evaluate(*extractor, type, samples, metric, k, vote));
+        return 0;
+    }
+
+    // One row per CNN backend and tap point
+    if (args.layers.empty())
+        args.layers.push_back(base.outputName);
+    if (args.backends.empty())
+        args.backends.push_back(base.backend);
+    for (const auto &backend : args.backends)
+    {
+        for (const auto &layer : args.layers)
+        {
+            CNNExtractor::Params params = base;
+            params.backend = backend;
+            params.outputName = layer;
+            CNNExtractor extractor(CNN, params);
+            if (extractor.initialize() != 0)
+                continue;
+            const DbMetadata meta = extractor.metadata();
+            auto it = meta.find("layer");
+            EvalResult r = evaluate(extractor, CNN, samples, SSD, k, vote);
+            r.batchMsPerImage = batchMsPerImage(extractor, samples, static_cast<size_t>(std::max(1, args.batchSize)));
+            printRow("cnn/" + (backend.empty() ? std::string("default") : backend),
+                     it != meta.end() ? it->second : (layer.empty() ? "default" : layer), r);
+        }
+    }
+
+    // FP32 vs INT8: same samples, same backend and tap point, only the model differs
+    if (!args.compareModelPath.empty())
+    {
+        printf("\n| backend | model | precision | mean ms | p95 ms | LOO top-1 |\n");
+        printf("| --- | --- | --- | --- | --- | --- |\n");
+        std::string summary;
+        for (const auto &backend : args.backends)
+        {
+            CNNExtractor::Params fp32Params = base;
+            fp32Params.backend = backend;
+            fp32Params.outputName = args.layers[0];
+            CNNExtractor::Params int8Params = fp32Params;
+            int8Params.modelPath = args.compareModelPath;
+            CNNExtractor fp32(CNN, fp32Params), int8(CNN, int8Params);
+            if (fp32.initialize() != 0 || int8.initialize() != 0)
+                continue;
+            const std::string name = backend.empty() ? std::string("default") : backend;
+            const EvalResult rf = evaluate(fp32, CNN, samples, SSD, k, vote);
+            const EvalResult rq = evaluate(int8, CNN, samples, SSD, k, vote);
+            for (const auto &[ex, r] : {std::make_pair(&fp32, &rf), std::make_pair(&int8, &rq)})
+            {
+                const DbMetadata meta = ex->metadata();
+                printf("| %s | %s | %s | %.2f | %.2f | %.3f |\n", name.c_str(), meta.at("model").c_str(),
+                       meta.count("precision") ? meta.at("precision").c_str() : "?", r->meanMs, r->p95Ms, r->looTop1);
+            }
+            size_t shared = 0;
+            const double agreement = top1Agreement(rf, rq, &shared);
+            char line[160];
+            std::snprintf(line, sizeof(line), "%s: top-1 agreement %.3f over %zu samples, INT8 speedup x%.2f, LOO top-1 %+.3f\n",
+                          name.c_str(), agreement, shared, (rq.meanMs > 0.0) ? rf.meanMs / rq.meanMs : 0.0,
+                          rq.looTop1 - rf.looTop1);
+            summary += line;
+        }
+        printf("\n%s", summary.c_str());
+    }
+    return 0;
+}
@@ -9,8 +9,10 @@ Description: Pre-training utilities for image processing.
 #include <cstdio>
 #include <cstdlib>
 #include "csvUtil.hpp"
+#include "dbMetadata.hpp"
 #include "extractorFactory.hpp"
 #include "extractor.hpp"
+#include "featureMatcher.hpp"
 #include "preProcessor.hpp"
 #include "preTrainerCLI.hpp"
 #include "readFiles.hpp"
@@ -58,22 +60,17 @@ int extractFeaturesToFile(
         }
         else
         {
-            if (extractorType == ExtractorType::CNN)
+            // Image-based extractors (CNN, color histogram) consume the rotation-normalized crop of the
+            // detected region at their own input size, exactly as the app prepares it
+            cv::Mat cropInput;
+            const bool prepOk = utilities::prepEmbeddingImage(img, det.bestRegion, cropInput, extractor->inputSize(),
+                                                              extractorType == ExtractorType::CNN);
+            if (!prepOk || cropInput.empty())
             {
-                // For CNN, we need to prepare the embedding image by rotating and resizing the detected region
-                cv::Mat cnnInput;
-                const bool prepOk = utilities::prepEmbeddingImage(img, det.bestRegion, cnnInput, 224, true);
-                if (!prepOk || cnnInput.empty())
-                {
-                    printf("Warning: CNN prep failed for %s\n", path.c_str());
-                    continue;
-                }
-                rc = extractor->extractMat(cnnInput, &featureVector);
-            }
-            else
-            {
-                rc = extractor->extractMat(det.embImage, &featureVector);
+                printf("Warning: crop prep failed for %s\n", path.c_str());
+                continue;
             }
+            rc = extractor->extractMat(cropInput, &featureVector);
         }
         if (rc != 0)
         {
@@ -88,6 +85,45 @@ int extractFeaturesToFile(
     return 0; // Success
 }
 
+/*
+Builds the INT8 counterpart of a CNN database: the same images embedded with the quantized model,
+written next to the FP32 database as <name>_int8.csv. All other CNN settings (layer, input size,
+backend, threads) come from the environment, so both databases differ only in the model.
+- @param imagePaths The images the FP32 database was built from (the calibration set).
+- @param int8ModelPath The INT8-quantized ONNX model.
+- @param fp32OutPath The FP32 database path.
+- @return 0 on success, -1 on error.
+*/
+int buildInt8Db(
+    const std::vector<std::string> &imagePaths,
+    const std::string &int8ModelPath,
+    const std::string &fp32OutPath)
+{
+    CNNExtractor::Params params = CNNExtractor::Params::fromEnv();
+    params.modelPath = int8ModelPath;
+    auto extractor = std::make_shared<CNNExtractor>(ExtractorType::CNN, params);
+    if (extractor->initialize() != 0)
+    {
+        return -1;
+    }
+    const DbMetadata meta = extractor->metadata();
+    auto precision = meta.find("precision");
+    if (precision != meta.end() && precision->second != "int8")
+    {
+        printf("Warning: %s has no quantized operators; building the INT8 database anyway\n", int8ModelPath.c_str());
+    }
+
+    std::string outPath = fp32OutPath;
+    const size_t ext = outPath.rfind(".csv");
+    outPath.insert((ext == std::string::npos) ? outPath.size() : ext, "_int8");
+    printf("INT8 output: %s\n", outPath.c_str());
+    if (dbMetadata::write(outPath, meta) != 0)
+    {
+        return -1;
+    }
+    return extractFeaturesToFile(imagePaths, extractor, ExtractorType::CNN, outPath);
+}
+
 int main(int argc, char *argv[])
 {
     // get the directory path, extractor type and output file path
@@ -95,7 +131,8 @@ int main(int argc, char *argv[])
     std::string outputBase;
     std::string modelPath;
     ExtractorType extractorType;
-    const int parseRc = PreTrainerCLI::parseCLI(argc, argv, dirname, extractorType, outputBase, &modelPath);
+    PreTrainerCLI::Args args;
+    const int parseRc = PreTrainerCLI::parseCLI(argc, argv, dirname, extractorType, outputBase, &modelPath, &args);
     if (parseRc != 0)
     {
         return (parseRc > 0) ? 0 : -1;
@@ -105,6 +142,26 @@ int main(int argc, char *argv[])
     {
         setenv("RTOR_CNN_MODEL", modelPath.c_str(), 1);
     }
+    if (!args.layerName.empty())
+    {
+        setenv("RTOR_CNN_OUTPUT", args.layerName.c_str(), 1);
+    }
+    if (!args.backend.empty())
+    {
+        setenv("RTOR_CNN_BACKEND", args.backend.c_str(), 1);
+    }
+    if (args.inputSize > 0)
+    {
+        setenv("RTOR_CNN_INPUT_SIZE", std::to_string(args.inputSize).c_str(), 1);
+    }
+    if (args.intraOpThreads > 0)
+    {
+        setenv("RTOR_CNN_INTRA_THREADS", std::to_string(args.intraOpThreads).c_str(), 1);
+    }
+    if (args.interOpThreads > 0)
+    {
+        setenv("RTOR_CNN_INTER_THREADS", std::to_string(args.interOpThreads).c_str(), 1);
+    }
 
     // read the files in the directory, get the file paths
     std::vector<std::string> imagePaths;
@@ -113,9 +170,6 @@ int main(int argc, char *argv[])
     // generate the output file path
     std::string outPath = csvUtil::setOutputFilename(outputBase, extractorType);
 
-    // Ensure the output feature CSV file is empty
-    csvUtil::clearExistingFile(outPath.c_str());
-
     // create the extractor based on the specified type
     std::shared_ptr<IExtractor> extractor;
     try
@@ -127,8 +181,32 @@ int main(int argc, char *argv[])
         std::cerr << "Extractor creation failed: " << e.what() << std::endl;
         return -1;
     }
+    // Load (and warm up) the model once up front; a cached optimized graph skips re-optimization
+    if (extractor->initialize() != 0)
+    {
+        return -1;
+    }
+
+    // Start the output feature CSV with the extractor metadata (model, layer, dimension)
+    if (dbMetadata::write(outPath, extractor->metadata()) != 0)
+    {
+        return -1;
+    }
     // extract features for each image and save to output file
     extractFeaturesToFile(imagePaths, extractor, extractorType, outPath);
 
+    // Build the search index now, so the first match does not pay for it; rtor finds it next to the CSV
+    if (!args.indexStr.empty() &&
+        !FeatureMatcher::buildIndex(outPath, FeatureMatcher::stringToSearchIndex(args.indexStr)))
+    {
+        printf("Error: could not build the %s index of %s\n", args.indexStr.c_str(), outPath.c_str());
+        return -1;
+    }
+
+    // Calibration-set mode: embed the same images with the INT8 model into a second database
+    if (!args.int8ModelPath.empty())
+    {
+        return buildInt8Db(imagePaths, args.int8ModelPath, outPath);
+    }
     return 0;
 }
@@ -14,14 +14,19 @@ Description: Real-time object recognition using feature matching.
 #include <algorithm>
 #include <cctype>
 #include <cmath>
+#include <cstdlib>
 #include <filesystem>
 #include <opencv2/opencv.hpp>
+#include "cnnScheduler.hpp"
+#include "cnnWorker.hpp"
 #include "csvUtil.hpp"
+#include "dbMetadata.hpp"
 #include "extractorFactory.hpp"
 #include "featureMatcher.hpp"
 #include "IExtractor.hpp"
 #include "preProcessor.hpp"
 #include "regionAnalyzer.hpp"
+#include "regionTracker.hpp"
 #include "RTObjectRecognitionApp.hpp"
 #include "utilities.hpp"
 
@@ -45,6 +50,10 @@ namespace
             return distance > st.baselineUnknownThreshold;
         case CNN:
             return distance > st.cnnUnknownThreshold;
+        case COLOR_HIST:
+            return distance > st.histUnknownThreshold;
+        case HOG:
+            return distance > st.hogUnknownThreshold;
         default:
             return false;
         }
@@ -56,9 +65,73 @@ namespace
         std::ostringstream oss;
         oss << std::fixed << std::setprecision(2)
             << "B<=" << st.baselineUnknownThreshold
-            << " C<=" << st.cnnUnknownThreshold;
+            << " C<=" << st.cnnUnknownThreshold
+            << " H<=" << st.histUnknownThreshold
+            << " G<=" << st.hogUnknownThreshold;
         return oss.str();
     }
+
+    // One synchronous extractor's features for the regions of a frame (one row per region that extracted)
+    // and their database matches. Reused across frames, so the feature matrix is allocated once.
+    struct FrameMatches
+    {
+        cv::Mat features;                                 // extracted regions x dim, CV_32F
+        std::vector<int> rowOf;                           // row of each region in features, -1 if not extracted
+        std::vector<std::vector<MatchResult>> neighbours; // k nearest database entries of each row
+        std::vector<MatchResult> decisions;               // voted label of each row
+        std::vector<char> decided;                        // the row has a decision
+
+        // Voted match of region i, or nullptr if the region was not extracted or not matched
+        const MatchResult *best(size_t i) const
+        {
+            if (i >= rowOf.size() || rowOf[i] < 0 || static_cast<size_t>(rowOf[i]) >= decided.size())
+                return nullptr;
+            const size_t row = static_cast<size_t>(rowOf[i]);
+            return decided[row] ? &decisions[row] : nullptr;
+        }
+    };
+
+    // Extracts the features of the first n regions, from the region measurements (fromRegion) or from the
+    // rotation-normalized crop at the extractor's input size, matches them all against the database with one
+    // FeatureMatcher::matchBatch call and votes over the k nearest entries of each region. crop is a
+    // caller-owned buffer reused across regions and frames.
+    void matchRegions(const IExtractor &extractor, bool fromRegion, const cv::Mat &frame,
+                      const std::vector<RegionFeatures> &regions, size_t n, const std::string &dbPath,
+                      MetricType metricType, size_t k, LabelVote vote, cv::Mat &crop, FrameMatches &out)
+    {
+        out.rowOf.assign(n, -1);
+        out.decided.clear();
+        const int dim = extractor.dim();
+        if (dim <= 0 || n == 0)
+            return;
+        out.features.create(static_cast<int>(n), dim, CV_32F);
+        int rows = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            float *row = out.features.ptr<float>(rows);
+            const bool ok = fromRegion
+                                ? extractor.extractRegionInto(regions[i], row) == 0
+                                : utilities::prepEmbeddingImage(frame, regions[i], crop, extractor.inputSize(), false) &&
+                                      extractor.extractInto(crop, row) == 0;
+            if (ok)
+                out.rowOf[i] = rows++;
+        }
+        if (rows == 0 || !FeatureMatcher::matchBatch(out.features.rowRange(0, rows), dbPath, metricType, k, out.neighbours))
+            return;
+        out.decisions.resize(out.neighbours.size());
+        out.decided.resize(out.neighbours.size());
+        for (size_t r = 0; r < out.neighbours.size(); ++r)
+            out.decided[r] = FeatureMatcher::vote(out.neighbours[r], vote, out.decisions[r]);
+    }
+
+    // Appends one extractor's result ("<tag><label>") to a region's overlay text, two spaces apart.
+    void appendPart(std::string &text, const char *tag, const std::string &label)
+    {
+        if (!text.empty())
+            text += "  ";
+        text += tag;
+        text += label;
+    }
 }
 
 /*
@@ -71,37 +144,17 @@ std::string RTObjectRecognitionApp::dbPathFor(const AppState &st, ExtractorType
     case BASELINE:
         return (st.dataDir / "features_baseline.csv").string();
     case CNN:
-        return (st.dataDir / "features_cnn.csv").string();
+        // INT8 and FP32 embeddings are kept apart; pretrain --int8-model builds both databases
+        return (st.dataDir / (st.cnnInt8 ? "features_cnn_int8.csv" : "features_cnn.csv")).string();
+    case COLOR_HIST:
+        return (st.dataDir / "features_color_hist.csv").string();
+    case HOG:
+        return (st.dataDir / "features_hog.csv").string();
     default:
         return "";
     }
 }
 
-/*
-classifyByExtractor extracts features from the given ROI using the specified extractor and
-performs feature matching against the database at dbPath. The best match result is stored in matchResult.
-*/
-static bool classifyByExtractor(
-    const std::shared_ptr<IExtractor> &extractor,
-    const cv::Mat &roi,
-    const std::string &dbPath,
-    MatchResult &matchResult,
-    MetricType metricType = MetricType::COSINE)
-{
-    if (!extractor || roi.empty() || dbPath.empty())
-    {
-        return false;
-    }
-    std::vector<float> featureVector;
-    const bool extractOk = (extractor->extractMat(roi, &featureVector) == 0);
-    if (!extractOk || featureVector.empty())
-    {
-        return false;
-    }
-    // Perform feature matching and return the best match result.
-    return FeatureMatcher::match(featureVector, dbPath, metricType, matchResult);
-}
-
 /*
 enrollToDb extracts features from the given embedding image (or region) using the specified extractor type
 and appends them to the corresponding feature database CSV.
@@ -123,14 +176,15 @@ void RTObjectRecognitionApp::enrollToDb(
     }
     else
     {
-        if (type == ExtractorType::CNN && bestRegion != nullptr && sourceFrame != nullptr)
+        if (bestRegion != nullptr && sourceFrame != nullptr)
         {
-            // For CNN, perform the same embedding image preparation as in the main classification flow to ensure consistency
+            // For image-based extractors (CNN, color histogram, HOG), perform the same embedding image preparation
+            // as in the main classification flow to ensure consistency
             cv::Mat cnnInput;
-            const bool prepOk = utilities::prepEmbeddingImage(*sourceFrame, *bestRegion, cnnInput, 224, false);
+            const bool prepOk = utilities::prepEmbeddingImage(*sourceFrame, *bestRegion, cnnInput, extractor->inputSize(), false);
             if (!prepOk || cnnInput.empty())
             {
-                std::cerr << "[TRAIN] CNN prep failed\n";
+                std::cerr << "[TRAIN] crop prep failed\n";
                 return;
             }
             rc = extractor->extractMat(cnnInput, &featureVector);
@@ -149,8 +203,30 @@ void RTObjectRecognitionApp::enrollToDb(
     const std::string dbPath = dbPathFor(st, type);
     if (dbPath.empty())
         return;
-    // Append the new feature vector to the corresponding CSV database
-    csvUtil::append_image_data_csv(dbPath.c_str(), savedPath.c_str(), featureVector, 0);
+    // New (or empty) databases start with the extractor metadata; existing ones must match it
+    const DbMetadata expected = extractor->metadata();
+    std::error_code sizeEc;
+    if (!std::filesystem::exists(dbPath) || std::filesystem::file_size(dbPath, sizeEc) == 0)
+    {
+        dbMetadata::write(dbPath, expected);
+    }
+    else
+    {
+        DbMetadata stored;
+        std::string reason;
+        if (dbMetadata::read(dbPath, stored) && !dbMetadata::compatible(stored, expected, &reason))
+        {
+            std::cerr << "[TRAIN] " << dbPath << " was built with a different extractor setup (" << reason
+                      << "); sample not enrolled\n";
+            return;
+        }
+    }
+    // Append the new feature vector to the corresponding CSV database (and to its cached copy)
+    if (FeatureMatcher::enroll(dbPath, savedPath, featureVector) != 0)
+    {
+        std::cerr << "[TRAIN] could not enroll into " << dbPath << "\n";
+        return;
+    }
     std::cout << "[TRAIN] appended " << ExtractorFactory::extractorTypeToString(type) << " features to " << dbPath << "\n";
 }
 
@@ -186,10 +262,49 @@ int RTObjectRecognitionApp::run()
     // create the extractor based on the specified type
     auto baselineExtractor = ExtractorFactory::create(ExtractorType::BASELINE);
     auto cnnExtractor = ExtractorFactory::create(ExtractorType::CNN);
+    auto histExtractor = ExtractorFactory::create(ExtractorType::COLOR_HIST);
+    auto hogExtractor = ExtractorFactory::create(ExtractorType::HOG);
+    // Load and warm up the CNN before the first frame so enabling CNN mode does not stall the loop
+    if (cnnExtractor->initialize() != 0)
+        std::cerr << "[CNN] model unavailable; CNN mode will not produce predictions\n";
+    const DbMetadata cnnMeta = cnnExtractor->metadata();
+    auto cnnPrecision = cnnMeta.find("precision");
+    st.cnnInt8 = (cnnPrecision != cnnMeta.end() && cnnPrecision->second == "int8");
     // precompute database paths for efficiency
     const std::string baselineDbPath = dbPathFor(st, BASELINE);
     const std::string cnnDbPath = dbPathFor(st, CNN);
+    const std::string histDbPath = dbPathFor(st, COLOR_HIST);
+    const std::string hogDbPath = dbPathFor(st, HOG);
+    // Databases built with a different extractor setup are rejected at load time
+    FeatureMatcher::requireMetadata(baselineDbPath, baselineExtractor->metadata());
+    FeatureMatcher::requireMetadata(cnnDbPath, cnnMeta);
+    FeatureMatcher::requireMetadata(histDbPath, histExtractor->metadata());
+    FeatureMatcher::requireMetadata(hogDbPath, hogExtractor->metadata());
+    // RTOR_MATCH_INDEX=linear|pruned|hnsw|ivf|pq selects the nearest-neighbour search of the CNN database (default
+    // linear); the other modes match a whole frame at once with matchBatch, which always scans. With pq,
+    // RTOR_PQ_RERANK=<n> keeps the rows and re-ranks the n best candidates exactly (default 0: codes only)
+    const char *indexEnv = std::getenv("RTOR_MATCH_INDEX");
+    if (indexEnv != nullptr)
+    {
+        const SearchIndex index = FeatureMatcher::stringToSearchIndex(indexEnv);
+        SearchIndexParams params;
+        const char *rerankEnv = std::getenv("RTOR_PQ_RERANK");
+        if (rerankEnv != nullptr)
+            params.pq.rerank = static_cast<size_t>(std::max(0, std::atoi(rerankEnv)));
+        if (index == UNKNOWN_INDEX)
+            std::cerr << "[MATCH] unknown RTOR_MATCH_INDEX '" << indexEnv << "', keeping the default\n";
+        else
+            FeatureMatcher::setSearchIndex(cnnDbPath, index, params);
+    }
+    // CNN inference runs on a worker started the first time CNN mode is enabled
+    std::unique_ptr<CnnWorker> cnnWorker;
+    CnnScheduler cnnScheduler(CnnScheduler::Params(st.cnnBudgetMs));
+    RegionTracker tracker;
     size_t frameId = 0;
+    // Per-frame buffers reused across frames so classification does not allocate
+    FrameMatches baselineMatches, histMatches, hogMatches;
+    cv::Mat cropBuffer;
+    std::string predictedText;
 
     for (;;)
     {
@@ -233,8 +348,11 @@ int RTObjectRecognitionApp::run()
         st.predictedBoxes.clear();
         st.predictedTexts.clear();
 
-        // For each detected region, perform classification using the enabled extractors and populate predictions
-        if (st.lastDetection.valid && (st.baselineOn || st.cnnOn))
+        // For each detected region, perform classification using the enabled extractors and populate predictions.
+        // In cascade mode the baseline classifies every region and the CNN only the ambiguous ones.
+        const bool runBaseline = st.baselineOn || st.cascadeOn;
+        const bool runCnn = st.cnnOn || st.cascadeOn;
+        if (st.lastDetection.valid && (runBaseline || runCnn || st.histOn || st.hogOn))
         {
             const size_t n = std::min(st.lastDetection.regions.size(),
                                       std::min(st.lastDetection.regionBBoxes.size(),
@@ -242,109 +360,143 @@ int RTObjectRecognitionApp::run()
             if (kVerboseFrameLogs)
                 std::cout << "[CLASSIFY] candidates=" << n << "\n";
 
-            // Determine if CNN should run for this frame based on the interval setting
-            const bool runCnnThisFrame = st.cnnOn && (st.cnnIntervalFrames <= 1 || (frameId % static_cast<size_t>(st.cnnIntervalFrames) == 0));
-            size_t cnnProcessedCount = 0;
-            if (runCnnThisFrame)
+            // Track ids keep CNN results attached to the same object while regions reorder between frames
+            const std::vector<cv::Rect> trackBoxes(st.lastDetection.regionBBoxes.begin(),
+                                                   st.lastDetection.regionBBoxes.begin() + n);
+            const std::vector<int> &trackIds = tracker.update(trackBoxes, frameId);
+            for (int gone : tracker.takeDropped())
             {
-                st.cachedCnnLabels.assign(n, "NO");
-                st.cachedCnnDistances.assign(n, 0.0f);
+                if (cnnWorker)
+                    cnnWorker->forget(gone);
+                cnnScheduler.forget(gone);
             }
+            std::vector<CnnScheduler::Candidate> cnnCandidates;
+            // The synchronous extractors extract every region first and then match the whole frame in one
+            // batch per database, so each database is streamed once per frame instead of once per region
+            const std::vector<RegionFeatures> &regions = st.lastDetection.regions;
+            const size_t k = (st.matchVote == MIN_DISTANCE) ? 1 : st.matchK;
+            if (runBaseline)
+                matchRegions(*baselineExtractor, true, frame, regions, n, baselineDbPath, MetricType::SSD, k,
+                             st.matchVote, cropBuffer, baselineMatches);
+            if (st.histOn)
+                matchRegions(*histExtractor, false, frame, regions, n, histDbPath, MetricType::HIST_INTERSECTION, k,
+                             st.matchVote, cropBuffer, histMatches);
+            if (st.hogOn)
+                matchRegions(*hogExtractor, false, frame, regions, n, hogDbPath, MetricType::SSD, k, st.matchVote,
+                             cropBuffer, hogMatches);
             // For each region, perform classification using the enabled extractors and
             // build the predicted text for overlay display.
             for (size_t i = 0; i < n; ++i)
             {
                 const cv::Rect box = st.lastDetection.regionBBoxes[i];
                 const cv::Mat &roi = st.lastDetection.regionEmbImages[i];
-                const RegionFeatures &rf = st.lastDetection.regions[i];
-                std::vector<std::string> parts;
+                predictedText.clear();
+                bool baselineConfident = false;
                 // Baseline extractor classification
-                if (st.baselineOn)
+                if (runBaseline)
                 {
-                    std::vector<float> featureVector;
-                    MatchResult matchResult;
-                    const bool extractOk = (baselineExtractor->extractRegion(rf, &featureVector) == 0);
-                    // Use SSD metric for baseline matching as it generally provides better separation for our handcrafted features
-                    if (extractOk && FeatureMatcher::match(featureVector, baselineDbPath, MetricType::SSD, matchResult))
+                    // Baseline matching uses the SSD metric as it generally provides better separation for our handcrafted features
+                    if (const MatchResult *matchResult = baselineMatches.best(i))
                     {
                         st.hasBaselinePrediction = true;
-                        st.baselineDistance = matchResult.distance;
-                        const bool unknown = isUnknownMatch(st, BASELINE, matchResult.distance);
-                        st.baselineLabel = unknown ? st.unknownLabel : matchResult.label;
-                        parts.push_back("B:" + st.baselineLabel);
+                        st.baselineDistance = matchResult->distance;
+                        const bool unknown = isUnknownMatch(st, BASELINE, matchResult->distance);
+                        st.baselineLabel = unknown ? st.unknownLabel : matchResult->label;
+                        // Confident: accepted and clearly closer to its label than to any other label
+                        baselineConfident = !unknown && matchResult->margin() >= st.cascadeMinMargin;
+                        appendPart(predictedText, "B:", st.baselineLabel);
+                        if (st.cascadeOn && !baselineConfident)
+                            predictedText += '?';
+                    }
+                    else
+                    {
+                        appendPart(predictedText, "B:", "NO");
+                    }
+                }
+                // Color histogram classification: a synchronous mid-cost tier matched with histogram intersection
+                if (st.histOn)
+                {
+                    if (const MatchResult *matchResult = histMatches.best(i))
+                    {
+                        const bool unknown = isUnknownMatch(st, COLOR_HIST, matchResult->distance);
+                        appendPart(predictedText, "H:", unknown ? st.unknownLabel : matchResult->label);
                     }
                     else
                     {
-                        parts.push_back("B:NO");
+                        appendPart(predictedText, "H:", "NO");
                     }
                 }
-                // CNN extractor classification (with caching to limit frequency of CNN inference)
-                if (st.cnnOn)
+                // HOG classification: shape and edge layout of the grayscale crop, matched with SSD
+                if (st.hogOn)
                 {
-                    MatchResult matchResult;
-                    // Run CNN inference for this region if we're on a CNN frame and haven't exceeded the per-frame CNN region limit
-                    if (runCnnThisFrame && cnnProcessedCount < static_cast<size_t>(std::max(1, st.maxCnnRegionsPerFrame)))
+                    if (const MatchResult *matchResult = hogMatches.best(i))
                     {
-                        ++cnnProcessedCount;
-                        cv::Mat cnnInput;
-                        const bool prepOk = utilities::prepEmbeddingImage(currentFrame, rf, cnnInput, 224, false);
-                        // For CNN, use SSD metric as it empirically works better than cosine for our CNN features in terms of unknown rejection
-                        if (prepOk && classifyByExtractor(cnnExtractor, cnnInput, cnnDbPath, matchResult, MetricType::SSD))
-                        {
-                            st.hasCnnPrediction = true;
-                            st.cnnDistance = matchResult.distance;
-                            const bool unknown = isUnknownMatch(st, CNN, matchResult.distance);
-                            st.cnnLabel = unknown ? st.unknownLabel : matchResult.label;
-                            st.cachedCnnLabels[i] = st.cnnLabel;
-                            st.cachedCnnDistances[i] = matchResult.distance;
-                            parts.push_back("C:" + st.cnnLabel);
-                        }
-                        // If CNN inference or matching failed, cache as "NO" to avoid repeated attempts for this region in subsequent
-                        // frames until the next CNN run.
-                        else
-                        {
-                            st.cachedCnnLabels[i] = "NO";
-                            st.cachedCnnDistances[i] = 0.0f;
-                            parts.push_back("C:NO");
-                        }
+                        const bool unknown = isUnknownMatch(st, HOG, matchResult->distance);
+                        appendPart(predictedText, "G:", unknown ? st.unknownLabel : matchResult->label);
                     }
-                    // If we're not running CNN inference for this region in this frame, use the cached result if available to
-                    // populate the display text.
                     else
                     {
-                        if (i < st.cachedCnnLabels.size() && st.cachedCnnLabels[i] != "NO")
-                        {
-                            st.hasCnnPrediction = true;
-                            st.cnnLabel = st.cachedCnnLabels[i];
-                            st.cnnDistance = st.cachedCnnDistances[i];
-                            parts.push_back("C:" + st.cachedCnnLabels[i]);
-                        }
-                        else if (i < st.cachedCnnLabels.size() && st.cachedCnnLabels[i] == "NO")
-                        {
-                            parts.push_back("C:NO");
-                        }
-                        else
-                        {
-                            parts.push_back("C:SKIP");
-                        }
+                        appendPart(predictedText, "G:", "NO");
                     }
                 }
-                // Combine the parts into the final predicted text for this region and store it along
-                // with the bounding box for overlay display.
-                std::ostringstream oss;
-                for (size_t k = 0; k < parts.size(); ++k)
+                if (st.cascadeOn)
                 {
-                    if (k > 0)
-                        oss << "  ";
-                    oss << parts[k];
+                    if (baselineConfident)
+                        ++st.cascadeBaselineDecided;
+                    else
+                        ++st.cascadeCnnDecided;
                 }
+                // CNN classification runs asynchronously: show the latest result of this track (with its
+                // age in frames when stale); the scheduler below decides which tracks get a new inference.
+                // In cascade mode, tracks the baseline settled are neither shown nor scheduled.
+                if (runCnn && !(st.cascadeOn && baselineConfident))
+                {
+                    if (!cnnWorker)
+                        cnnWorker = std::make_unique<CnnWorker>(cnnExtractor, cnnDbPath, MetricType::SSD);
+                    const int trackId = trackIds[i];
+                    CnnResult cnnResult;
+                    const bool hasResult = cnnWorker->latest(trackId, cnnResult);
+                    if (hasResult)
+                        cnnScheduler.observe(trackId, cnnResult);
+                    const size_t age = hasResult ? frameId - std::min(frameId, cnnResult.frameId) : 0;
+                    if (hasResult && cnnResult.ok)
+                    {
+                        st.hasCnnPrediction = true;
+                        st.cnnDistance = cnnResult.distance;
+                        // For CNN, SSD works better than cosine for unknown rejection
+                        const bool unknown = isUnknownMatch(st, CNN, cnnResult.distance);
+                        st.cnnLabel = unknown ? st.unknownLabel : cnnResult.label;
+                        appendPart(predictedText, "C:", st.cnnLabel);
+                        if (age > 0)
+                            predictedText += " (" + std::to_string(age) + "f)";
+                    }
+                    else
+                    {
+                        appendPart(predictedText, "C:", hasResult ? "NO" : "...");
+                    }
+                    cnnCandidates.push_back({trackId, box.area(), cnnWorker->pending(trackId)});
+                }
+                // Store the predicted text for this region along with the bounding box for overlay display.
                 st.predictedBoxes.push_back(box);
-                st.predictedTexts.push_back(oss.str());
+                st.predictedTexts.push_back(predictedText);
                 if (kVerboseFrameLogs)
-                    std::cout << "[PRED][region " << i << "] " << oss.str() << "\n";
+                    std::cout << "[PRED][region " << i << "] " << predictedText << "\n";
+            }
+
+            // Submit as many CNN jobs as the per-frame latency budget allows, highest priority first
+            if (runCnn && cnnWorker)
+            {
+                for (int trackId : cnnScheduler.schedule(cnnCandidates, frameId, st.cnnUnknownThreshold))
+                {
+                    const size_t idx = static_cast<size_t>(std::find(trackIds.begin(), trackIds.end(), trackId) - trackIds.begin());
+                    if (idx < n)
+                        cnnWorker->submit(trackId, frameId, currentFrame, st.lastDetection.regions[idx]);
+                }
+                st.cnnCostMs = cnnScheduler.costEstimateMs();
+                st.cnnCacheHitRate = cnnWorker->cacheStats().hitRate();
             }
         }
-        else if (st.baselineOn || st.cnnOn)
+        else if (runBaseline || runCnn || st.histOn || st.hogOn)
         {
             if (kVerboseFrameLogs)
                 std::cout << "[CLASSIFY] skipped (no valid detection)\n";
@@ -474,6 +626,19 @@ int RTObjectRecognitionApp::run()
     if (st.writer.isOpened())
         st.writer.release();
 
+    if (cnnWorker)
+    {
+        const EmbeddingCache::Stats cs = cnnWorker->cacheStats();
+        std::cout << "[CNN] embedding cache: " << cs.hits << " hits / " << (cs.hits + cs.misses) << " lookups ("
+                  << std::fixed << std::setprecision(1) << cs.hitRate() * 100.0 << "%), " << cs.evictions
+                  << " evictions, " << cs.size << " cached\n";
+    }
+    const size_t cascadeTotal = st.cascadeBaselineDecided + st.cascadeCnnDecided;
+    if (cascadeTotal > 0)
+    {
+        std::cout << "[CASCADE] baseline decided " << st.cascadeBaselineDecided << " / " << cascadeTotal
+                  << " region classifications, CNN " << st.cascadeCnnDecided << "\n";
+    }
     return 0;
 }
 
@@ -505,7 +670,10 @@ void RTObjectRecognitionApp::drawOverlay(cv::Mat &display, const AppState &st)
     std::string status =
         "B(Baseline): " + onOff(st.baselineOn) +
         "   C(CNN): " + onOff(st.cnnOn) +
-        "   D(Debug): " + onOff(st.debugOn);
+        "   H(Hist): " + onOff(st.histOn) +
+        "   G(HOG): " + onOff(st.hogOn) +
+        "   D(Debug): " + onOff(st.debugOn) +
+        "   A(Cascade): " + onOff(st.cascadeOn);
 
     cv::putText(display, status,
                 {20, 95}, cv::FONT_HERSHEY_DUPLEX, 0.7,
@@ -556,11 +724,18 @@ void RTObjectRecognitionApp::drawOverlay(cv::Mat &display, const AppState &st)
     }
 
     // If there are predictions for this frame, display the predicted labels near their corresponding regions
-    const bool anyModeOn = st.baselineOn || st.cnnOn;
+    const bool anyModeOn = st.baselineOn || st.cnnOn || st.histOn || st.hogOn || st.cascadeOn;
     if (anyModeOn)
     {
         std::ostringstream summary;
         summary << "Pred Regions: " << st.predictedTexts.size();
+        if ((st.cnnOn || st.cascadeOn) && st.cnnCostMs > 0.0)
+            summary << "  CNN ~" << std::fixed << std::setprecision(1) << st.cnnCostMs << "ms/" << st.cnnBudgetMs << "ms"
+                    << " cache " << std::setprecision(0) << st.cnnCacheHitRate * 100.0 << "%";
+        const size_t cascadeTotal = st.cascadeBaselineDecided + st.cascadeCnnDecided;
+        if (st.cascadeOn && cascadeTotal > 0)
+            summary << "  B decided " << std::fixed << std::setprecision(0)
+                    << 100.0 * st.cascadeBaselineDecided / cascadeTotal << "%";
         cv::putText(display, summary.str(), {20, 175},
                     cv::FONT_HERSHEY_DUPLEX, 0.75, cv::Scalar(255, 255, 255), 2, cv::LINE_AA);
 
@@ -648,19 +823,28 @@ void RTObjectRecognitionApp::handleTrainingKey(AppState &st, int key, const cv::
             if (cv::imwrite(out, det.embImage))
             {
                 std::cout << "[TRAIN] Saved " << out << "\n";
-                bool anyModeEnabled = st.baselineOn || st.cnnOn;
+                // Cascade mode uses both databases, so it enrolls into both
+                bool anyModeEnabled = st.baselineOn || st.cnnOn || st.histOn || st.hogOn || st.cascadeOn;
                 if (!anyModeEnabled)
                 {
                     enrollToDb(st, BASELINE, det.embImage, out, &det.bestRegion, &frame);
                 }
-                if (st.baselineOn)
+                if (st.baselineOn || st.cascadeOn)
                 {
                     enrollToDb(st, BASELINE, det.embImage, out, &det.bestRegion, &frame);
                 }
-                if (st.cnnOn)
+                if (st.cnnOn || st.cascadeOn)
                 {
                     enrollToDb(st, CNN, det.embImage, out, &det.bestRegion, &frame);
                 }
+                if (st.histOn)
+                {
+                    enrollToDb(st, COLOR_HIST, det.embImage, out, &det.bestRegion, &frame);
+                }
+                if (st.hogOn)
+                {
+                    enrollToDb(st, HOG, det.embImage, out, &det.bestRegion, &frame);
+                }
             }
             else
                 std::cout << "[TRAIN] Failed to save " << out << "\n";
@@ -706,6 +890,25 @@ bool RTObjectRecognitionApp::handleKey(AppState &st, int key, const cv::Size &re
             return true;
         }
 
+        if (key == 'h' || key == 'H')
+        {
+            st.histOn = !st.histOn;
+            std::cout << "Color histogram: " << (st.histOn ? "ON" : "OFF") << "\n";
+            return true;
+        }
+        if (key == 'g' || key == 'G')
+        {
+            st.hogOn = !st.hogOn;
+            std::cout << "HOG: " << (st.hogOn ? "ON" : "OFF") << "\n";
+            return true;
+        }
+        if (key == 'a' || key == 'A')
+        {
+            st.cascadeOn = !st.cascadeOn;
+            std::cout << "Cascade (baseline, CNN when ambiguous): " << (st.cascadeOn ? "ON" : "OFF") << "\n";
+            return true;
+        }
+
         if ((key == 't' || key == 'T'))
         {
             st.trainingOn = true;
@@ -762,6 +965,15 @@ bool RTObjectRecognitionApp::handleKey(AppState &st, int key, const cv::Size &re
             }
             return true;
         }
+        if (key == 'v' || key == 'V')
+        {
+            st.matchVote = static_cast<LabelVote>((st.matchVote + 1) % UNKNOWN_VOTE);
+            std::cout << "Label vote: " << FeatureMatcher::labelVoteToString(st.matchVote);
+            if (st.matchVote != MIN_DISTANCE)
+                std::cout << " over the " << st.matchK << " nearest entries";
+            std::cout << "\n";
+            return true;
+        }
         if (key == 'u' || key == 'U')
         {
             st.rejectUnknown = !st.rejectUnknown;
@@ -773,6 +985,8 @@ bool RTObjectRecognitionApp::handleKey(AppState &st, int key, const cv::Size &re
         {
             st.baselineUnknownThreshold = std::max(0.01f, st.baselineUnknownThreshold * 0.9f);
             st.cnnUnknownThreshold = std::max(0.01f, st.cnnUnknownThreshold * 0.9f);
+            st.histUnknownThreshold = std::max(0.01f, st.histUnknownThreshold * 0.9f);
+            st.hogUnknownThreshold = std::max(0.01f, st.hogUnknownThreshold * 0.9f);
             std::cout << "Unknown thresholds tightened: " << thresholdsSummary(st) << "\n";
             return true;
         }
@@ -780,6 +994,8 @@ bool RTObjectRecognitionApp::handleKey(AppState &st, int key, const cv::Size &re
         {
             st.baselineUnknownThreshold *= 1.1f;
             st.cnnUnknownThreshold *= 1.1f;
+            st.histUnknownThreshold = std::min(1.0f, st.histUnknownThreshold * 1.1f);
+            st.hogUnknownThreshold *= 1.1f;
             std::cout << "Unknown thresholds loosened: " << thresholdsSummary(st) << "\n";
             return true;
         }
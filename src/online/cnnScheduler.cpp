@@ -0,0 +1,111 @@
+/*
+Claire Liu, Yu-Jing Wei
+cnnScheduler.cpp
+
+Path: src/online/cnnScheduler.cpp
+Description: Ranks tracked regions for CNN inference and admits as many as fit in a per-frame latency budget.
+*/
+
+#include "cnnScheduler.hpp"
+
+#include <algorithm>
+
+/*
+CnnScheduler constructor seeds the cost estimate.
+*/
+CnnScheduler::CnnScheduler(const Params &params)
+    : params_(params), costMs_(std::max(0.1, params.initialCostMs)) {}
+
+/*
+observe records a result (or a failure recorded on it) the first time it is seen: the track becomes
+classified and the measured job cost is folded into the moving average. Cache hits are skipped: they cost far
+less than an inference and would drag the estimate down.
+*/
+void CnnScheduler::observe(int trackId, const CnnResult &result)
+{
+    TrackState &t = tracks_[trackId];
+    if (t.classified && t.resultFrame == result.frameId && t.failedFrame == result.failedFrameId)
+        return;
+    t.classified = true;
+    t.ok = result.ok;
+    t.distance = result.distance;
+    t.resultFrame = result.frameId;
+    t.failedFrame = result.failedFrameId;
+    if (!result.cached)
+    {
+        costMs_ += params_.emaAlpha * (static_cast<double>(result.costMs) - costMs_);
+        costMs_ = std::max(0.1, costMs_);
+    }
+}
+
+/*
+schedule ranks the candidates and admits them in order while the credit covers the estimated cost.
+A frame always admits its top candidate once the credit has caught up, so a cost above the per-frame
+budget lowers the inference rate instead of stopping it.
+*/
+std::vector<int> CnnScheduler::schedule(const std::vector<Candidate> &candidates, size_t frameId,
+                                        float unknownThreshold)
+{
+    creditMs_ = std::min(creditMs_ + params_.budgetMs, params_.budgetMs + costMs_);
+
+    struct Ranked
+    {
+        int cls;
+        size_t age; // frames since the last result (or since first seen)
+        int area;
+        int trackId;
+    };
+    std::vector<Ranked> ranked;
+    ranked.reserve(candidates.size());
+    for (const auto &c : candidates)
+    {
+        auto it = tracks_.find(c.trackId);
+        if (it == tracks_.end())
+        {
+            it = tracks_.emplace(c.trackId, TrackState{}).first;
+            it->second.firstSeen = frameId;
+        }
+        const TrackState &t = it->second;
+        const size_t attempt = std::max(t.resultFrame, t.failedFrame);
+        if (c.pending || (t.classified && attempt >= frameId))
+            continue;
+
+        const size_t since = t.classified ? attempt : t.firstSeen;
+        const size_t age = frameId - std::min(frameId, since);
+        int cls = 3;
+        if (!t.classified || age >= static_cast<size_t>(std::max(1, params_.starvationFrames)))
+            cls = 0;
+        else if (age >= static_cast<size_t>(std::max(1, params_.staleFrames)))
+            cls = 1;
+        else if (!t.ok || t.failedFrame > t.resultFrame ||
+                 t.distance > params_.lowConfidenceRatio * unknownThreshold)
+            cls = 2;
+        ranked.push_back({cls, age, c.area, c.trackId});
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const Ranked &a, const Ranked &b)
+              {
+                  if (a.cls != b.cls)
+                      return a.cls < b.cls;
+                  if (a.cls == 0 && a.age != b.age)
+                      return a.age > b.age;
+                  return a.area > b.area;
+              });
+
+    std::vector<int> out;
+    for (const auto &r : ranked)
+    {
+        if (creditMs_ < costMs_)
+            break;
+        creditMs_ -= costMs_;
+        out.push_back(r.trackId);
+    }
+    return out;
+}
+
+/*
+forget drops the state of a track.
+*/
+void CnnScheduler::forget(int trackId)
+{
+    tracks_.erase(trackId);
+}
@@ -0,0 +1,204 @@
+/*
+Claire Liu, Yu-Jing Wei
+cnnWorker.cpp
+
+Path: src/online/cnnWorker.cpp
+Description: Runs CNN embedding extraction and matching on worker threads behind a bounded job queue.
+*/
+
+#include "cnnWorker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include "featureMatcher.hpp"
+#include "utilities.hpp"
+
+/*
+CnnWorker constructor starts the worker threads.
+*/
+CnnWorker::CnnWorker(std::shared_ptr<IExtractor> extractor, std::string dbPath, MetricType metricType,
+                     const Params &params)
+    : extractor_(std::move(extractor)), dbPath_(std::move(dbPath)), metricType_(metricType), params_(params),
+      cache_(params.cache)
+{
+    const int n = std::max(1, params_.threads);
+    for (int i = 0; i < n; ++i)
+    {
+        threads_.emplace_back(&CnnWorker::loop, this);
+    }
+}
+
+/*
+CnnWorker destructor discards queued jobs, lets running jobs finish and joins the threads.
+*/
+CnnWorker::~CnnWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        queue_.clear();
+    }
+    cv_.notify_all();
+    for (auto &t : threads_)
+    {
+        if (t.joinable())
+            t.join();
+    }
+}
+
+/*
+submit queues a classification job for a track. Only the newest crop of a track is worth classifying,
+so a still-queued job of the same track is replaced; a full queue sheds its oldest job.
+*/
+void CnnWorker::submit(int trackId, size_t frameId, const cv::Mat &frame, const RegionFeatures &region)
+{
+    if (frame.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        live_.insert(trackId);
+        auto it = std::find_if(queue_.begin(), queue_.end(), [&](const Job &j) { return j.trackId == trackId; });
+        if (it != queue_.end())
+        {
+            it->frameId = frameId;
+            it->frame = frame;
+            it->region = region;
+            return;
+        }
+        if (queue_.size() >= std::max<size_t>(1, params_.queueCapacity))
+        {
+            queue_.pop_front();
+        }
+        queue_.push_back({trackId, frameId, frame, region});
+    }
+    cv_.notify_one();
+}
+
+/*
+latest copies the most recent result of the track into out.
+*/
+bool CnnWorker::latest(int trackId, CnnResult &out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = results_.find(trackId);
+    if (it == results_.end())
+        return false;
+    out = it->second;
+    return true;
+}
+
+/*
+pending reports whether a job of the track is queued or being processed.
+*/
+bool CnnWorker::pending(int trackId) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (inFlight_.count(trackId) > 0)
+        return true;
+    return std::any_of(queue_.begin(), queue_.end(), [&](const Job &j) { return j.trackId == trackId; });
+}
+
+/*
+forget drops the mailbox entry and the queued job of a track. A job already running is not interrupted, but
+loop discards its result because the track is no longer live.
+*/
+void CnnWorker::forget(int trackId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    live_.erase(trackId);
+    results_.erase(trackId);
+    queue_.erase(std::remove_if(queue_.begin(), queue_.end(), [&](const Job &j) { return j.trackId == trackId; }),
+                 queue_.end());
+}
+
+/*
+loop is the worker thread body: wait for a job, classify it outside the lock and publish the result,
+unless the track was forgotten meanwhile or a result from a newer frame was published. A failed job does not
+overwrite a valid match; it is recorded in failedFrameId instead.
+*/
+void CnnWorker::loop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_)
+                return;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+            ++inFlight_[job.trackId];
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+        CnnResult res = classify(job);
+        res.costMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto inFlight = inFlight_.find(job.trackId);
+        if (inFlight != inFlight_.end() && --inFlight->second <= 0)
+            inFlight_.erase(inFlight);
+        if (live_.count(job.trackId) == 0)
+            continue;
+        auto slot = results_.find(job.trackId);
+        if (slot == results_.end())
+        {
+            results_.emplace(job.trackId, std::move(res));
+            continue;
+        }
+        CnnResult &prev = slot->second;
+        if (prev.frameId > res.frameId)
+            continue;
+        if (!res.ok && prev.ok)
+        {
+            // keep the last valid match; the failure only marks the track for the scheduler
+            if (prev.failedFrameId < res.frameId)
+            {
+                prev.failedFrameId = res.frameId;
+                prev.cached = res.cached;
+                prev.costMs = res.costMs;
+            }
+            continue;
+        }
+        if (prev.failedFrameId > res.frameId)
+            res.failedFrameId = prev.failedFrameId;
+        prev = std::move(res);
+    }
+}
+
+/*
+classify crops the region at the extractor's input size, embeds it (or reuses the cached embedding of an
+unchanged region) and matches it against the database. A cache hit is flagged in cached.
+*/
+CnnResult CnnWorker::classify(const Job &job)
+{
+    CnnResult res;
+    res.frameId = job.frameId;
+    cv::Mat crop;
+    if (!utilities::prepEmbeddingImage(job.frame, job.region, crop, extractor_->inputSize(), false))
+        return res;
+    std::vector<float> featureVector;
+    const bool useCache = params_.cache.capacity > 0;
+    EmbeddingCache::Key key;
+    if (useCache)
+        key = EmbeddingCache::makeKey(crop, job.region.orientedBBox);
+    if (useCache && cache_.lookup(key, featureVector))
+    {
+        res.cached = true;
+    }
+    else
+    {
+        if (extractor_->extractMat(crop, &featureVector) != 0 || featureVector.empty())
+            return res;
+        if (useCache)
+            cache_.insert(key, featureVector);
+    }
+    MatchResult match;
+    if (!FeatureMatcher::match(featureVector, dbPath_, metricType_, match))
+        return res;
+    res.ok = true;
+    res.label = match.label;
+    res.distance = match.distance;
+    return res;
+}
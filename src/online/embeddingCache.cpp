@@ -0,0 +1,129 @@
+/*
+Claire Liu, Yu-Jing Wei
+embeddingCache.cpp
+
+Path: src/online/embeddingCache.cpp
+Description: Bounded LRU cache of CNN embeddings keyed by a perceptual hash of the crop and the region's box.
+*/
+
+#include "embeddingCache.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+
+/*
+EmbeddingCache constructor stores the parameters; the cache starts empty.
+*/
+EmbeddingCache::EmbeddingCache(const Params &params) : params_(params) {}
+
+/*
+makeKey computes the DCT hash of the crop: the crop is reduced to 32x32 grayscale, transformed with a 2-D DCT,
+and each of the 8x8 lowest-frequency coefficients contributes one bit (above or below their median, DC excluded).
+The hash ignores small brightness, noise and scaling changes but flips bits when the content changes.
+*/
+EmbeddingCache::Key EmbeddingCache::makeKey(const cv::Mat &crop, const cv::RotatedRect &box)
+{
+    Key key;
+    key.box = box;
+    if (crop.empty())
+        return key;
+
+    cv::Mat gray, small, dct;
+    if (crop.channels() == 3)
+        cv::cvtColor(crop, gray, cv::COLOR_BGR2GRAY);
+    else if (crop.channels() == 4)
+        cv::cvtColor(crop, gray, cv::COLOR_BGRA2GRAY);
+    else
+        gray = crop;
+    cv::resize(gray, small, cv::Size(32, 32), 0, 0, cv::INTER_AREA);
+    small.convertTo(small, CV_32F);
+    cv::dct(small, dct);
+
+    float coeffs[64];
+    for (int y = 0; y < 8; ++y)
+    {
+        for (int x = 0; x < 8; ++x)
+            coeffs[y * 8 + x] = dct.at<float>(y, x);
+    }
+    float sorted[63];
+    std::copy(coeffs + 1, coeffs + 64, sorted);
+    std::nth_element(sorted, sorted + 31, sorted + 63);
+    const float median = sorted[31];
+    for (int i = 0; i < 64; ++i)
+    {
+        if (coeffs[i] > median)
+            key.hash |= (uint64_t{1} << i);
+    }
+    return key;
+}
+
+/*
+matches reports whether two keys describe the same view of the same object: close hashes and a box with
+nearly the same centre, side lengths and angle.
+*/
+bool EmbeddingCache::matches(const Key &a, const Key &b) const
+{
+    if (static_cast<int>(std::bitset<64>(a.hash ^ b.hash).count()) > params_.maxHamming)
+        return false;
+
+    const float side = std::max({a.box.size.width, a.box.size.height, 1.0f});
+    const cv::Point2f d = a.box.center - b.box.center;
+    if (std::hypot(d.x, d.y) > params_.maxCenterShift * side)
+        return false;
+
+    auto sideChanged = [&](float s0, float s1)
+    { return std::fabs(s0 - s1) > params_.maxSizeChange * std::max(s0, 1.0f); };
+    if (sideChanged(a.box.size.width, b.box.size.width) || sideChanged(a.box.size.height, b.box.size.height))
+        return false;
+
+    float dAngle = std::fmod(std::fabs(a.box.angle - b.box.angle), 180.0f);
+    dAngle = std::min(dAngle, 180.0f - dAngle);
+    return dAngle <= params_.maxAngleDeg;
+}
+
+/*
+lookup scans the entries from most to least recently used and returns the first match, moving it to the front.
+*/
+bool EmbeddingCache::lookup(const Key &key, std::vector<float> &out)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it)
+    {
+        if (!matches(key, it->key))
+            continue;
+        out = it->embedding;
+        entries_.splice(entries_.begin(), entries_, it);
+        ++stats_.hits;
+        return true;
+    }
+    ++stats_.misses;
+    return false;
+}
+
+/*
+insert adds an embedding at the front, evicting from the back while the cache is over capacity.
+*/
+void EmbeddingCache::insert(const Key &key, const std::vector<float> &embedding)
+{
+    if (params_.capacity == 0 || embedding.empty())
+        return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_front({key, embedding});
+    while (entries_.size() > params_.capacity)
+    {
+        entries_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+/*
+stats returns a snapshot of the counters.
+*/
+EmbeddingCache::Stats EmbeddingCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s = stats_;
+    s.size = entries_.size();
+    return s;
+}
@@ -0,0 +1,106 @@
+/*
+Claire Liu, Yu-Jing Wei
+regionTracker.cpp
+
+Path: src/online/regionTracker.cpp
+Description: Keeps stable ids for detected regions across frames by nearest-centre association.
+*/
+
+#include "regionTracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// namespace for internal helper functions.
+namespace
+{
+    // Euclidean distance between the centres of two boxes
+    float centerDistance(const cv::Rect &a, const cv::Rect &b)
+    {
+        const float dx = (a.x + 0.5f * a.width) - (b.x + 0.5f * b.width);
+        const float dy = (a.y + 0.5f * a.height) - (b.y + 0.5f * b.height);
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    // Diagonal length of a box
+    float diagonal(const cv::Rect &r)
+    {
+        return std::sqrt(static_cast<float>(r.width) * r.width + static_cast<float>(r.height) * r.height);
+    }
+}
+
+/*
+RegionTracker constructor stores the association parameters.
+*/
+RegionTracker::RegionTracker(const Params &params) : params_(params) {}
+
+/*
+update associates the boxes of the current frame with the existing tracks. Candidate pairs within the
+gate are taken in order of increasing centre distance, so each track and each box is used at most once.
+*/
+const std::vector<int> &RegionTracker::update(const std::vector<cv::Rect> &boxes, size_t frameId)
+{
+    struct Candidate
+    {
+        float dist;
+        size_t track;
+        size_t box;
+    };
+    std::vector<Candidate> candidates;
+    for (size_t t = 0; t < tracks_.size(); ++t)
+    {
+        for (size_t b = 0; b < boxes.size(); ++b)
+        {
+            const float d = centerDistance(tracks_[t].box, boxes[b]);
+            const float gate = params_.gate * std::max(diagonal(tracks_[t].box), diagonal(boxes[b]));
+            if (d <= gate)
+                candidates.push_back({d, t, b});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate &a, const Candidate &b) { return a.dist < b.dist; });
+
+    ids_.assign(boxes.size(), -1);
+    std::vector<bool> trackUsed(tracks_.size(), false);
+    for (const auto &c : candidates)
+    {
+        if (trackUsed[c.track] || ids_[c.box] >= 0)
+            continue;
+        trackUsed[c.track] = true;
+        ids_[c.box] = tracks_[c.track].id;
+        tracks_[c.track].box = boxes[c.box];
+        tracks_[c.track].lastSeen = frameId;
+    }
+
+    // Unmatched boxes start new tracks
+    for (size_t b = 0; b < boxes.size(); ++b)
+    {
+        if (ids_[b] < 0)
+        {
+            ids_[b] = nextId_++;
+            tracks_.push_back({ids_[b], boxes[b], frameId});
+        }
+    }
+
+    // Drop tracks that have not been seen for too long
+    const size_t maxMissed = static_cast<size_t>(std::max(0, params_.maxMissedFrames));
+    auto expired = [&](const Track &t) { return frameId > t.lastSeen + maxMissed; };
+    for (const auto &t : tracks_)
+    {
+        if (expired(t))
+            dropped_.push_back(t.id);
+    }
+    tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(), expired), tracks_.end());
+    return ids_;
+}
+
+/*
+takeDropped returns the ids of the tracks dropped since the previous call, so that per-track state kept
+elsewhere can be released.
+*/
+std::vector<int> RegionTracker::takeDropped()
+{
+    std::vector<int> out;
+    out.swap(dropped_);
+    return out;
+}
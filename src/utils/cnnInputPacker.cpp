@@ -0,0 +1,272 @@
+/*
+  Claire Liu, Yu-Jing Wei
+  cnnInputPacker.cpp
+
+  Path: src/utils/cnnInputPacker.cpp
+  Description: Fused resize + BGR->RGB + normalize + NCHW packing for CNN input.
+*/
+
+#include "cnnInputPacker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/core/hal/intrin.hpp>
+
+namespace
+{
+    // ImageNet mean/std (R,G,B) used by ResNet18
+    const float kDefaultMean[3] = {0.485f, 0.456f, 0.406f};
+    const float kDefaultStd[3] = {0.229f, 0.224f, 0.225f};
+
+    /*
+    Computes cv::resize(INTER_LINEAR) source indices and weights for one axis:
+    src = (dst + 0.5) * scale - 0.5, clamped at the borders.
+    */
+    void linearTable(int srcLen, int dstLen, std::vector<int> &i0, std::vector<int> &i1, std::vector<float> &w)
+    {
+        i0.resize(dstLen);
+        i1.resize(dstLen);
+        w.resize(dstLen);
+        const double scale = static_cast<double>(srcLen) / static_cast<double>(dstLen);
+        for (int d = 0; d < dstLen; ++d)
+        {
+            double f = (d + 0.5) * scale - 0.5;
+            int s = static_cast<int>(std::floor(f));
+            f -= s;
+            if (s < 0)
+            {
+                s = 0;
+                f = 0.0;
+            }
+            if (s >= srcLen - 1)
+            {
+                s = srcLen - 1;
+                f = 0.0;
+            }
+            i0[d] = s;
+            i1[d] = std::min(s + 1, srcLen - 1);
+            w[d] = static_cast<float>(f);
+        }
+    }
+
+#if CV_SIMD128
+    // Widen 16 uint8 lanes to four float vectors (lanes 0-3, 4-7, 8-11, 12-15).
+    inline void expandU8ToF32(const cv::v_uint8x16 &v, cv::v_float32x4 out[4])
+    {
+        cv::v_uint16x8 lo16, hi16;
+        cv::v_expand(v, lo16, hi16);
+        cv::v_uint32x4 a, b, c, d;
+        cv::v_expand(lo16, a, b);
+        cv::v_expand(hi16, c, d);
+        out[0] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(a));
+        out[1] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(b));
+        out[2] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(c));
+        out[3] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d));
+    }
+
+    // Widen 16 uint8 lanes to float and store them to dst[0..15].
+    inline void storeU8AsF32(const cv::v_uint8x16 &v, float *dst)
+    {
+        cv::v_float32x4 f[4];
+        expandU8ToF32(v, f);
+        for (int k = 0; k < 4; ++k)
+            cv::v_store(dst + 4 * k, f[k]);
+    }
+#endif
+}
+
+/*
+CnnInputPacker constructor initializes the normalization with the ImageNet mean/std.
+*/
+CnnInputPacker::CnnInputPacker()
+{
+    setNormalization(kDefaultMean, kDefaultStd);
+}
+
+/*
+setNormalization folds (x / 255 - mean) / std into out = x * scale + bias for each channel.
+*/
+void CnnInputPacker::setNormalization(const float mean[3], const float stdv[3])
+{
+    for (int c = 0; c < 3; ++c)
+    {
+        scale_[c] = 1.0f / (255.0f * stdv[c]);
+        bias_[c] = -mean[c] / stdv[c];
+    }
+}
+
+/*
+prepareTables recomputes the sampling tables when the source or output geometry changes.
+*/
+void CnnInputPacker::prepareTables(int srcW, int srcH, int outW, int outH, int cn)
+{
+    if (srcW == srcW_ && srcH == srcH_ && outW == outW_ && outH == outH_ && cn == cn_)
+    {
+        return;
+    }
+    srcW_ = srcW;
+    srcH_ = srcH;
+    outW_ = outW;
+    outH_ = outH;
+    cn_ = cn;
+
+    std::vector<int> x0, x1;
+    linearTable(srcW, outW, x0, x1, xW_);
+    xOfs_.resize(outW);
+    xOfs1_.resize(outW);
+    for (int x = 0; x < outW; ++x)
+    {
+        xOfs_[x] = x0[x] * cn;
+        xOfs1_[x] = x1[x] * cn;
+    }
+    linearTable(srcH, outH, yIdx_, yIdx1_, yW_);
+    identityX_ = (srcW == outW);
+
+    rowBuf_.assign(static_cast<size_t>(2 * 3 * outW), 0.0f);
+}
+
+/*
+horizontalRow interpolates one 8-bit source row along x into three float planes (R,G,B)
+of outW values each. Same-width rows with 3 channels take a SIMD deinterleave fast path; other
+rows gather the left and right samples of 16 outputs per channel with v_lut over the precomputed
+byte offsets and blend them with one FMA per 4 lanes.
+*/
+void CnnInputPacker::horizontalRow(const uchar *srcRow, float *planes)
+{
+    const int W = outW_;
+    float *pr = planes;
+    float *pg = planes + W;
+    float *pb = planes + 2 * W;
+
+    int x = 0;
+    if (identityX_ && cn_ == 3)
+    {
+#if CV_SIMD128
+        for (; x <= W - 16; x += 16)
+        {
+            cv::v_uint8x16 b, g, r;
+            cv::v_load_deinterleave(srcRow + 3 * x, b, g, r);
+            storeU8AsF32(r, pr + x);
+            storeU8AsF32(g, pg + x);
+            storeU8AsF32(b, pb + x);
+        }
+#endif
+        for (; x < W; ++x)
+        {
+            pb[x] = srcRow[3 * x + 0];
+            pg[x] = srcRow[3 * x + 1];
+            pr[x] = srcRow[3 * x + 2];
+        }
+        return;
+    }
+
+    // Channel feeding each output plane: gray replicates channel 0, BGR/BGRA swap to RGB
+    const int cR = (cn_ == 1) ? 0 : 2;
+    const int cG = (cn_ == 1) ? 0 : 1;
+    const int cB = 0;
+#if CV_SIMD128
+    const int *ofs0 = xOfs_.data();
+    const int *ofs1 = xOfs1_.data();
+    const float *wx = xW_.data();
+    const uchar *channelRow[3] = {srcRow + cR, srcRow + cG, srcRow + cB};
+    float *plane[3] = {pr, pg, pb};
+    for (; x <= W - 16; x += 16)
+    {
+        cv::v_float32x4 w[4];
+        for (int k = 0; k < 4; ++k)
+            w[k] = cv::v_load(wx + x + 4 * k);
+        for (int p = 0; p < 3; ++p)
+        {
+            cv::v_float32x4 left[4], right[4];
+            expandU8ToF32(cv::v_lut(channelRow[p], ofs0 + x), left);
+            expandU8ToF32(cv::v_lut(channelRow[p], ofs1 + x), right);
+            for (int k = 0; k < 4; ++k)
+                cv::v_store(plane[p] + x + 4 * k, cv::v_fma(cv::v_sub(right[k], left[k]), w[k], left[k]));
+        }
+    }
+#endif
+    for (; x < W; ++x)
+    {
+        const uchar *p0 = srcRow + xOfs_[x];
+        const uchar *p1 = srcRow + xOfs1_[x];
+        const float w = xW_[x];
+        pr[x] = p0[cR] + (static_cast<float>(p1[cR]) - p0[cR]) * w;
+        pg[x] = p0[cG] + (static_cast<float>(p1[cG]) - p0[cG]) * w;
+        pb[x] = p0[cB] + (static_cast<float>(p1[cB]) - p0[cB]) * w;
+    }
+}
+
+/*
+pack bilinearly samples src at outW x outH, converts BGR to RGB, normalizes and writes planar
+CHW floats to dst. Each output row blends two cached horizontally-interpolated source rows with
+the folded scale/bias in a single vectorized pass per plane.
+*/
+bool CnnInputPacker::pack(const cv::Mat &src, int outW, int outH, float *dst)
+{
+    const int cn = src.channels();
+    if (src.empty() || dst == nullptr || outW <= 0 || outH <= 0 || src.depth() != CV_8U ||
+        (cn != 1 && cn != 3 && cn != 4))
+    {
+        return false;
+    }
+    prepareTables(src.cols, src.rows, outW, outH, cn);
+    // The row slots hold rows of the previous image; only the tables carry over between calls
+    bufRow_[0] = bufRow_[1] = -1;
+
+    const size_t planeSize = static_cast<size_t>(outW) * outH;
+    float *slots[2] = {rowBuf_.data(), rowBuf_.data() + 3 * outW};
+
+    for (int dy = 0; dy < outH; ++dy)
+    {
+        const int r0 = yIdx_[dy];
+        const int r1 = yIdx1_[dy];
+        const float wy = yW_[dy];
+
+        // Make sure rows r0 (and r1 when it contributes) are interpolated in one of the two slots
+        int s0 = (bufRow_[0] == r0) ? 0 : (bufRow_[1] == r0 ? 1 : -1);
+        if (s0 < 0)
+        {
+            s0 = (bufRow_[0] == r1 && wy > 0.0f) ? 1 : 0;
+            horizontalRow(src.ptr<uchar>(r0), slots[s0]);
+            bufRow_[s0] = r0;
+        }
+        int s1 = s0;
+        if (wy > 0.0f)
+        {
+            s1 = 1 - s0;
+            if (bufRow_[s1] != r1)
+            {
+                horizontalRow(src.ptr<uchar>(r1), slots[s1]);
+                bufRow_[s1] = r1;
+            }
+        }
+
+        for (int p = 0; p < 3; ++p)
+        {
+            const float *h0 = slots[s0] + p * outW;
+            const float *h1 = slots[s1] + p * outW;
+            float *out = dst + p * planeSize + static_cast<size_t>(dy) * outW;
+            const float a = (1.0f - wy) * scale_[p];
+            const float b = wy * scale_[p];
+            const float bias = bias_[p];
+
+            int x = 0;
+#if CV_SIMD128
+            const cv::v_float32x4 va = cv::v_setall_f32(a);
+            const cv::v_float32x4 vb = cv::v_setall_f32(b);
+            const cv::v_float32x4 vbias = cv::v_setall_f32(bias);
+            for (; x <= outW - 4; x += 4)
+            {
+                const cv::v_float32x4 v0 = cv::v_load(h0 + x);
+                const cv::v_float32x4 v1 = cv::v_load(h1 + x);
+                cv::v_store(out + x, cv::v_fma(v1, vb, cv::v_fma(v0, va, vbias)));
+            }
+#endif
+            for (; x < outW; ++x)
+            {
+                out[x] = h0[x] * a + h1[x] * b + bias;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,557 @@
+/*
+  Claire Liu, Yu-Jing Wei
+  cnnRunner.cpp
+
+  Path: src/utils/cnnRunner.cpp
+  Description: Runs ResNet18 inference with ONNX Runtime (preallocated, bound tensors) or OpenCV DNN.
+*/
+
+#include "cnnRunner.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // Default input resolution for models exported with dynamic spatial dims
+    constexpr int kDefaultInputSize = 224;
+
+    // ImageNet mean/std (R,G,B) used by ResNet18
+    const float kMean[3] = {0.485f, 0.456f, 0.406f};
+    const float kStd[3] = {0.229f, 0.224f, 0.225f};
+
+    /*
+    Writes one embedding from dim * pool output values: copied as is when pool == 1, otherwise
+    the average of each channel's pool spatial positions (global average pooling).
+    */
+    void poolEmbedding(const float *src, size_t dim, size_t pool, std::vector<float> *out)
+    {
+        if (pool <= 1)
+        {
+            out->assign(src, src + dim);
+            return;
+        }
+        out->resize(dim);
+        const float inv = 1.0f / static_cast<float>(pool);
+        for (size_t c = 0; c < dim; ++c)
+        {
+            const float *plane = src + c * pool;
+            float acc = 0.0f;
+            for (size_t k = 0; k < pool; ++k)
+                acc += plane[k];
+            (*out)[c] = acc * inv;
+        }
+    }
+
+    /*
+    Returns true if any of the needles occurs in the file. The file is scanned in 1 MB chunks that
+    overlap by the longest needle, so matches across chunk borders are found.
+    */
+    bool fileContainsAny(const std::string &path, const std::vector<std::string> &needles)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        size_t overlap = 0;
+        for (const auto &n : needles)
+            overlap = std::max(overlap, n.size());
+        std::string window;
+        std::vector<char> buf(1 << 20);
+        while (in)
+        {
+            in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+            const std::streamsize got = in.gcount();
+            if (got <= 0)
+                break;
+            window.append(buf.data(), static_cast<size_t>(got));
+            for (const auto &n : needles)
+            {
+                if (window.find(n) != std::string::npos)
+                    return true;
+            }
+            if (window.size() > overlap)
+                window.erase(0, window.size() - overlap);
+        }
+        return false;
+    }
+#if defined(ENABLE_ONNXRUNTIME)
+
+    /*
+    Returns the 64-bit FNV-1a hash of the file contents, or 0 if the file cannot be read.
+    */
+    uint64_t hashFile(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return 0;
+        uint64_t h = 1469598103934665603ULL;
+        std::vector<char> buf(1 << 20);
+        while (in)
+        {
+            in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+            const std::streamsize got = in.gcount();
+            for (std::streamsize i = 0; i < got; ++i)
+            {
+                h ^= static_cast<unsigned char>(buf[static_cast<size_t>(i)]);
+                h *= 1099511628211ULL;
+            }
+        }
+        return h;
+    }
+
+    /*
+    Returns the cache file for the optimized graph of the given model: <cacheDir>/<stem>-<hash>.ort.onnx,
+    where the hash covers the model bytes and the ONNX Runtime version. Empty when caching is disabled.
+    */
+    std::string optimizedModelPath(const CNNExtractor::Params &params)
+    {
+        if (params.cacheDir.empty())
+            return "";
+        uint64_t h = hashFile(params.modelPath);
+        if (h == 0)
+            return "";
+        for (char c : Ort::GetVersionString())
+        {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ULL;
+        }
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(h));
+        const std::filesystem::path model(params.modelPath);
+        return (std::filesystem::path(params.cacheDir) / (model.stem().string() + "-" + hex + ".ort.onnx")).string();
+    }
+#endif
+}
+
+/*
+acquire returns the shared runner for the given parameters, creating it on first use.
+Runners are kept for the lifetime of the process, like the previous function-local static.
+*/
+std::shared_ptr<ICnnRunner> ICnnRunner::acquire(const CNNExtractor::Params &params)
+{
+    static std::mutex registryMutex;
+    static std::map<std::string, std::shared_ptr<ICnnRunner>> registry;
+
+    std::string backend = params.backend;
+    if (backend.empty())
+    {
+#if defined(ENABLE_ONNXRUNTIME)
+        backend = "ort";
+#else
+        backend = "dnn";
+#endif
+    }
+    const std::string key = backend + "|" + params.modelPath + "|" + params.outputName + "|" +
+                            std::to_string(params.inputSize) + "|" + std::to_string(params.intraOpThreads) + "|" +
+                            std::to_string(params.interOpThreads);
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto it = registry.find(key);
+    if (it != registry.end())
+    {
+        return it->second;
+    }
+    std::shared_ptr<ICnnRunner> runner;
+    if (backend == "dnn")
+    {
+        runner = std::make_shared<DnnResNet18Runner>(params);
+    }
+    else if (backend == "ort")
+    {
+#if defined(ENABLE_ONNXRUNTIME)
+        runner = std::make_shared<OrtResNet18Runner>(params);
+#else
+        throw std::runtime_error("ONNX Runtime backend requested but not built (build with ONNXRUNTIME_DIR=...)");
+#endif
+    }
+    else
+    {
+        throw std::runtime_error("unknown CNN backend '" + backend + "' (expected ort or dnn)");
+    }
+    runner->precision_ = modelPrecision(params.modelPath);
+    registry.emplace(key, runner);
+    return runner;
+}
+
+/*
+modelPrecision reports "int8" when the ONNX graph contains quantization operators, "fp32" otherwise.
+Operator types are stored as plain strings in the protobuf, so a byte scan finds them without an ONNX
+parser. This covers dynamic quantization (DynamicQuantizeLinear, MatMulInteger, ConvInteger), static
+QDQ models (QuantizeLinear/DequantizeLinear pairs) and QOperator models (QLinearConv, QLinearMatMul, ...).
+*/
+std::string ICnnRunner::modelPrecision(const std::string &modelPath)
+{
+    static const std::vector<std::string> kQuantOps = {
+        "QuantizeLinear", "QLinear", "ConvInteger", "MatMulInteger"};
+    return fileContainsAny(modelPath, kQuantOps) ? "int8" : "fp32";
+}
+
+/*
+inferBatch runs infer() on each image; backends with native batching override it.
+*/
+int ICnnRunner::inferBatch(const std::vector<cv::Mat> &imgs, std::vector<std::vector<float>> *outVecs)
+{
+    if (!outVecs)
+        return -1;
+    outVecs->resize(imgs.size());
+    for (size_t i = 0; i < imgs.size(); ++i)
+    {
+        if (infer(imgs[i], &(*outVecs)[i]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+#if defined(ENABLE_ONNXRUNTIME)
+
+/*
+env returns the process-wide ONNX Runtime environment. ORT expects a single Env per process,
+so all runners share it.
+*/
+Ort::Env &OrtResNet18Runner::env()
+{
+    static Ort::Env sharedEnv(ORT_LOGGING_LEVEL_WARNING, "rtor_cnn");
+    return sharedEnv;
+}
+
+/*
+OrtResNet18Runner constructor creates the session with the configured thread counts, then
+allocates the input and output buffers once and binds them to the session via Ort::IoBinding.
+Graph optimization runs once per model: the optimized graph is written to the cache directory
+and later sessions load it with optimization disabled.
+*/
+OrtResNet18Runner::OrtResNet18Runner(const CNNExtractor::Params &params)
+{
+    const std::string cachePath = optimizedModelPath(params);
+    std::error_code ec;
+    if (!cachePath.empty() && std::filesystem::exists(cachePath, ec))
+    {
+        try
+        {
+            session_ = std::make_unique<Ort::Session>(env(), cachePath.c_str(), sessionOptions(params, true, ""));
+            loadedFromCache_ = true;
+        }
+        catch (const std::exception &e)
+        {
+            // A stale or truncated cache entry is discarded and rebuilt below
+            std::fprintf(stderr, "[CNN] ignoring optimized model cache %s: %s\n", cachePath.c_str(), e.what());
+            std::filesystem::remove(cachePath, ec);
+        }
+    }
+    if (!session_)
+    {
+        // Write to a temporary name so an interrupted run never leaves a partial cache entry behind
+        const std::string tmpPath = cachePath.empty() ? "" : cachePath + ".tmp";
+        if (!tmpPath.empty())
+            std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), ec);
+        session_ = std::make_unique<Ort::Session>(env(), params.modelPath.c_str(), sessionOptions(params, false, tmpPath));
+        if (!tmpPath.empty())
+        {
+            std::filesystem::rename(tmpPath, cachePath, ec);
+            if (ec)
+                std::fprintf(stderr, "[CNN] cannot write optimized model cache %s\n", cachePath.c_str());
+        }
+    }
+
+    Ort::AllocatorWithDefaultOptions allocator;
+    auto in = session_->GetInputNameAllocated(0, allocator);
+    inputName_ = in.get();
+
+    // Input resolution: fixed by the model, or configurable when the spatial dims are dynamic
+    const std::vector<int64_t> modelInShape = session_->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+    if (modelInShape.size() != 4)
+    {
+        throw std::runtime_error("model input is not NCHW");
+    }
+    if (modelInShape[2] > 0 && modelInShape[3] > 0)
+    {
+        if (modelInShape[2] != modelInShape[3])
+        {
+            throw std::runtime_error("model input is not square");
+        }
+        inputSize_ = static_cast<int>(modelInShape[2]);
+        if (params.inputSize > 0 && params.inputSize != inputSize_)
+        {
+            throw std::runtime_error("model has a fixed " + std::to_string(inputSize_) + "x" + std::to_string(inputSize_) +
+                                     " input; export it with dynamic spatial dims to run at " + std::to_string(params.inputSize));
+        }
+    }
+    else
+    {
+        inputSize_ = (params.inputSize > 0) ? params.inputSize : kDefaultInputSize;
+    }
+    const std::array<int64_t, 4> inShape = {1, 3, inputSize_, inputSize_};
+    inputBuf_.assign(static_cast<size_t>(3 * inputSize_ * inputSize_), 0.0f);
+    memInfo_ = Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+    inputTensor_ = Ort::Value::CreateTensor<float>(
+        memInfo_, inputBuf_.data(), inputBuf_.size(), inShape.data(), inShape.size());
+
+    // Select the tap point: the requested output name, or the model's first output by default
+    size_t outIndex = 0;
+    std::string available;
+    bool found = params.outputName.empty();
+    for (size_t i = 0; i < session_->GetOutputCount(); ++i)
+    {
+        auto name = session_->GetOutputNameAllocated(i, allocator);
+        available += (available.empty() ? "" : ", ") + std::string(name.get());
+        if (!found && params.outputName == name.get())
+        {
+            outIndex = i;
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        throw std::runtime_error("model has no output '" + params.outputName + "' (available: " + available + ")");
+    }
+    outputName_ = session_->GetOutputNameAllocated(outIndex, allocator).get();
+
+    // Output shape comes from the model with the batch dimension pinned to 1. Dynamic spatial dims
+    // (dynamic-shape models) are resolved by one probe run at the chosen input size.
+    std::vector<int64_t> outShape = session_->GetOutputTypeInfo(outIndex).GetTensorTypeAndShapeInfo().GetShape();
+    if (!outShape.empty())
+        outShape[0] = 1;
+    if (std::any_of(outShape.begin(), outShape.end(), [](int64_t d) { return d <= 0; }))
+    {
+        const char *inputNames[] = {inputName_.c_str()};
+        const char *outputNames[] = {outputName_.c_str()};
+        auto probe = session_->Run(runOptions_, inputNames, &inputTensor_, 1, outputNames, 1);
+        if (probe.empty() || !probe[0].IsTensor())
+        {
+            throw std::runtime_error("probe inference produced no output");
+        }
+        outShape = probe[0].GetTensorTypeAndShapeInfo().GetShape();
+    }
+    size_t outCount = 1;
+    for (auto &d : outShape)
+    {
+        if (d <= 0)
+            d = 1;
+        outCount *= static_cast<size_t>(d);
+    }
+    if (outShape.empty() || outCount == 0)
+    {
+        throw std::runtime_error("model output has no static shape");
+    }
+    // NxCxHxW feature maps are global-average-pooled to C values
+    poolSize_ = (outShape.size() == 4) ? static_cast<size_t>(outShape[2] * outShape[3]) : 1;
+    outputDim_ = outCount / poolSize_;
+
+    // Allocate the output buffer and bind the input/output tensors once
+    outputBuf_.assign(outCount, 0.0f);
+    outputTensor_ = Ort::Value::CreateTensor<float>(
+        memInfo_, outputBuf_.data(), outputBuf_.size(), outShape.data(), outShape.size());
+
+    binding_ = std::make_unique<Ort::IoBinding>(*session_);
+    binding_->BindInput(inputName_.c_str(), inputTensor_);
+    binding_->BindOutput(outputName_.c_str(), outputTensor_);
+
+    std::printf("[CNN] loaded %s%s (intra=%d inter=%d, input %dx%d, output %s, dim %zu%s)\n",
+                params.modelPath.c_str(), loadedFromCache_ ? " from optimized cache" : "", params.intraOpThreads, params.interOpThreads, inputSize_, inputSize_,
+                outputName_.c_str(), outputDim_, poolSize_ > 1 ? ", pooled" : "");
+}
+
+/*
+sessionOptions returns the session options for the given thread settings. A pre-optimized (cached)
+model is loaded with graph optimization disabled; otherwise extended optimizations run and, when
+saveOptimizedTo is set, the optimized graph is written there.
+*/
+Ort::SessionOptions OrtResNet18Runner::sessionOptions(
+    const CNNExtractor::Params &params, bool preOptimized, const std::string &saveOptimizedTo)
+{
+    Ort::SessionOptions options;
+    options.SetIntraOpNumThreads(params.intraOpThreads);
+    options.SetInterOpNumThreads(params.interOpThreads);
+    if (preOptimized)
+    {
+        options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+    }
+    else
+    {
+        options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+        if (!saveOptimizedTo.empty())
+            options.SetOptimizedModelFilePath(saveOptimizedTo.c_str());
+    }
+    return options;
+}
+
+/*
+warmup runs the network the given number of times on the current input buffer so that lazy
+allocations and kernel selection happen before the first real frame. Returns the elapsed time in ms.
+*/
+double OrtResNet18Runner::warmup(int runs)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i)
+    {
+        session_->Run(runOptions_, *binding_);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+/*
+infer runs the network on one image. The bound output buffer is copied (or channel-pooled) into outVec;
+callers that reuse outVec across calls therefore avoid any allocation after the first inference.
+*/
+int OrtResNet18Runner::infer(const cv::Mat &img, std::vector<float> *outVec)
+{
+    if (!outVec || img.empty())
+        return -1;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Resize, BGR->RGB, normalize and pack to NCHW straight into the bound input in one pass
+    if (!packer_.pack(img, inputSize_, inputSize_, inputBuf_.data()))
+        return -1;
+    session_->Run(runOptions_, *binding_);
+
+    poolEmbedding(outputBuf_.data(), outputDim_, poolSize_, outVec);
+    return outVec->empty() ? -1 : 0;
+}
+#endif
+
+/*
+DnnResNet18Runner constructor loads the ONNX model into OpenCV DNN on the CPU backend and runs one
+probe forward pass to learn the embedding dimension of the selected output.
+*/
+DnnResNet18Runner::DnnResNet18Runner(const CNNExtractor::Params &params)
+{
+    net_ = cv::dnn::readNetFromONNX(params.modelPath);
+    if (net_.empty())
+    {
+        throw std::runtime_error("cannot load " + params.modelPath + " with OpenCV DNN");
+    }
+    net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+
+    // OpenCV DNN does not expose the ONNX input shape before the first forward pass
+    inputSize_ = (params.inputSize > 0) ? params.inputSize : kDefaultInputSize;
+    outputName_ = params.outputName;
+    if (outputName_.empty())
+    {
+        const std::vector<std::string> outs = net_.getUnconnectedOutLayersNames();
+        if (!outs.empty())
+            outputName_ = outs[0];
+    }
+
+    single_.assign(1, cv::Mat(inputSize_, inputSize_, CV_8UC3, cv::Scalar(0, 0, 0)));
+    const cv::Mat out = forward(single_);
+    if (out.empty() || out.dims < 2)
+    {
+        throw std::runtime_error("OpenCV DNN probe inference produced no output");
+    }
+    const size_t pool = (out.dims == 4) ? static_cast<size_t>(out.size[2]) * out.size[3] : 1;
+    outputDim_ = out.total() / static_cast<size_t>(out.size[0]) / pool;
+
+    std::printf("[CNN] loaded %s with OpenCV DNN (input %dx%d, output %s, dim %zu%s)\n",
+                params.modelPath.c_str(), inputSize_, inputSize_, outputName_.c_str(), outputDim_,
+                pool > 1 ? ", pooled" : "");
+}
+
+/*
+forward packs the crops into one NCHW blob with blobFromImages ((x - 255*mean) / 255, BGR->RGB, bilinear
+resize), divides each channel by the ImageNet std and returns the selected output for the whole batch.
+*/
+cv::Mat DnnResNet18Runner::forward(const std::vector<cv::Mat> &imgs)
+{
+    // blobFromImages needs a common channel count; the crops are BGR, other layouts are converted
+    const std::vector<cv::Mat> *batch = &imgs;
+    std::vector<cv::Mat> converted;
+    if (std::any_of(imgs.begin(), imgs.end(), [](const cv::Mat &m) { return m.channels() != 3; }))
+    {
+        converted.resize(imgs.size());
+        for (size_t i = 0; i < imgs.size(); ++i)
+        {
+            if (imgs[i].channels() == 1)
+                cv::cvtColor(imgs[i], converted[i], cv::COLOR_GRAY2BGR);
+            else if (imgs[i].channels() == 4)
+                cv::cvtColor(imgs[i], converted[i], cv::COLOR_BGRA2BGR);
+            else
+                converted[i] = imgs[i];
+        }
+        batch = &converted;
+    }
+
+    cv::Mat blob = cv::dnn::blobFromImages(*batch, 1.0 / 255.0, cv::Size(inputSize_, inputSize_),
+                                           cv::Scalar(255.0 * kMean[0], 255.0 * kMean[1], 255.0 * kMean[2]),
+                                           /*swapRB*/ true, /*crop*/ false, CV_32F);
+    const size_t plane = static_cast<size_t>(inputSize_) * inputSize_;
+    for (size_t n = 0; n < batch->size(); ++n)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            cv::Mat p(inputSize_, inputSize_, CV_32F, blob.ptr<float>() + (n * 3 + c) * plane);
+            p *= 1.0 / kStd[c];
+        }
+    }
+    net_.setInput(blob);
+    return net_.forward(outputName_);
+}
+
+/*
+infer runs a one-image batch.
+*/
+int DnnResNet18Runner::infer(const cv::Mat &img, std::vector<float> *outVec)
+{
+    if (!outVec || img.empty() || img.depth() != CV_8U)
+        return -1;
+    std::lock_guard<std::mutex> lock(mutex_);
+    single_[0] = img;
+    const cv::Mat out = forward(single_);
+    const size_t pool = (out.dims == 4) ? static_cast<size_t>(out.size[2]) * out.size[3] : 1;
+    if (out.empty() || out.total() != outputDim_ * pool)
+        return -1;
+    poolEmbedding(out.ptr<float>(), outputDim_, pool, outVec);
+    return outVec->empty() ? -1 : 0;
+}
+
+/*
+inferBatch runs all crops in one forward pass and splits the output per image.
+*/
+int DnnResNet18Runner::inferBatch(const std::vector<cv::Mat> &imgs, std::vector<std::vector<float>> *outVecs)
+{
+    if (!outVecs)
+        return -1;
+    outVecs->resize(imgs.size());
+    if (imgs.empty())
+        return 0;
+    for (const auto &img : imgs)
+    {
+        if (img.empty() || img.depth() != CV_8U)
+            return -1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    const cv::Mat out = forward(imgs);
+    const size_t pool = (out.dims == 4) ? static_cast<size_t>(out.size[2]) * out.size[3] : 1;
+    if (out.empty() || out.total() != imgs.size() * outputDim_ * pool)
+        return -1;
+    const float *data = out.ptr<float>();
+    for (size_t i = 0; i < imgs.size(); ++i)
+    {
+        poolEmbedding(data + i * outputDim_ * pool, outputDim_, pool, &(*outVecs)[i]);
+    }
+    return 0;
+}
+
+/*
+warmup runs the one-image batch the given number of times and returns the elapsed time in ms.
+*/
+double DnnResNet18Runner::warmup(int runs)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i)
+    {
+        if (single_[0].empty())
+            single_[0] = cv::Mat(inputSize_, inputSize_, CV_8UC3, cv::Scalar(0, 0, 0));
+        forward(single_);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
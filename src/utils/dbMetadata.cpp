@@ -0,0 +1,90 @@
+/*
+  Claire Liu, Yu-Jing Wei
+  dbMetadata.cpp
+
+  Path: src/utils/dbMetadata.cpp
+  Description: Reads, writes and compares the metadata header of feature database CSV files.
+*/
+
+#include "dbMetadata.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    // Prefix of the metadata header line
+    const char *kMetaTag = "#meta";
+}
+
+/*
+read parses the "#meta,key=value,..." header line of the given feature CSV into meta.
+Returns false if the file cannot be opened or does not start with a metadata header.
+*/
+bool dbMetadata::read(const std::string &csvPath, DbMetadata &meta)
+{
+    meta.clear();
+    std::ifstream ifs(csvPath);
+    std::string line;
+    if (!ifs.is_open() || !std::getline(ifs, line))
+    {
+        return false;
+    }
+    std::stringstream ss(line);
+    std::string token;
+    if (!std::getline(ss, token, ',') || token != kMetaTag)
+    {
+        return false;
+    }
+    while (std::getline(ss, token, ','))
+    {
+        const auto eq = token.find('=');
+        if (eq == std::string::npos)
+            continue;
+        meta[token.substr(0, eq)] = token.substr(eq + 1);
+    }
+    return true;
+}
+
+/*
+write clears the given feature CSV and writes the metadata header as its first line.
+*/
+int dbMetadata::write(const std::string &csvPath, const DbMetadata &meta)
+{
+    FILE *fp = std::fopen(csvPath.c_str(), "w");
+    if (!fp)
+    {
+        std::printf("Unable to open output file %s\n", csvPath.c_str());
+        return -1;
+    }
+    std::fputs(kMetaTag, fp);
+    for (const auto &kv : meta)
+    {
+        std::fprintf(fp, ",%s=%s", kv.first.c_str(), kv.second.c_str());
+    }
+    std::fputs("\n", fp);
+    std::fclose(fp);
+    return 0;
+}
+
+/*
+compatible returns true when every key recorded in both stored and expected has the same value.
+Keys missing on either side (e.g. databases written before a key existed) are not compared.
+*/
+bool dbMetadata::compatible(const DbMetadata &stored, const DbMetadata &expected, std::string *reason)
+{
+    for (const auto &kv : expected)
+    {
+        auto it = stored.find(kv.first);
+        if (it != stored.end() && it->second != kv.second)
+        {
+            if (reason)
+            {
+                *reason = kv.first + "=" + it->second + " in DB, extractor has " + kv.first + "=" + kv.second;
+            }
+            return false;
+        }
+    }
+    return true;
+}
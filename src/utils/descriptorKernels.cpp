@@ -0,0 +1,154 @@
+/*
+  Claire Liu, Yu-Jing Wei
+  descriptorKernels.cpp
+
+  Path: src/utils/descriptorKernels.cpp
+  Description: Vectorized row kernels for the color-histogram and HOG descriptors.
+*/
+
+#include "descriptorKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/core/hal/hal.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+namespace
+{
+#if CV_SIMD128
+    // Widen 16 uint8 lanes to four float vectors.
+    inline void expandU8ToF32(const cv::v_uint8x16 &v, cv::v_float32x4 out[4])
+    {
+        cv::v_uint16x8 lo16, hi16;
+        cv::v_expand(v, lo16, hi16);
+        cv::v_uint32x4 a, b, c, d;
+        cv::v_expand(lo16, a, b);
+        cv::v_expand(hi16, c, d);
+        out[0] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(a));
+        out[1] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(b));
+        out[2] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(c));
+        out[3] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d));
+    }
+#endif
+}
+
+/*
+accumulateRgChroma computes the bin index of 16 pixels at a time in SIMD registers (deinterleave, widen,
+chromaticity, truncate, clamp) and then scatters the masked ones into the histogram. The scatter stays
+scalar because lanes may hit the same bin.
+*/
+void descriptorKernels::accumulateRgChroma(const uchar *bgr, const uchar *mask, int width, int bins, float *hist)
+{
+    const float fBins = static_cast<float>(bins);
+    int x = 0;
+#if CV_SIMD128
+    const cv::v_float32x4 vBins = cv::v_setall_f32(fBins);
+    const cv::v_float32x4 vDark = cv::v_setall_f32(kDarkSum);
+    const cv::v_float32x4 vOne = cv::v_setall_f32(1.0f);
+    const cv::v_float32x4 vThree = cv::v_setall_f32(3.0f);
+    const cv::v_int32x4 vMaxBin = cv::v_setall_s32(bins - 1);
+    const cv::v_int32x4 vStride = cv::v_setall_s32(bins);
+    int idx[16];
+    for (; x <= width - 16; x += 16)
+    {
+        cv::v_uint8x16 b8, g8, r8;
+        cv::v_load_deinterleave(bgr + 3 * x, b8, g8, r8);
+        cv::v_float32x4 b[4], g[4], r[4];
+        expandU8ToF32(b8, b);
+        expandU8ToF32(g8, g);
+        expandU8ToF32(r8, r);
+        for (int k = 0; k < 4; ++k)
+        {
+            cv::v_float32x4 sum = cv::v_add(cv::v_add(b[k], g[k]), r[k]);
+            const cv::v_float32x4 dark = vDark > sum;
+            const cv::v_float32x4 rr = cv::v_select(dark, vOne, r[k]);
+            const cv::v_float32x4 gg = cv::v_select(dark, vOne, g[k]);
+            sum = cv::v_select(dark, vThree, sum);
+            const cv::v_int32x4 rBin = cv::v_min(cv::v_trunc(cv::v_div(cv::v_mul(rr, vBins), sum)), vMaxBin);
+            const cv::v_int32x4 gBin = cv::v_min(cv::v_trunc(cv::v_div(cv::v_mul(gg, vBins), sum)), vMaxBin);
+            cv::v_store(idx + 4 * k, cv::v_add(cv::v_mul(rBin, vStride), gBin));
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            if (!mask || mask[x + i])
+                hist[idx[i]] += 1.0f;
+        }
+    }
+#endif
+    for (; x < width; ++x)
+    {
+        if (mask && !mask[x])
+            continue;
+        const uchar *p = bgr + 3 * x;
+        float r = p[2], g = p[1];
+        float sum = static_cast<float>(p[0]) + g + r;
+        if (sum < kDarkSum)
+        {
+            r = g = 1.0f;
+            sum = 3.0f;
+        }
+        const int rBin = std::min(static_cast<int>(r * fBins / sum), bins - 1);
+        const int gBin = std::min(static_cast<int>(g * fBins / sum), bins - 1);
+        hist[rBin * bins + gBin] += 1.0f;
+    }
+}
+
+/*
+orientedGradientsRow runs in three passes over the row: SIMD central differences and magnitudes, OpenCV's
+vectorized fastAtan32f for the orientation (0-360 degrees), and SIMD bin/weight computation. Orientations are
+binned over the full circle with bins per half turn, so a gradient and its opposite land in the same bin once
+bin0 is reduced modulo bins; this avoids a per-lane fold to 0-180 degrees.
+*/
+void descriptorKernels::orientedGradientsRow(const float *above, const float *row, const float *below, int width,
+                                             int bins, float *gx, float *gy, int *bin0, float *w0, float *w1)
+{
+    // Pass 1: gradients; the magnitude is parked in w0 until pass 3
+    int x = 0;
+#if CV_SIMD128
+    for (; x <= width - 4; x += 4)
+    {
+        const cv::v_float32x4 dx = cv::v_sub(cv::v_load(row + x + 2), cv::v_load(row + x));
+        const cv::v_float32x4 dy = cv::v_sub(cv::v_load(below + x + 1), cv::v_load(above + x + 1));
+        cv::v_store(gx + x, dx);
+        cv::v_store(gy + x, dy);
+        cv::v_store(w0 + x, cv::v_sqrt(cv::v_fma(dx, dx, cv::v_mul(dy, dy))));
+    }
+#endif
+    for (; x < width; ++x)
+    {
+        gx[x] = row[x + 2] - row[x];
+        gy[x] = below[x + 1] - above[x + 1];
+        w0[x] = std::sqrt(std::fma(gx[x], gx[x], gy[x] * gy[x]));
+    }
+
+    // Pass 2: orientation in degrees, parked in w1
+    cv::hal::fastAtan32f(gy, gx, w1, width, true);
+
+    // Pass 3: linear split of the magnitude between the two nearest bins
+    const float binsPerDeg = static_cast<float>(bins) / 180.0f;
+    x = 0;
+#if CV_SIMD128
+    const cv::v_float32x4 vScale = cv::v_setall_f32(binsPerDeg);
+    const cv::v_float32x4 vHalf = cv::v_setall_f32(0.5f);
+    for (; x <= width - 4; x += 4)
+    {
+        const cv::v_float32x4 pos = cv::v_sub(cv::v_mul(cv::v_load(w1 + x), vScale), vHalf);
+        const cv::v_int32x4 b = cv::v_floor(pos);
+        const cv::v_float32x4 mag = cv::v_load(w0 + x);
+        const cv::v_float32x4 upper = cv::v_mul(mag, cv::v_sub(pos, cv::v_cvt_f32(b)));
+        cv::v_store(bin0 + x, b);
+        cv::v_store(w1 + x, upper);
+        cv::v_store(w0 + x, cv::v_sub(mag, upper));
+    }
+#endif
+    for (; x < width; ++x)
+    {
+        const float pos = w1[x] * binsPerDeg - 0.5f;
+        const int b = static_cast<int>(std::floor(pos));
+        const float mag = w0[x];
+        const float upper = mag * (pos - static_cast<float>(b));
+        bin0[x] = b;
+        w1[x] = upper;
+        w0[x] = mag - upper;
+    }
+}
@@ -7,6 +7,7 @@
 */
 
 #include "distanceMetrics.hpp"
+#include "distanceKernels.hpp"
 #include "csvUtil.hpp"
 #include "opencv2/opencv.hpp"
 #include <cstdio>
@@ -22,27 +23,26 @@ Lower values indicate more similar features.
 
 - @param v1 The first feature vector.
 - @param v2 The second feature vector.
+- @param n The length of both vectors.
 - @return The computed SSD distance between the two vectors.
-    If the vectors are of different lengths, it returns INFINITY.
 */
 float SumSquaredDistance::compute(
-    const std::vector<float> &v1,
-    const std::vector<float> &v2) const
+    const float *v1,
+    const float *v2,
+    size_t n) const
 {
-    // v1 and v2 not the same size, return infinity to indicate they cannot be compared
-    if (v1.size() != v2.size())
-    {
-        printf("Feature vectors size does not match\n");
-        return std::numeric_limits<float>::infinity();
-    }
+    return distanceKernels::SSD().distance<0>(v1, v2, static_cast<int>(n));
+}
 
-    float sum = 0.0f; // Initialize the sum of squared differences as 0
-    for (size_t i = 0; i < v1.size(); ++i)
-    {
-        float diff = v1[i] - v2[i];
-        sum += diff * diff;
-    }
-    return sum;
+/*
+SumSquaredDistance::computeMany writes the SSD from query to each row of the contiguous matrix into out,
+using the vectorized kernel specialized for dim.
+*/
+void SumSquaredDistance::computeMany(const float *query, const float *matrix, size_t n, size_t dim, float *out,
+                                     const float *rowNorms) const
+{
+    (void)rowNorms;
+    distanceKernels::computeMany(distanceKernels::SSD(), query, matrix, n, static_cast<int>(dim), out);
 }
 
 /*
@@ -53,26 +53,27 @@ subtracting from 1.
 
 - @param v1 The first feature vector (normalized).
 - @param v2 The second feature vector (normalized).
+- @param n The length of both vectors.
 - @return The computed histogram intersection distance between the two vectors.
-    If the vectors are of different lengths, it returns INFINITY.
 */
 float HistogramIntersection::compute(
-    const std::vector<float> &v1,
-    const std::vector<float> &v2) const
+    const float *v1,
+    const float *v2,
+    size_t n) const
 {
-    // v1 and v2 not the same size, return infinity to indicate they cannot be compared
-    if (v1.size() != v2.size())
-    {
-        printf("Feature vectors size does not match\n");
-        return std::numeric_limits<float>::infinity();
-    }
+    // The kernel returns 1 - sum of minima, converting similarity to distance
+    return distanceKernels::HistIntersection().distance<0>(v1, v2, static_cast<int>(n));
+}
 
-    float intersection = 0.0f; // Initialize the intersection value as 0
-    for (size_t i = 0; i < v1.size(); ++i)
-    {
-        intersection += std::min(v1[i], v2[i]);
-    }
-    return 1.0f - intersection; // Convert similarity to distance
+/*
+HistogramIntersection::computeMany writes the intersection distance from query to each row of the contiguous
+matrix into out, using the vectorized kernel specialized for dim.
+*/
+void HistogramIntersection::computeMany(const float *query, const float *matrix, size_t n, size_t dim, float *out,
+                                        const float *rowNorms) const
+{
+    (void)rowNorms;
+    distanceKernels::computeMany(distanceKernels::HistIntersection(), query, matrix, n, static_cast<int>(dim), out);
 }
 
 /*
@@ -82,33 +83,29 @@ float HistogramIntersection::compute(
  *
  * @param v1 The first feature vector.
  * @param v2 The second feature vector.
+ * @param n The length of both vectors.
  * @return The computed cosine distance.
  * Returns 1.0 if either vector has zero magnitude (undefined angle).
  */
 float CosDistance::compute(
-    const std::vector<float> &v1,
-    const std::vector<float> &v2) const
+    const float *v1,
+    const float *v2,
+    size_t n) const
 {
-    // Inner Product
-    double dot = std::inner_product(v1.begin(), v1.end(), v2.begin(), 0.0);
-
-    // sum square
-    double sum_sq1 = std::inner_product(v1.begin(), v1.end(), v1.begin(), 0.0);
-    double sum_sq2 = std::inner_product(v2.begin(), v2.end(), v2.begin(), 0.0);
-
-    // L2 norm
-    double norm1 = std::sqrt(sum_sq1);
-    double norm2 = std::sqrt(sum_sq2);
-
-    // avoid 0
-    if (norm1 == 0.0 || norm2 == 0.0)
-    {
-        return 1.0f;
-    }
-
-    // Cosine Similarity
-    double similarity = dot / (norm1 * norm2);
+    return distanceKernels::Cosine().distance<0>(v1, v2, static_cast<int>(n));
+}
 
-    // Transfer Cosine distance
-    return static_cast<float>(1.0 - similarity);
-}
\ No newline at end of file
+/*
+CosDistance::computeMany writes the cosine distance from query to each row of the contiguous matrix into out.
+With the row norms supplied (e.g. cached with the database) a row costs one dot product; without them the
+row norm is computed alongside.
+*/
+void CosDistance::computeMany(const float *query, const float *matrix, size_t n, size_t dim, float *out,
+                              const float *rowNorms) const
+{
+    const int d = static_cast<int>(dim);
+    if (rowNorms)
+        distanceKernels::cosineMany(query, matrix, rowNorms, n, d, out);
+    else
+        distanceKernels::computeMany(distanceKernels::Cosine(query, d), query, matrix, n, d, out);
+}
@@ -0,0 +1,151 @@
+/*
+Claire Liu, Yu-Jing Wei
+evaluatorCLI.cpp
+
+Path: src/utils/evaluatorCLI.cpp
+Description: Command line interface for the extractor evaluator.
+*/
+
+#include "evaluatorCLI.hpp"
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+/*
+Parses command line arguments for the evaluator.
+- @param argc The number of command line arguments.
+- @param argv An array of character pointers representing the command line arguments.
+- @return An Args struct containing the parsed arguments.
+*/
+EvaluatorCLI::Args EvaluatorCLI::parse(int argc, char *argv[])
+{
+    Args args;
+
+    static struct option long_options[] = {
+        {"input", required_argument, 0, 'i'},
+        {"extractor", required_argument, 0, 'e'},
+        {"model", required_argument, 0, 'm'},
+        {"layers", required_argument, 0, 'l'},
+        {"size", required_argument, 0, 's'},
+        {"backends", required_argument, 0, 'b'},
+        {"batch", required_argument, 0, 'B'},
+        {"intra-threads", required_argument, 0, 't'},
+        {"inter-threads", required_argument, 0, 'T'},
+        {"compare-model", required_argument, 0, 'q'},
+        {"knn", required_argument, 0, 'k'},
+        {"vote", required_argument, 0, 'v'},
+        {"bench-metrics", no_argument, 0, 'M'},
+        {"bench-search", no_argument, 0, 'S'},
+        {"bench-packer", no_argument, 0, 'P'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}};
+
+    optind = 1; // reset getopt state
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:e:m:l:s:b:B:t:T:q:k:v:MSPh", long_options, nullptr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            args.inputDir = optarg;
+            break;
+        case 'e':
+            args.extractorStr = optarg;
+            break;
+        case 'm':
+            args.modelPath = optarg;
+            break;
+        case 'l':
+        {
+            // comma-separated list of output names
+            std::stringstream ss(optarg);
+            std::string name;
+            while (std::getline(ss, name, ','))
+            {
+                args.layers.push_back(name);
+            }
+            break;
+        }
+        case 'b':
+        {
+            // comma-separated list of backends
+            std::stringstream ss(optarg);
+            std::string name;
+            while (std::getline(ss, name, ','))
+            {
+                args.backends.push_back(name);
+            }
+            break;
+        }
+        case 'B':
+            args.batchSize = std::atoi(optarg);
+            break;
+        case 's':
+            args.inputSize = std::atoi(optarg);
+            break;
+        case 't':
+            args.intraOpThreads = std::atoi(optarg);
+            break;
+        case 'T':
+            args.interOpThreads = std::atoi(optarg);
+            break;
+        case 'q':
+            args.compareModelPath = optarg;
+            break;
+        case 'k':
+            args.knn = std::atoi(optarg);
+            break;
+        case 'v':
+            args.vote = optarg;
+            break;
+        case 'M':
+            args.benchMetrics = true;
+            break;
+        case 'S':
+            args.benchSearch = true;
+            break;
+        case 'P':
+            args.benchPacker = true;
+            break;
+        case 'h':
+        default:
+            args.showHelp = true;
+            break;
+        }
+    }
+    return args;
+}
+
+/*
+Prints the usage information for the evaluator.
+- @param prog The name of the program.
+*/
+void EvaluatorCLI::printUsage(const char *prog)
+{
+    printf("usage:\n");
+    printf("  %s --input <dir> --extractor <type> [--model <onnx>] [--layers <name,name,...>] [--size <px>] [--backends <ort,dnn>] [--batch <n>] [--compare-model <int8.onnx>] [--knn <k> --vote <min|majority|weighted>]\n", prog);
+    printf("  %s -i <dir> -e <type> [-m <onnx>] [-l <name,name,...>] [-s <px>] [-b <ort,dnn>] [-B <n>] [-t <n>] [-T <n>] [-q <int8.onnx>] [-k <k> -v <vote>]\n", prog);
+    printf("  %s --bench-metrics\n", prog);
+    printf("  %s --bench-search\n", prog);
+    printf("  %s --bench-packer\n", prog);
+    printf("\n");
+    printf("options:\n");
+    printf("  -i, --input      <dir>       labelled sample image directory\n");
+    printf("  -e, --extractor  <type>      baseline | cnn | color_hist | hog\n");
+    printf("  -m, --model      <onnx>      CNN model path\n");
+    printf("  -l, --layers     <names>     CNN outputs (tap points) to compare, comma-separated\n");
+    printf("  -s, --size       <px>        CNN input size (dynamic-shape models only)\n");
+    printf("  -b, --backends   <names>     CNN backends to compare: ort, dnn (comma-separated)\n");
+    printf("  -B, --batch      <n>         batch size for the batched throughput column (default 8)\n");
+    printf("  -t, --intra-threads <n>      ONNX Runtime intra-op threads\n");
+    printf("  -T, --inter-threads <n>      ONNX Runtime inter-op threads\n");
+    printf("  -q, --compare-model <onnx>   INT8 model to compare against --model: latency, LOO top-1, top-1 agreement\n");
+    printf("  -k, --knn        <k>         leave-one-out label from the k nearest samples (default 1)\n");
+    printf("  -v, --vote       <vote>      min | majority | weighted: label vote over the k samples (default min)\n");
+    printf("  -M, --bench-metrics          distance-metric microbenchmark (dims 9/512/1000, 1e2-1e6 rows), no input needed\n");
+    printf("  -S, --bench-search           search-index benchmark (linear, pruned, hnsw, ivf, pq): ms/query, skipped share, recall@1 (dims 64/512, 1e4-1e6 rows)\n");
+    printf("  -P, --bench-packer           CNN input packing: fused packer vs. resize/cvtColor/convertTo (ms, max difference), no input needed\n");
+    printf("  -h, --help                   show help\n");
+}
@@ -7,6 +7,8 @@
 */
 
 #include "extractor.hpp"
+#include "cnnRunner.hpp"
+#include "descriptorKernels.hpp"
 #include "preProcessor.hpp"
 #include "regionDetect.hpp"
 #include "regionAnalyzer.hpp"
@@ -18,17 +20,14 @@
 #include <cmath>
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <filesystem>
 #include <memory>
 #include <string>
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 
-// If ONNXRUNTIME is enabled, include the header for ONNX Runtime C++ API
-#if defined(ENABLE_ONNXRUNTIME)
-#include <onnxruntime/onnxruntime_cxx_api.h>
-#endif
-
 /*
 BaselineExtractor extracts a handcrafted feature vector from the given image or region for use in the baseline extractor mode.
 The extractMat function processes the whole image to find the largest region and then extracts features from that region,
@@ -42,15 +41,31 @@ int BaselineExtractor::extractRegion(
     {
         return -1;
     }
-    // get the shape feature vector for the region and convert it to a float vector for output
-    const std::vector<double> shape = getShapeFeatureVector(region);
-    featureVector->clear();
-    featureVector->reserve(shape.size());
-    for (double v : shape)
+    featureVector->resize(kShapeFeatureDim);
+    return extractRegionInto(region, featureVector->data());
+}
+
+/*
+BaselineExtractor::extractRegionInto writes the shape features of the region straight into out (kShapeFeatureDim floats).
+*/
+int BaselineExtractor::extractRegionInto(const RegionFeatures &region, float *out) const
+{
+    if (!out)
     {
-        featureVector->push_back(static_cast<float>(v));
+        return -1;
     }
-    return featureVector->empty() ? -1 : 0;
+    writeShapeFeatures(region, out);
+    return 0;
+}
+
+/*
+BaselineExtractor::metadata records the extractor type and the 9-d shape feature dimension.
+*/
+DbMetadata BaselineExtractor::metadata() const
+{
+    DbMetadata meta = IExtractor::metadata();
+    meta["dim"] = std::to_string(dim());
+    return meta;
 }
 
 /*
@@ -98,9 +113,162 @@ int BaselineExtractor::extractMat(
     return extractRegion(*best, featureVector);
 }
 
+/*
+CNNExtractor::Params::fromEnv builds the CNN parameters from environment variables:
+- RTOR_CNN_MODEL: ONNX model path (default ./data/resnet18-v2-7.onnx)
+- RTOR_CNN_INTRA_THREADS / RTOR_CNN_INTER_THREADS: ONNX Runtime thread counts (default 1)
+- RTOR_CNN_CACHE_DIR: directory of the optimized-model cache (default ./data/ort_cache, empty disables it)
+- RTOR_CNN_WARMUP: warm-up inferences run by initialize() (default 1)
+- RTOR_CNN_BACKEND: ort | dnn (default: ort when built with ONNX Runtime, dnn otherwise)
+*/
+CNNExtractor::Params CNNExtractor::Params::fromEnv()
+{
+    Params params;
+    const char *modelPathEnv = std::getenv("RTOR_CNN_MODEL");
+    if (modelPathEnv && std::strlen(modelPathEnv) > 0)
+    {
+        params.modelPath = modelPathEnv;
+    }
+    const char *intraEnv = std::getenv("RTOR_CNN_INTRA_THREADS");
+    if (intraEnv && std::atoi(intraEnv) > 0)
+    {
+        params.intraOpThreads = std::atoi(intraEnv);
+    }
+    const char *interEnv = std::getenv("RTOR_CNN_INTER_THREADS");
+    if (interEnv && std::atoi(interEnv) > 0)
+    {
+        params.interOpThreads = std::atoi(interEnv);
+    }
+    const char *outputEnv = std::getenv("RTOR_CNN_OUTPUT");
+    if (outputEnv && std::strlen(outputEnv) > 0)
+    {
+        params.outputName = outputEnv;
+    }
+    const char *sizeEnv = std::getenv("RTOR_CNN_INPUT_SIZE");
+    if (sizeEnv && std::atoi(sizeEnv) > 0)
+    {
+        params.inputSize = std::atoi(sizeEnv);
+    }
+    // An empty RTOR_CNN_CACHE_DIR disables the optimized-model cache
+    const char *cacheEnv = std::getenv("RTOR_CNN_CACHE_DIR");
+    if (cacheEnv)
+    {
+        params.cacheDir = cacheEnv;
+    }
+    const char *backendEnv = std::getenv("RTOR_CNN_BACKEND");
+    if (backendEnv)
+    {
+        params.backend = backendEnv;
+    }
+    const char *warmupEnv = std::getenv("RTOR_CNN_WARMUP");
+    if (warmupEnv && std::atoi(warmupEnv) >= 0)
+    {
+        params.warmupRuns = std::atoi(warmupEnv);
+    }
+    return params;
+}
+
+/*
+CNNExtractor::initialize loads the model now instead of on the first extraction and runs the configured
+warm-up inferences, reporting how long each step took. Returns -1 if the model cannot be loaded.
+*/
+int CNNExtractor::initialize()
+{
+    try
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        auto r = runner();
+        const auto t1 = std::chrono::steady_clock::now();
+        const double warmupMs = r->warmup(params_.warmupRuns);
+        std::printf("[CNN] startup %.1f ms (%s %s, %s session %.1f ms, warm-up %d run(s) %.1f ms)\n",
+                    std::chrono::duration<double, std::milli>(t1 - t0).count() + warmupMs, r->backendName(),
+                    r->precision().c_str(),
+                    r->loadedFromCache() ? "warm" : "cold",
+                    std::chrono::duration<double, std::milli>(t1 - t0).count(),
+                    params_.warmupRuns, warmupMs);
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "[CNN] model initialization failed: %s\n", e.what());
+        return -1;
+    }
+}
+
+/*
+CNNExtractor::runner resolves the shared inference backend (ONNX Runtime or OpenCV DNN) on first use.
+Throws if the model cannot be loaded.
+*/
+std::shared_ptr<ICnnRunner> CNNExtractor::runner() const
+{
+    std::lock_guard<std::mutex> lock(runnerMutex_);
+    if (!runner_)
+    {
+        runner_ = ICnnRunner::acquire(params_);
+    }
+    return runner_;
+}
+
+/*
+CNNExtractor::inputSize returns the side of the crop fed to the network. Falls back to the configured
+size (or 224) when the model cannot be loaded, so callers still produce a crop.
+*/
+int CNNExtractor::inputSize() const
+{
+    try
+    {
+        return runner()->inputSize();
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "[CNN] cannot load model for input size: %s\n", e.what());
+    }
+    return params_.inputSize > 0 ? params_.inputSize : IExtractor::inputSize();
+}
+
+/*
+CNNExtractor::dim returns the embedding dimension of the loaded model, or 0 when it cannot be loaded.
+*/
+int CNNExtractor::dim() const
+{
+    try
+    {
+        return static_cast<int>(runner()->outputDim());
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "[CNN] cannot load model for dimension: %s\n", e.what());
+    }
+    return 0;
+}
+
+/*
+CNNExtractor::metadata records the model file, its precision (fp32 or int8), the tap point (output name),
+the input resolution and the embedding dimension so that databases built with different layers, resolutions
+or quantized/unquantized models are not mixed.
+*/
+DbMetadata CNNExtractor::metadata() const
+{
+    DbMetadata meta = IExtractor::metadata();
+    meta["model"] = std::filesystem::path(params_.modelPath).filename().string();
+    try
+    {
+        auto r = runner();
+        meta["precision"] = r->precision();
+        meta["layer"] = r->outputName();
+        meta["input"] = std::to_string(r->inputSize());
+        meta["dim"] = std::to_string(r->outputDim());
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "[CNN] cannot load model for metadata: %s\n", e.what());
+    }
+    return meta;
+}
+
 /*
 CNNExtractor::extractMat processes the input image to extract a feature vector using a CNN model.
-If ONNXRUNTIME is enabled, it runs inference using the specified ONNX model; otherwise, it returns an error.
+Inference runs through the shared runner of the configured backend (ONNX Runtime or OpenCV DNN).
 */
 int CNNExtractor::extractMat(
     const cv::Mat &image,
@@ -110,146 +278,217 @@ int CNNExtractor::extractMat(
     {
         return -1;
     }
-// The actual CNN inference logic is implemented in the OrtResNet18Runner class below
-#if defined(ENABLE_ONNXRUNTIME)
-    class OrtResNet18Runner
+    try
     {
-    public:
-        OrtResNet18Runner()
-            : env_(ORT_LOGGING_LEVEL_WARNING, "rtor_cnn")
-        {
-            const char *modelPathEnv = std::getenv("RTOR_CNN_MODEL");
-            const std::string modelPath = (modelPathEnv && std::strlen(modelPathEnv) > 0)
-                                              ? std::string(modelPathEnv)
-                                              : std::string("./data/resnet18-v2-7.onnx");
-
-            Ort::SessionOptions options;
-            options.SetIntraOpNumThreads(1);
-            options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
-            session_ = std::make_unique<Ort::Session>(env_, modelPath.c_str(), options);
-
-            Ort::AllocatorWithDefaultOptions allocator;
-            auto in = session_->GetInputNameAllocated(0, allocator);
-            auto out = session_->GetOutputNameAllocated(0, allocator);
-            inputName_ = in.get();
-            outputName_ = out.get();
-        }
+        return runner()->infer(image, featureVector);
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "[CNN] inference failed: %s\n", e.what());
+        return -1;
+    }
+}
 
-        int infer(const cv::Mat &img, std::vector<float> *outVec) const
-        {
-            if (!outVec || img.empty())
-                return -1;
-
-            // 1) Ensure 3-channel BGR
-            cv::Mat bgr;
-            if (img.channels() == 1)
-                cv::cvtColor(img, bgr, cv::COLOR_GRAY2BGR);
-            else if (img.channels() == 3)
-                bgr = img;
-            else if (img.channels() == 4)
-                cv::cvtColor(img, bgr, cv::COLOR_BGRA2BGR);
-            else
-                return -1;
-
-            // 2) Resize to 224x224
-            cv::Mat resized;
-            cv::resize(bgr, resized, cv::Size(224, 224), 0, 0, cv::INTER_LINEAR);
-
-            // 3) BGR -> RGB
-            cv::Mat rgb;
-            cv::cvtColor(resized, rgb, cv::COLOR_BGR2RGB);
-
-            // 4) Convert to float in [0,1]
-            cv::Mat rgb32f;
-            rgb.convertTo(rgb32f, CV_32F, 1.0 / 255.0);
-
-            // 5) Normalize per channel and pack to NCHW
-            // ImageNet mean/std for ResNet18
-            const float mean[3] = {0.485f, 0.456f, 0.406f};
-            const float stdv[3] = {0.229f, 0.224f, 0.225f};
-
-            const int H = 224, W = 224;
-            std::vector<float> input(1 * 3 * H * W);
-
-            // rgb32f is HxWx3, float
-            for (int y = 0; y < H; ++y)
-            {
-                const cv::Vec3f *row = rgb32f.ptr<cv::Vec3f>(y);
-                for (int x = 0; x < W; ++x)
-                {
-                    const cv::Vec3f &px = row[x]; // (R,G,B) in [0,1]
-                    const float r = (px[0] - mean[0]) / stdv[0];
-                    const float g = (px[1] - mean[1]) / stdv[1];
-                    const float b = (px[2] - mean[2]) / stdv[2];
-
-                    // NCHW indexing: c*H*W + y*W + x
-                    input[0 * H * W + y * W + x] = r;
-                    input[1 * H * W + y * W + x] = g;
-                    input[2 * H * W + y * W + x] = b;
-                }
-            }
+/*
+CNNExtractor::extractBatch embeds several crops at once; the OpenCV DNN backend runs them as one batch.
+*/
+int CNNExtractor::extractBatch(
+    const std::vector<cv::Mat> &images,
+    std::vector<std::vector<float>> *featureVectors) const
+{
+    if (!featureVectors)
+    {
+        return -1;
+    }
+    try
+    {
+        return runner()->inferBatch(images, featureVectors);
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "[CNN] batch inference failed: %s\n", e.what());
+        return -1;
+    }
+}
 
-            // 6) Create tensor and run
-            const std::array<int64_t, 4> shape = {1, 3, 224, 224};
-            Ort::MemoryInfo memInfo = Ort::MemoryInfo::CreateCpu(
-                OrtAllocatorType::OrtArenaAllocator,
-                OrtMemType::OrtMemTypeDefault);
-
-            Ort::Value inputTensor = Ort::Value::CreateTensor<float>(
-                memInfo,
-                input.data(),
-                input.size(),
-                shape.data(),
-                shape.size());
-
-            const char *inputNames[] = {inputName_.c_str()};
-            const char *outputNames[] = {outputName_.c_str()};
-
-            auto outputs = session_->Run(
-                Ort::RunOptions{nullptr},
-                inputNames,
-                &inputTensor,
-                1,
-                outputNames,
-                1);
-
-            if (outputs.empty() || !outputs[0].IsTensor())
-                return -1;
-
-            float *tensorData = outputs[0].GetTensorMutableData<float>();
-            const size_t count = outputs[0].GetTensorTypeAndShapeInfo().GetElementCount();
-            outVec->assign(tensorData, tensorData + count);
-            return outVec->empty() ? -1 : 0;
-        }
+/*
+ColorHistExtractor::metadata records the histogram resolution, the crop size and the dimension.
+*/
+DbMetadata ColorHistExtractor::metadata() const
+{
+    DbMetadata meta = IExtractor::metadata();
+    meta["bins"] = std::to_string(params_.bins);
+    meta["input"] = std::to_string(params_.inputSize);
+    meta["dim"] = std::to_string(dim());
+    return meta;
+}
 
-    private:
-        Ort::Env env_;
-        std::unique_ptr<Ort::Session> session_;
-        std::string inputName_;
-        std::string outputName_;
-    };
+/*
+ColorHistExtractor::extractMat sizes the feature vector and computes the histogram into it (see extractInto).
+*/
+int ColorHistExtractor::extractMat(
+    const cv::Mat &image,
+    std::vector<float> *featureVector) const
+{
+    if (!featureVector || params_.bins <= 0)
+    {
+        return -1;
+    }
+    featureVector->resize(static_cast<size_t>(dim()));
+    return extractInto(image, featureVector->data());
+}
 
-    try
+/*
+ColorHistExtractor::extractInto counts the object pixels of the crop into a bins x bins rg-chromaticity
+histogram and normalizes it to sum 1, the form HistogramIntersection expects. Chromaticity ignores
+brightness, so the descriptor tolerates shading and exposure changes; near-black pixels count as gray.
+*/
+int ColorHistExtractor::extractInto(const cv::Mat &image, float *out) const
+{
+    if (!out || image.empty() || image.depth() != CV_8U || params_.bins <= 0)
     {
-        static OrtResNet18Runner runner;
-        return runner.infer(image, featureVector);
+        return -1;
     }
-    catch (const std::exception &e)
+    cv::Mat bgr;
+    if (image.channels() == 3)
+        bgr = image;
+    else if (image.channels() == 4)
+        cv::cvtColor(image, bgr, cv::COLOR_BGRA2BGR);
+    else
+        cv::cvtColor(image, bgr, cv::COLOR_GRAY2BGR);
+
+    // Objects are darker than the white background; Otsu splits the two inside the crop
+    cv::Mat gray, mask;
+    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+    cv::threshold(gray, mask, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+    const bool useMask = cv::countNonZero(mask) >= params_.minForeground * static_cast<float>(mask.total());
+
+    const int n = dim();
+    std::fill(out, out + n, 0.0f);
+    for (int y = 0; y < bgr.rows; ++y)
+    {
+        descriptorKernels::accumulateRgChroma(bgr.ptr<uchar>(y), useMask ? mask.ptr<uchar>(y) : nullptr,
+                                              bgr.cols, params_.bins, out);
+    }
+    float total = 0.0f;
+    for (int i = 0; i < n; ++i)
+        total += out[i];
+    if (total <= 0.0f)
+    {
+        return -1;
+    }
+    const float inv = 1.0f / total;
+    for (int i = 0; i < n; ++i)
+        out[i] *= inv;
+    return 0;
+}
+
+/*
+HOGExtractor::metadata records the crop size, cell size, bin count and dimension.
+*/
+DbMetadata HOGExtractor::metadata() const
+{
+    DbMetadata meta = IExtractor::metadata();
+    meta["input"] = std::to_string(params_.inputSize);
+    meta["cell"] = std::to_string(params_.cellSize);
+    meta["bins"] = std::to_string(params_.bins);
+    meta["dim"] = std::to_string(dim());
+    return meta;
+}
+
+/*
+HOGExtractor::dim returns the descriptor length, (cells - 1)^2 blocks of 4 * bins values.
+*/
+int HOGExtractor::dim() const
+{
+    const int blocks = std::max(0, cellsPerSide() - 1);
+    return blocks * blocks * 4 * params_.bins;
+}
+
+/*
+HOGExtractor::extractMat sizes the feature vector and computes the descriptor into it (see extractInto).
+*/
+int HOGExtractor::extractMat(
+    const cv::Mat &image,
+    std::vector<float> *featureVector) const
+{
+    if (!featureVector || dim() <= 0)
     {
-        std::fprintf(stderr, "[CNN] ONNX Runtime inference failed: %s\n", e.what());
         return -1;
     }
-#else
-    static bool warned = false;
-    if (!warned)
+    featureVector->resize(static_cast<size_t>(dim()));
+    return extractInto(image, featureVector->data());
+}
+
+/*
+HOGExtractor::extractInto computes the HOG descriptor of the crop: per-pixel gradients and orientation
+votes from the SIMD row kernel, accumulated into per-cell histograms, then every 2x2 block of cells is
+L2 normalized, clipped at 0.2 and renormalized (L2-Hys) and written to out.
+*/
+int HOGExtractor::extractInto(const cv::Mat &image, float *out) const
+{
+    const int cells = cellsPerSide();
+    const int side = cells * params_.cellSize;
+    const int bins = params_.bins;
+    if (!out || image.empty() || image.depth() != CV_8U || cells < 2 || bins <= 0)
+    {
+        return -1;
+    }
+    cv::Mat gray;
+    if (image.channels() == 3)
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    else if (image.channels() == 4)
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    else
+        gray = image;
+    if (gray.cols != side || gray.rows != side)
+        cv::resize(gray, gray, cv::Size(side, side), 0, 0, cv::INTER_AREA);
+
+    // One-pixel replicated border so every pixel has a central difference
+    cv::Mat padded, paddedF;
+    cv::copyMakeBorder(gray, padded, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+    padded.convertTo(paddedF, CV_32F);
+
+    std::vector<float> cellHist(static_cast<size_t>(cells * cells * bins), 0.0f);
+    std::vector<float> gx(side), gy(side), w0(side), w1(side);
+    std::vector<int> bin0(side);
+    for (int y = 0; y < side; ++y)
+    {
+        descriptorKernels::orientedGradientsRow(paddedF.ptr<float>(y), paddedF.ptr<float>(y + 1),
+                                                paddedF.ptr<float>(y + 2), side, bins, gx.data(), gy.data(),
+                                                bin0.data(), w0.data(), w1.data());
+        float *rowCells = cellHist.data() + static_cast<size_t>((y / params_.cellSize) * cells * bins);
+        for (int x = 0; x < side; ++x)
+        {
+            float *h = rowCells + (x / params_.cellSize) * bins;
+            const int b = ((bin0[x] % bins) + bins) % bins;
+            h[b] += w0[x];
+            h[(b + 1 == bins) ? 0 : b + 1] += w1[x];
+        }
+    }
+
+    // 2x2-cell blocks with L2-Hys normalization
+    const int blockLen = 4 * bins;
+    for (int by = 0; by < cells - 1; ++by)
     {
-        warned = true;
-        std::fprintf(
-            stderr,
-            "[CNN] ONNX Runtime is disabled. Build with ONNXRUNTIME_DIR=...; default model path is ./data/resnet18-v2-7.onnx (override with RTOR_CNN_MODEL).\n");
+        for (int bx = 0; bx < cells - 1; ++bx)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                const float *h = cellHist.data() + static_cast<size_t>(((by + c / 2) * cells + bx + c % 2) * bins);
+                std::copy(h, h + bins, out + c * bins);
+            }
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                float sq = 0.0f;
+                for (int k = 0; k < blockLen; ++k)
+                    sq += out[k] * out[k];
+                const float inv = 1.0f / std::sqrt(sq + 1e-6f);
+                for (int k = 0; k < blockLen; ++k)
+                    out[k] = (pass == 0) ? std::min(out[k] * inv, 0.2f) : out[k] * inv;
+            }
+            out += blockLen;
+        }
     }
-    (void)image;
-    featureVector->clear();
-    return -1;
-#endif
+    return 0;
 }
@@ -18,6 +18,8 @@ on the specified ExtractorType. It uses a switch statement to determine which ty
 extractor to create:
 - BASELINE, it creates and returns a shared pointer to a BaselineExtractor instance.
 - CNN, it creates and returns a shared pointer to a CNNExtractor instance.
+- COLOR_HIST, it creates and returns a shared pointer to a ColorHistExtractor instance.
+- HOG, it creates and returns a shared pointer to a HOGExtractor instance.
  - UNKNOWN_EXTRACTOR or any unrecognized type, it returns nullptr to indicate that no valid
     extractor could be created.
 */
@@ -29,6 +31,10 @@ std::shared_ptr<IExtractor> ExtractorFactory::create(ExtractorType type)
         return std::make_shared<BaselineExtractor>(type);
     case CNN:
         return std::make_shared<CNNExtractor>(type);
+    case COLOR_HIST:
+        return std::make_shared<ColorHistExtractor>(type);
+    case HOG:
+        return std::make_shared<HOGExtractor>(type);
     default:
         throw std::invalid_argument("Unknown ExtractorType");
     }
@@ -40,13 +46,17 @@ This static method converts a string representation of an extractor type to the
 ExtractorType enum value. It compares the input string to known extractor type strings:
 - "baseline" returns BASELINE
 - "cnn" returns CNN
+- "color_hist" returns COLOR_HIST
+- "hog" returns HOG
 If the input string does not match any known extractor type, it returns UNKNOWN_EXTRACTOR.
 */
 ExtractorType ExtractorFactory::stringToExtractorType(const char *typeStr)
 {
     static const std::unordered_map<std::string, ExtractorType> typeMap = {
         {"baseline", BASELINE},
-        {"cnn", CNN}};
+        {"cnn", CNN},
+        {"color_hist", COLOR_HIST},
+        {"hog", HOG}};
 
     auto it = typeMap.find(typeStr);
     return (it != typeMap.end()) ? it->second : UNKNOWN_EXTRACTOR;
@@ -59,13 +69,17 @@ display purposes. It uses a switch statement to return the corresponding string
 ExtractorType:
 - BASELINE returns "baseline"
 - CNN returns "cnn"
+- COLOR_HIST returns "color_hist"
+- HOG returns "hog"
 If the type is unrecognized, it returns "Unknown".
 */
 std::string ExtractorFactory::extractorTypeToString(ExtractorType type)
 {
     static const std::unordered_map<ExtractorType, std::string> reverseMap = {
         {BASELINE, "baseline"},
-        {CNN, "cnn"}};
+        {CNN, "cnn"},
+        {COLOR_HIST, "color_hist"},
+        {HOG, "hog"}};
 
     auto it = reverseMap.find(type);
     return (it != reverseMap.end()) ? it->second : "Unknown";
@@ -7,51 +7,1019 @@ Description: Matches features from a query image to a database of feature
 vectors.
 */
 
-#include "distanceMetrics.hpp"
+#include "csvUtil.hpp"
+#include "dbMetadata.hpp"
+#include "distanceKernels.hpp"
+#include "featureStats.hpp"
 #include "featureMatcher.hpp"
 #include "metricFactory.hpp"
 #include "readFiles.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <iostream>
 #include <vector>
 #include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
 #include <unordered_map>
+#include <opencv2/core.hpp>
 
 // namespace for internal helper functions and caching structures related to feature matching
 namespace
 {
     /*
     CachedFeatureDb stores the contents and metadata of a feature database CSV file to avoid
-    redundant disk reads and computations for matching
+    redundant disk reads and computations for matching. The feature vectors live in one contiguous,
+    row-major N x dim float matrix (cv::Mat storage is 64-byte aligned), with the label of each row
+    kept as an index into the distinct label names, so a scan is a straight strided walk over memory.
+    The per-dimension statistics behind the scaled Euclidean distance are kept with the entry, together
+    with a copy of the rows centered on the mean and scaled by invStd, so an SSD match is a plain L2 scan
+    (centering leaves the distances unchanged and keeps the norm expansion of the batched path accurate).
+    The whitening (whitenMean, invStd, dimOrder) is frozen when it is computed: an enrollment whitens only its
+    own row and folds it into the running statistics, and the rows are whitened again only once those drift
+    more than kWhitenDrift from the frozen ones (or on the next reload).
+    The whitened columns are ordered by how much of their variance lies between labels, so a partial SSD over
+    the first columns grows fastest for rows of other labels and early abandoning stops soonest. A database
+    searched with the pruned scan also keeps LAESA pivots: the whitened distance of every row to a few pivot rows.
+    One searched through HNSW holds the graph over its whitened rows; one searched through IVF holds k-means cells
+    of its raw rows, which the index standardizes with statistics it froze when built, so re-whitening after an
+    enrollment never moves a query into another coordinate system than the centroids. An enrollment adds the new
+    row to the same index, which older snapshots share and search only up to their own row count.
+    One searched through PQ keeps an M-byte code per row; without re-ranking it keeps nothing else per row
+    (compressed: data, whitened and their statistics are empty), so it only serves SSD matches.
+    Entries are immutable once published; a reload or an enrollment replaces the whole entry, so a
+    matcher holding a snapshot is never disturbed. An enrollment appends to the row matrices in place when
+    their buffer has room: the new row lies past every row an older snapshot sharing the buffer reads.
     */
     struct CachedFeatureDb
     {
-        std::vector<std::string> labels;
-        std::vector<std::vector<float>> data;
+        std::vector<std::string> labelNames; // distinct labels, indexed by labelIds
+        std::vector<int> labelIds;           // label of each row
+        cv::Mat data;                        // rows x dim, CV_32F, continuous
+        cv::Mat whitened;                    // column j holds dimension k = dimOrder[j] as (x - whitenMean[k]) * invStd[k]
+        int dim = 0;
+        FeatureStats stats; // Welford running statistics of each dimension over the rows
+        std::vector<float> whitenMean;       // statistics the whitened rows were computed with
+        std::vector<float> invStd;
+        std::vector<float> norms; // Euclidean norm of each row, for one-dot-product cosine distances
+        std::vector<float> whitenedSquaredNorms; // squared norm of each whitened row, for batched L2 distances
+        std::vector<int> dimOrder;               // dimension stored in each whitened column, most discriminative first
+        std::vector<size_t> pivotRows;           // LAESA pivots (empty unless the DB uses the pruned scan)
+        std::vector<float> pivotTable;           // rows x pivots: whitened distance of each row to each pivot
+        std::shared_ptr<HnswIndex> graph;        // HNSW graph over the whitened rows (HNSW_INDEX only)
+        std::shared_ptr<IvfIndex> cells;         // k-means cells of the raw rows (IVF_INDEX only)
+        std::shared_ptr<const PqCodec> pq;       // product quantizer of the raw rows (PQ_INDEX only)
+        std::vector<uint8_t> codes;              // rows x pq->codeSize() bytes
+        bool compressed = false;                 // only the codes are kept: no row vectors
         std::filesystem::file_time_type lastWriteTime{};
         std::uintmax_t fileSize = 0;
-        bool loaded = false;
+        bool rejected = false; // metadata does not match the registered extractor setup
+
+        size_t rows() const { return labelIds.size(); }
+        const float *row(size_t i) const { return data.ptr<float>(static_cast<int>(i)); }
+        const float *whitenedRow(size_t i) const { return whitened.ptr<float>(static_cast<int>(i)); }
+    };
+
+    /*
+    Orders the dimensions by their between-label variance (the variance of the per-label means, weighted by
+    label size, relative to the dimension's total variance), largest first. After whitening every dimension
+    has unit variance, so this is the share of a dimension's spread that separates labels.
+    */
+    void orderDimensions(CachedFeatureDb &entry)
+    {
+        const size_t dim = static_cast<size_t>(entry.dim);
+        const size_t labels = entry.labelNames.size();
+        std::vector<double> labelSums(labels * dim, 0.0);
+        std::vector<size_t> labelCounts(labels, 0);
+        for (size_t r = 0; r < entry.rows(); ++r)
+        {
+            const size_t l = static_cast<size_t>(entry.labelIds[r]);
+            const float *x = entry.row(r);
+            ++labelCounts[l];
+            for (size_t k = 0; k < dim; ++k)
+                labelSums[l * dim + k] += x[k];
+        }
+        const std::vector<double> &mean = entry.stats.mean();
+        std::vector<double> between(dim, 0.0);
+        for (size_t l = 0; l < labels; ++l)
+        {
+            if (labelCounts[l] == 0)
+                continue;
+            for (size_t k = 0; k < dim; ++k)
+            {
+                const double d = labelSums[l * dim + k] / static_cast<double>(labelCounts[l]) - mean[k];
+                between[k] += static_cast<double>(labelCounts[l]) * d * d;
+            }
+        }
+        for (size_t k = 0; k < dim; ++k)
+            between[k] *= static_cast<double>(entry.invStd[k]) * entry.invStd[k];
+        entry.dimOrder.resize(dim);
+        for (size_t k = 0; k < dim; ++k)
+            entry.dimOrder[k] = static_cast<int>(k);
+        std::stable_sort(entry.dimOrder.begin(), entry.dimOrder.end(),
+                         [&between](int a, int b)
+                         { return between[static_cast<size_t>(a)] > between[static_cast<size_t>(b)]; });
+    }
+
+    // Whitened distance of every row to pivot row p, written to column slot of the pivot table
+    void fillPivotColumn(CachedFeatureDb &entry, size_t slot)
+    {
+        const size_t pivots = entry.pivotRows.size();
+        const float *pivot = entry.whitenedRow(entry.pivotRows[slot]);
+        float *column = entry.pivotTable.data() + slot;
+        distanceKernels::scan(distanceKernels::ScaledSSD(), pivot, entry.whitenedRow(0), entry.rows(), entry.dim,
+                              [column, pivots](size_t i, float d)
+                              { column[i * pivots] = d; });
+    }
+
+    // Maps a query (or a row) into the whitened space (and column order) of the entry's rows
+    void whitenQuery(const CachedFeatureDb &entry, const float *query, float *out)
+    {
+        for (int j = 0; j < entry.dim; ++j)
+        {
+            const int k = entry.dimOrder[j];
+            out[j] = (query[k] - entry.whitenMean[k]) * entry.invStd[k];
+        }
+    }
+
+    /*
+    Freezes the whitening at the running statistics and rebuilds the whitened rows (in dimOrder), their squared
+    norms and the pivot distances. The rows go to a new buffer, as older snapshots may share the current one.
+    */
+    void whiten(CachedFeatureDb &entry)
+    {
+        const size_t n = entry.rows();
+        entry.stats.standardization(entry.whitenMean, entry.invStd);
+        orderDimensions(entry);
+        entry.whitened = cv::Mat(static_cast<int>(n), entry.dim, CV_32F);
+        for (size_t r = 0; r < n; ++r)
+            whitenQuery(entry, entry.row(r), entry.whitened.ptr<float>(static_cast<int>(r)));
+        entry.whitenedSquaredNorms.resize(n);
+        distanceKernels::rowSquaredNorms(entry.whitenedRow(0), n, entry.dim, entry.whitenedSquaredNorms.data());
+        entry.pivotTable.resize(n * entry.pivotRows.size());
+        for (size_t p = 0; p < entry.pivotRows.size(); ++p)
+            fillPivotColumn(entry, p);
+    }
+
+    /*
+    Picks count LAESA pivots by farthest-first traversal (each pivot is the row farthest from the pivots chosen
+    so far, the first the row farthest from the mean) and fills the pivot table. Spread-out pivots give the
+    tightest triangle-inequality bounds.
+    */
+    void choosePivots(CachedFeatureDb &entry, size_t count)
+    {
+        const size_t n = entry.rows();
+        count = std::min(count, n);
+        entry.pivotRows.clear();
+        entry.pivotTable.assign(n * count, 0.0f);
+        if (count == 0)
+            return;
+        // Until all pivots are chosen the table is filled with a stride of count, one column per chosen pivot
+        entry.pivotRows.reserve(count);
+        std::vector<float> nearestPivot(n, std::numeric_limits<float>::infinity());
+        size_t next = static_cast<size_t>(std::max_element(entry.whitenedSquaredNorms.begin(),
+                                                           entry.whitenedSquaredNorms.end()) -
+                                          entry.whitenedSquaredNorms.begin());
+        for (size_t p = 0; p < count; ++p)
+        {
+            entry.pivotRows.push_back(next);
+            const float *pivot = entry.whitenedRow(next);
+            float *column = entry.pivotTable.data() + p;
+            distanceKernels::scan(distanceKernels::ScaledSSD(), pivot, entry.whitenedRow(0), n, entry.dim,
+                                  [&](size_t i, float d)
+                                  {
+                                      column[i * count] = d;
+                                      nearestPivot[i] = std::min(nearestPivot[i], d);
+                                  });
+            next = static_cast<size_t>(std::max_element(nearestPivot.begin(), nearestPivot.end()) - nearestPivot.begin());
+        }
+    }
+
+    // Mean shift (in standard deviations) or relative std-dev change past which an enrollment re-whitens the rows
+    constexpr double kWhitenDrift = 0.05;
+
+    // Whether the running statistics moved more than kWhitenDrift away from the frozen whitening
+    bool whiteningDrifted(const CachedFeatureDb &entry)
+    {
+        const std::vector<double> &mean = entry.stats.mean();
+        for (int k = 0; k < entry.dim; ++k)
+        {
+            if (std::fabs(mean[k] - entry.whitenMean[k]) * entry.invStd[k] > kWhitenDrift ||
+                std::fabs(static_cast<double>(entry.stats.invStd(k)) / entry.invStd[k] - 1.0) > kWhitenDrift)
+                return true;
+        }
+        return false;
+    }
+
+    /*
+    Whitens the last row of entry with the frozen statistics and appends it to the whitened rows, with its
+    squared norm and its distances to the pivots.
+    */
+    void appendWhitened(CachedFeatureDb &entry)
+    {
+        const size_t n = entry.rows() - 1;
+        thread_local std::vector<float> whitenedRow;
+        whitenedRow.resize(entry.dim);
+        whitenQuery(entry, entry.row(n), whitenedRow.data());
+        entry.whitened.push_back(cv::Mat(1, entry.dim, CV_32F, whitenedRow.data()));
+        entry.whitenedSquaredNorms.push_back(0.0f);
+        distanceKernels::rowSquaredNorms(entry.whitenedRow(n), 1, entry.dim, &entry.whitenedSquaredNorms.back());
+        const distanceKernels::ScaledSSD metric;
+        for (size_t pivot : entry.pivotRows)
+            entry.pivotTable.push_back(metric.distance<0>(entry.whitenedRow(pivot), entry.whitenedRow(n), entry.dim));
+    }
+
+    /*
+    NearestRows collects the k nearest rows of one query from a stream of distances, in one pass: a bounded
+    max-heap holds the current k best (the database is never sorted) and labelMin the smallest distance seen
+    for every label. Non-finite distances are ignored; on ties the earlier row wins, whatever the order in
+    which the rows are added.
+    bound() is the distance above which a row can no longer change the results, which lets the pruned scan
+    skip rows without changing its answer.
+    */
+    class NearestRows
+    {
+    public:
+        void reset(size_t k, size_t labelCount)
+        {
+            k_ = std::max<size_t>(1, k);
+            heap_.clear();
+            labelMin_.assign(labelCount, std::numeric_limits<float>::infinity());
+            firstLabel_ = labelCount;
+            first_ = second_ = std::numeric_limits<float>::infinity();
+        }
+
+        void add(size_t row, int labelId, float distance)
+        {
+            if (!std::isfinite(distance))
+                return;
+            const size_t label = static_cast<size_t>(labelId);
+            float &labelBest = labelMin_[label];
+            if (distance < labelBest)
+            {
+                labelBest = distance;
+                // Keep the smallest label minimum and the smallest one of any other label
+                if (label == firstLabel_)
+                {
+                    first_ = distance;
+                }
+                else if (distance < first_)
+                {
+                    second_ = first_;
+                    first_ = distance;
+                    firstLabel_ = label;
+                }
+                else if (distance < second_)
+                {
+                    second_ = distance;
+                }
+            }
+            if (heap_.size() < k_)
+            {
+                heap_.emplace_back(distance, row);
+                std::push_heap(heap_.begin(), heap_.end());
+            }
+            else if (std::make_pair(distance, row) < heap_.front())
+            {
+                std::pop_heap(heap_.begin(), heap_.end());
+                heap_.back() = {distance, row};
+                std::push_heap(heap_.begin(), heap_.end());
+            }
+        }
+
+        /*
+        A row farther than this can neither enter the k nearest nor lower the two smallest label minima
+        (which give the second distances), so skipping it leaves the results unchanged.
+        */
+        float bound() const
+        {
+            const float kth = (heap_.size() < k_) ? std::numeric_limits<float>::infinity() : heap_.front().first;
+            return std::max(kth, second_);
+        }
+
+        /*
+        Writes the collected rows to out, nearest first. The secondDistance of each result is the smallest
+        distance of any row whose label differs from that result's label, and secondLabel is that row's label.
+        Returns false if nothing was collected.
+        */
+        bool results(const CachedFeatureDb &db, std::vector<MatchResult> &out) const
+        {
+            out.clear();
+            if (heap_.empty())
+                return false;
+            // The two labels with the smallest distances give every result its other-label distance
+            size_t firstLabel = 0, secondLabel = 0;
+            float first = std::numeric_limits<float>::infinity(), second = first;
+            for (size_t l = 0; l < labelMin_.size(); ++l)
+            {
+                if (labelMin_[l] < first)
+                {
+                    second = first;
+                    secondLabel = firstLabel;
+                    first = labelMin_[l];
+                    firstLabel = l;
+                }
+                else if (labelMin_[l] < second)
+                {
+                    second = labelMin_[l];
+                    secondLabel = l;
+                }
+            }
+            std::vector<std::pair<float, size_t>> sorted(heap_);
+            std::sort(sorted.begin(), sorted.end());
+            for (const auto &entry : sorted)
+            {
+                const size_t labelId = static_cast<size_t>(db.labelIds[entry.second]);
+                MatchResult result;
+                result.label = db.labelNames[labelId];
+                result.filename = result.label;
+                result.distance = entry.first;
+                const bool isFirst = (labelId == firstLabel);
+                result.secondDistance = isFirst ? second : first;
+                if (std::isfinite(result.secondDistance))
+                    result.secondLabel = db.labelNames[isFirst ? secondLabel : firstLabel];
+                out.push_back(std::move(result));
+            }
+            return true;
+        }
+
+    private:
+        size_t k_ = 1;
+        std::vector<std::pair<float, size_t>> heap_; // (distance, row), largest distance on top
+        std::vector<float> labelMin_;
+        size_t firstLabel_ = 0;
+        float first_ = 0.0f, second_ = 0.0f; // smallest label minimum, and smallest of any other label
     };
 
-    // Global cache mapping database file paths to their cached contents and metadata
-    std::unordered_map<std::string, CachedFeatureDb> gDbCache;
+    /*
+    Index of label in the entry's distinct label names, appending it if it is new.
+    */
+    int labelIdFor(CachedFeatureDb &entry, const std::string &label)
+    {
+        auto it = std::find(entry.labelNames.begin(), entry.labelNames.end(), label);
+        if (it != entry.labelNames.end())
+            return static_cast<int>(it - entry.labelNames.begin());
+        entry.labelNames.push_back(label);
+        return static_cast<int>(entry.labelNames.size()) - 1;
+    }
+
+    /*
+    Records the current modification time and size of the database file in entry, so the cache
+    recognizes its own appends and does not reload them from disk.
+    */
+    void stampFile(const std::string &dbPath, CachedFeatureDb &entry)
+    {
+        std::error_code ec;
+        const auto writeTime = std::filesystem::last_write_time(dbPath, ec);
+        if (!ec)
+            entry.lastWriteTime = writeTime;
+        const auto size = std::filesystem::file_size(dbPath, ec);
+        if (!ec)
+            entry.fileSize = size;
+    }
+
+    /*
+    Packs the rows read from a database CSV into the contiguous matrix of entry. The dimension is taken
+    from the registered metadata when it records one, otherwise it is the most common row length; rows of
+    any other length are dropped here, once, instead of being skipped on every match.
+    Returns false if no row is left.
+    */
+    bool packRows(const std::string &dbPath, const std::vector<std::string> &labels,
+                  const std::vector<std::vector<float>> &rows, const DbMetadata *required, CachedFeatureDb &entry)
+    {
+        int dim = 0;
+        if (required)
+        {
+            auto dimIt = required->find("dim");
+            if (dimIt != required->end())
+                dim = std::atoi(dimIt->second.c_str());
+        }
+        if (dim <= 0)
+        {
+            std::map<size_t, size_t> lengthCounts;
+            for (const auto &row : rows)
+                ++lengthCounts[row.size()];
+            size_t bestCount = 0;
+            for (const auto &lc : lengthCounts)
+            {
+                if (lc.first > 0 && lc.second > bestCount)
+                {
+                    dim = static_cast<int>(lc.first);
+                    bestCount = lc.second;
+                }
+            }
+        }
+        size_t kept = 0;
+        for (const auto &row : rows)
+        {
+            if (static_cast<int>(row.size()) == dim)
+                ++kept;
+        }
+        if (dim <= 0 || kept == 0)
+        {
+            std::cout << "[MATCH] no compatible DB rows (dimension mismatch): " << dbPath << "\n";
+            return false;
+        }
+        if (kept < rows.size())
+        {
+            std::cout << "[MATCH] " << dbPath << ": dropped " << (rows.size() - kept)
+                      << " row(s) whose dimension is not " << dim << "\n";
+        }
+
+        entry.dim = dim;
+        entry.data.create(static_cast<int>(kept), dim, CV_32F);
+        entry.labelIds.reserve(kept);
+        entry.stats.reset(dim);
+        std::unordered_map<std::string, int> labelIndex;
+        size_t r = 0;
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            if (static_cast<int>(rows[i].size()) != dim)
+                continue;
+            std::copy(rows[i].begin(), rows[i].end(), entry.data.ptr<float>(static_cast<int>(r++)));
+            entry.stats.add(rows[i].data());
+            auto inserted = labelIndex.emplace(labels[i], static_cast<int>(entry.labelNames.size()));
+            if (inserted.second)
+                entry.labelNames.push_back(labels[i]);
+            entry.labelIds.push_back(inserted.first->second);
+        }
+        whiten(entry);
+        entry.norms.resize(kept);
+        distanceKernels::rowNorms(entry.row(0), kept, dim, entry.norms.data());
+        return true;
+    }
+
+    // Global cache mapping database file paths to their cached contents and metadata.
+    // Guarded by gDbMutex: matching runs on the UI thread and on the CNN worker thread.
+    std::mutex gDbMutex;
+    std::unordered_map<std::string, std::shared_ptr<const CachedFeatureDb>> gDbCache;
+
+    // One mutex per database path, held while that database is read and its search structure built, so two
+    // threads never load the same file twice. gDbMutex is not held meanwhile: other databases stay usable.
+    std::unordered_map<std::string, std::shared_ptr<std::mutex>> gLoadMutex;
+
+    // Bumped by requireMetadata and setSearchIndex; a load that started under older settings is not cached
+    uint64_t gConfigGeneration = 0;
+
+    // Extractor setup each database must have been built with (see FeatureMatcher::requireMetadata)
+    std::unordered_map<std::string, DbMetadata> gRequiredMeta;
+
+    // Per-query "[MATCH] best ..." lines (see FeatureMatcher::setMatchLogging)
+    std::atomic<bool> gLogMatches{true};
+
+    // Search structure of each database (see FeatureMatcher::setSearchIndex) and the work its searches did
+    struct SearchChoice
+    {
+        SearchIndex index = LINEAR_SCAN;
+        SearchIndexParams params;
+    };
+    std::unordered_map<std::string, SearchChoice> gSearchIndex;
+    std::unordered_map<std::string, SearchStats> gSearchStats;
+
+    // LAESA pivots kept for a database searched with the pruned scan
+    constexpr size_t kPivotCount = 8;
+    // Rows with the smallest pivot bounds measured first by the pruned scan, to tighten its bound early
+    constexpr size_t kSeedRows = 16;
+    // Relative slack on the pruning bounds, so float rounding can never skip a row the linear scan would keep
+    constexpr float kPruneSlack = 1e-4f;
+
+    /*
+    Fingerprint of the first count raw rows (FNV-1a over their 32-bit words): a persisted index is reused only
+    for the rows it was built from, however the file was edited in between.
+    */
+    uint64_t rowFingerprint(const CachedFeatureDb &entry, size_t count)
+    {
+        uint64_t hash = 1469598103934665603ull;
+        hash = (hash ^ static_cast<uint64_t>(entry.dim)) * 1099511628211ull;
+        if (count == 0)
+            return hash;
+        const uint32_t *words = reinterpret_cast<const uint32_t *>(entry.row(0));
+        const size_t n = count * static_cast<size_t>(entry.dim);
+        for (size_t i = 0; i < n; ++i)
+            hash = (hash ^ words[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    // An IVF index or a PQ codec is retrained once the database holds this many times the rows it was trained on
+    constexpr size_t kRetrainGrowth = 4;
+
+    /*
+    Whether a loaded index should be rebuilt rather than extended to rows rows. An HNSW graph grows gracefully;
+    IVF cells keep the count of their first build (about sqrt of its rows), so on a database that grew far
+    beyond it every probe would visit an ever larger share of the rows.
+    */
+    bool outgrown(const HnswIndex &, size_t) { return false; }
+    bool outgrown(const IvfIndex &index, size_t rows) { return rows > kRetrainGrowth * index.trainedRows(); }
+
+    /*
+    Returns the index (HnswIndex or IvfIndex) over rows (entry's whitened or raw rows, as the index expects),
+    persisted next to the CSV with the given extension (features_cnn.csv -> features_cnn.hnsw). An index file
+    that covers a prefix of the rows (same fingerprint) is loaded and the rows appended since (e.g. enrolled by
+    another run) are inserted, unless the database has outgrown it; otherwise the index is built from scratch.
+    An index that changed is written back when the database is a file on disk.
+    */
+    template <class Index>
+    std::shared_ptr<Index> loadIndexFile(const std::string &dbPath, const char *extension, const char *name,
+                                         const CachedFeatureDb &entry, const float *rows,
+                                         const typename Index::Params &params)
+    {
+        auto index = std::make_shared<Index>(params);
+        const std::string indexPath = std::filesystem::path(dbPath).replace_extension(extension).string();
+        std::error_code ec;
+        const bool onDisk = std::filesystem::exists(dbPath, ec);
+        uint64_t fingerprint = 0;
+        size_t reused = 0;
+        if (onDisk && index->load(indexPath, entry.dim, fingerprint) && index->size() <= entry.rows() &&
+            fingerprint == rowFingerprint(entry, index->size()) && !outgrown(*index, entry.rows()))
+        {
+            reused = index->size();
+            index->insert(rows, entry.rows(), entry.dim);
+        }
+        else
+        {
+            index->build(rows, entry.rows(), entry.dim);
+        }
+        if (onDisk && reused != entry.rows())
+        {
+            if (index->save(indexPath, rowFingerprint(entry, entry.rows())))
+                std::cout << "[MATCH] " << name << " index of " << entry.rows() << " rows (" << reused
+                          << " reused) saved to " << indexPath << "\n";
+            else
+                std::cout << "[MATCH] could not write " << indexPath << "\n";
+        }
+        return index;
+    }
+
+    constexpr char kPqMagic[8] = {'R', 'T', 'O', 'R', '_', 'P', 'Q', 'C'};
+    constexpr uint32_t kPqFormatVersion = 2;
+
+    template <class T>
+    void writeRaw(std::ofstream &out, const T *data, size_t count)
+    {
+        out.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(count * sizeof(T)));
+    }
+
+    template <class T>
+    bool readRaw(std::ifstream &in, T *data, size_t count)
+    {
+        in.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(count * sizeof(T)));
+        return static_cast<bool>(in);
+    }
+
+    /*
+    PqFile is the content of a <db>.pq file: the codec, the codes and labels of the rows it covers, the
+    fingerprint of those rows and the size and modification time of the CSV they were read from.
+    */
+    struct PqFile
+    {
+        std::shared_ptr<PqCodec> codec;
+        std::vector<uint8_t> codes;
+        std::vector<std::string> labelNames;
+        std::vector<int> labelIds;
+        uint64_t fingerprint = 0;
+        uint64_t csvSize = 0;
+        int64_t csvTime = 0;
+
+        size_t rows() const { return labelIds.size(); }
+    };
+
+    int64_t fileTimeTicks(const std::filesystem::file_time_type &time)
+    {
+        return static_cast<int64_t>(time.time_since_epoch().count());
+    }
+
+    std::string pqPathFor(const std::string &dbPath)
+    {
+        return std::filesystem::path(dbPath).replace_extension(".pq").string();
+    }
+
+    /*
+    Writes the codes of entry to path (through a temporary file renamed into place): a header (magic, format
+    version, dim, row count, fingerprint, CSV size and time), the codec, the codes, then the label names and the
+    label of each row. Returns false on a write error.
+    */
+    bool savePqFile(const std::string &path, const CachedFeatureDb &entry, uint64_t fingerprint)
+    {
+        const std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            const uint32_t dim = static_cast<uint32_t>(entry.dim);
+            const uint64_t rows = entry.rows();
+            const uint64_t csvSize = entry.fileSize;
+            const int64_t csvTime = fileTimeTicks(entry.lastWriteTime);
+            const uint32_t labels = static_cast<uint32_t>(entry.labelNames.size());
+            writeRaw(out, kPqMagic, sizeof(kPqMagic));
+            writeRaw(out, &kPqFormatVersion, 1);
+            writeRaw(out, &dim, 1);
+            writeRaw(out, &rows, 1);
+            writeRaw(out, &fingerprint, 1);
+            writeRaw(out, &csvSize, 1);
+            writeRaw(out, &csvTime, 1);
+            if (!entry.pq->write(out))
+                return false;
+            writeRaw(out, entry.codes.data(), entry.codes.size());
+            writeRaw(out, &labels, 1);
+            for (const auto &name : entry.labelNames)
+            {
+                const uint32_t length = static_cast<uint32_t>(name.size());
+                writeRaw(out, &length, 1);
+                writeRaw(out, name.data(), name.size());
+            }
+            writeRaw(out, entry.labelIds.data(), entry.labelIds.size());
+            if (!out.good())
+                return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, path, ec);
+        return !ec;
+    }
+
+    /*
+    Reads a file written by savePqFile into file, its codec taking params. The file is rejected (returning
+    false) if it is unreadable, of another format, or a label is out of range.
+    */
+    bool loadPqFile(const std::string &path, const PqCodec::Params &params, PqFile &file)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        char magic[sizeof(kPqMagic)];
+        uint32_t version = 0, dim = 0, labels = 0;
+        uint64_t rows = 0;
+        if (!readRaw(in, magic, sizeof(magic)) || std::memcmp(magic, kPqMagic, sizeof(kPqMagic)) != 0 ||
+            !readRaw(in, &version, 1) || version != kPqFormatVersion || !readRaw(in, &dim, 1) ||
+            !readRaw(in, &rows, 1) || !readRaw(in, &file.fingerprint, 1) || !readRaw(in, &file.csvSize, 1) ||
+            !readRaw(in, &file.csvTime, 1) || rows > UINT32_MAX)
+            return false;
+        file.codec = std::make_shared<PqCodec>(params);
+        if (!file.codec->read(in, static_cast<int>(dim)))
+            return false;
+        file.codes.resize(rows * file.codec->codeSize());
+        if (!readRaw(in, file.codes.data(), file.codes.size()) || !readRaw(in, &labels, 1) || labels > rows)
+            return false;
+        file.labelNames.resize(labels);
+        for (auto &name : file.labelNames)
+        {
+            uint32_t length = 0;
+            if (!readRaw(in, &length, 1) || length > 4096)
+                return false;
+            name.resize(length);
+            if (!readRaw(in, &name[0], length))
+                return false;
+        }
+        file.labelIds.resize(rows);
+        if (!readRaw(in, file.labelIds.data(), file.labelIds.size()))
+            return false;
+        for (int id : file.labelIds)
+        {
+            if (id < 0 || static_cast<uint32_t>(id) >= labels)
+                return false;
+        }
+        return true;
+    }
+
+    /*
+    Whether a codec should be retrained on rows rows: it has fewer than 256 centroids per subspace (it was
+    trained on a tiny database) and more rows now exist, or the database has grown well past its training rows.
+    */
+    bool outgrown(const PqCodec &codec, size_t rows)
+    {
+        if (codec.centroids() < PqCodec::kCentroids && rows > codec.trainedRows())
+            return true;
+        return rows > kRetrainGrowth * codec.trainedRows();
+    }
+
+    /*
+    Gives entry the PQ codes of its rows, persisted with the labels as <db>.pq next to the CSV. A file with the
+    requested code size whose codes cover a prefix of the rows (same fingerprint) is reused and the rows
+    appended since are encoded, unless the database has outgrown its codec; otherwise the codec is trained on
+    the rows. The file is written back when the
+    database is a file on disk and the codes or the CSV changed. Without re-ranking, the row vectors are then
+    dropped and only the codes stay in memory.
+    */
+    void loadCodes(const std::string &dbPath, CachedFeatureDb &entry, const PqCodec::Params &params)
+    {
+        const std::string pqPath = pqPathFor(dbPath);
+        std::error_code ec;
+        const bool onDisk = std::filesystem::exists(dbPath, ec);
+        auto codec = std::make_shared<PqCodec>(params);
+        PqFile file;
+        size_t reused = 0;
+        bool current = false;
+        if (onDisk && loadPqFile(pqPath, params, file) && file.codec->dim() == entry.dim &&
+            file.codec->codeSize() == codec->subspacesFor(entry.dim) && file.rows() <= entry.rows() &&
+            file.fingerprint == rowFingerprint(entry, file.rows()) && !outgrown(*file.codec, entry.rows()))
+        {
+            codec = file.codec;
+            reused = file.rows();
+            entry.codes.swap(file.codes);
+            current = (file.csvSize == entry.fileSize && file.csvTime == fileTimeTicks(entry.lastWriteTime));
+        }
+        else
+        {
+            codec->train(entry.row(0), entry.rows(), entry.dim);
+        }
+        const size_t codeSize = codec->codeSize();
+        entry.codes.resize(entry.rows() * codeSize);
+        if (reused < entry.rows())
+            codec->encode(entry.row(reused), entry.rows() - reused, entry.codes.data() + reused * codeSize);
+        entry.pq = codec;
+        if (onDisk && (reused != entry.rows() || !current))
+        {
+            if (savePqFile(pqPath, entry, rowFingerprint(entry, entry.rows())))
+                std::cout << "[MATCH] PQ codes of " << entry.rows() << " rows (" << codeSize << " bytes each, " << reused
+                          << " reused) saved to " << pqPath << "\n";
+            else
+                std::cout << "[MATCH] could not write " << pqPath << "\n";
+        }
+        if (params.rerank == 0)
+        {
+            entry.compressed = true;
+            entry.data.release();
+            entry.whitened.release();
+            std::vector<float>().swap(entry.norms);
+            std::vector<float>().swap(entry.whitenedSquaredNorms);
+        }
+    }
+
+    /*
+    Fills entry from <db>.pq alone, for a compressed database (PQ_INDEX without re-ranking), when the file was
+    written for the CSV as it is now (same size and modification time) and has the requested code size: the CSV
+    is not parsed and its rows are never held in memory. Returns false otherwise.
+    */
+    bool loadCompressed(const std::string &dbPath, const DbMetadata *required, const PqCodec::Params &params,
+                        CachedFeatureDb &entry)
+    {
+        const std::string pqPath = pqPathFor(dbPath);
+        PqFile file;
+        if (!loadPqFile(pqPath, params, file) || file.rows() == 0 || file.csvSize != entry.fileSize ||
+            file.csvTime != fileTimeTicks(entry.lastWriteTime))
+            return false;
+        const int dim = file.codec->dim();
+        if (required)
+        {
+            auto dimIt = required->find("dim");
+            if (dimIt != required->end() && std::atoi(dimIt->second.c_str()) != dim)
+                return false;
+        }
+        if (file.codec->codeSize() != file.codec->subspacesFor(dim))
+            return false;
+        entry.dim = dim;
+        entry.labelNames.swap(file.labelNames);
+        entry.labelIds.swap(file.labelIds);
+        entry.codes.swap(file.codes);
+        entry.pq = file.codec;
+        entry.compressed = true;
+        std::cout << "[MATCH] " << entry.rows() << " compressed rows of " << dbPath << " loaded from " << pqPath << "\n";
+        return true;
+    }
+
+    /*
+    Builds the search structures choice asks for into entry, which is not published yet, so gDbMutex is not held.
+    */
+    void buildSearchIndex(const std::string &dbPath, const SearchChoice &choice, CachedFeatureDb &entry)
+    {
+        switch (choice.index)
+        {
+        case PRUNED_SCAN:
+            choosePivots(entry, kPivotCount);
+            break;
+        case HNSW_INDEX:
+            entry.graph = loadIndexFile<HnswIndex>(dbPath, ".hnsw", "HNSW", entry, entry.whitenedRow(0), choice.params.hnsw);
+            break;
+        case IVF_INDEX:
+            entry.cells = loadIndexFile<IvfIndex>(dbPath, ".ivf", "IVF", entry, entry.row(0), choice.params.ivf);
+            break;
+        case PQ_INDEX:
+            loadCodes(dbPath, entry, choice.params.pq);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /*
+    graphSearch feeds nearest with the rows the HNSW graph returns for a query already whitened into the
+    database's column order: the efSearch (at least k) nearest nodes of its layer-0 search, each with its
+    distance from the linear scan's kernel. The result is approximate, and so are the second distances, which
+    come from the same candidates. stats receives the number of rows never measured.
+    */
+    void graphSearch(const CachedFeatureDb &db, const float *query, size_t k, NearestRows &nearest, SearchStats &stats)
+    {
+        const distanceKernels::ScaledSSD metric;
+        thread_local std::vector<std::pair<float, uint32_t>> candidates;
+        const size_t ef = std::max(db.graph->params().efSearch, k);
+        const size_t measured = db.graph->search(db.whitenedRow(0), db.rows(), db.dim, query, ef, candidates);
+        stats.notVisited += db.rows() - std::min(measured, db.rows());
+        for (const auto &c : candidates)
+            nearest.add(c.second, db.labelIds[c.second], metric.distance<0>(query, db.whitenedRow(c.second), db.dim));
+    }
+
+    /*
+    cellSearch feeds nearest with the rows of the nprobe IVF cells nearest to the raw query, each with its
+    distance from the linear scan's kernel to the same query already whitened into the database's column order.
+    Rows in other cells are never measured (counted in stats), so the result is approximate.
+    */
+    void cellSearch(const CachedFeatureDb &db, const float *query, const float *whitenedQuery, NearestRows &nearest,
+                    SearchStats &stats)
+    {
+        const distanceKernels::ScaledSSD metric;
+        thread_local std::vector<uint32_t> candidates;
+        db.cells->probe(query, db.rows(), db.cells->params().nprobe, candidates);
+        stats.notVisited += db.rows() - candidates.size();
+        for (uint32_t i : candidates)
+            nearest.add(i, db.labelIds[i], metric.distance<0>(whitenedQuery, db.whitenedRow(i), db.dim));
+    }
+
+    /*
+    pqSearch feeds nearest for a raw (not whitened) query from the PQ codes: one lookup table per query, then one
+    ADC pass over all codes. Without re-ranking each row gets the square root of its approximate distance. With
+    rerank > 0, the rerank (at least k) rows of smallest approximate distance (found with nth_element, no sort)
+    are measured with the linear scan's kernel instead, and the other rows count as not visited in stats.
+    */
+    void pqSearch(const CachedFeatureDb &db, const float *query, size_t k, NearestRows &nearest, SearchStats &stats)
+    {
+        const size_t n = db.rows();
+        thread_local std::vector<float> table, approx;
+        table.resize(db.pq->codeSize() * PqCodec::kCentroids);
+        approx.resize(n);
+        db.pq->lookupTable(query, table.data());
+        db.pq->adc(table.data(), db.codes.data(), n, approx.data());
+        const size_t rerank = db.compressed ? 0 : std::min(n, std::max(db.pq->params().rerank, k));
+        if (rerank == 0)
+        {
+            for (size_t i = 0; i < n; ++i)
+                nearest.add(i, db.labelIds[i], std::sqrt(std::max(0.0f, approx[i])));
+            return;
+        }
+
+        const distanceKernels::ScaledSSD metric;
+        thread_local std::vector<uint32_t> order;
+        thread_local std::vector<float> whitenedQuery;
+        order.resize(n);
+        std::iota(order.begin(), order.end(), 0u);
+        std::nth_element(order.begin(), order.begin() + (rerank - 1), order.end(), [](uint32_t a, uint32_t b)
+                         { return std::make_pair(approx[a], a) < std::make_pair(approx[b], b); });
+        whitenedQuery.resize(db.dim);
+        whitenQuery(db, query, whitenedQuery.data());
+        for (size_t s = 0; s < rerank; ++s)
+        {
+            const uint32_t i = order[s];
+            nearest.add(i, db.labelIds[i], metric.distance<0>(whitenedQuery.data(), db.whitenedRow(i), db.dim));
+        }
+        stats.notVisited += n - rerank;
+    }
+
+    /*
+    prunedScan feeds nearest with the SSD distances of the rows that can still change the result, for a query
+    already whitened into the database's column order:
+    - LAESA: given the query's distance to each pivot p, |d(q,p) - d(x,p)| is a lower bound of d(q,x) (triangle
+      inequality), so rows whose bound exceeds nearest.bound() are skipped without reading their features. The
+      kSeedRows rows with the smallest bounds (found with nth_element, no sort) are measured first.
+    - Early abandoning: the other rows go through boundedSSD, which stops once the partial sum passes the bound.
+    Rows that survive get their distance from the same kernel as the linear scan, so the results are identical
+    to it. stats receives the number of rows skipped each way.
+    */
+    void prunedScan(const CachedFeatureDb &db, const float *query, NearestRows &nearest, SearchStats &stats)
+    {
+        const size_t n = db.rows();
+        const size_t pivots = db.pivotRows.size();
+        const distanceKernels::ScaledSSD metric;
+        thread_local std::vector<float> queryToPivot;
+        queryToPivot.resize(pivots);
+        float pivotSlack = 0.0f; // rounding of the pivot distances is relative to their size
+        for (size_t p = 0; p < pivots; ++p)
+        {
+            queryToPivot[p] = metric.distance<0>(query, db.whitenedRow(db.pivotRows[p]), db.dim);
+            pivotSlack = std::max(pivotSlack, kPruneSlack * queryToPivot[p]);
+        }
+        thread_local std::vector<float> lower;
+        lower.resize(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const float *toPivot = db.pivotTable.data() + i * pivots;
+            float bound = 0.0f;
+            for (size_t p = 0; p < pivots; ++p)
+                bound = std::max(bound, std::fabs(queryToPivot[p] - toPivot[p]));
+            lower[i] = bound;
+        }
+
+        auto measure = [&](size_t i)
+        {
+            const float bound = nearest.bound();
+            if (lower[i] > bound * (1.0f + kPruneSlack) + pivotSlack)
+            {
+                ++stats.pivotPruned;
+                return;
+            }
+            const float *row = db.whitenedRow(i);
+            const float limit = bound * bound * (1.0f + 2.0f * kPruneSlack);
+            if (std::isfinite(limit) && distanceKernels::boundedSSD(query, row, db.dim, limit) > limit)
+            {
+                ++stats.abandoned;
+                return;
+            }
+            nearest.add(i, db.labelIds[i], metric.distance<0>(query, row, db.dim));
+        };
+
+        thread_local std::vector<size_t> seeds;
+        seeds.resize(n);
+        for (size_t i = 0; i < n; ++i)
+            seeds[i] = i;
+        const size_t seedCount = std::min(kSeedRows, n);
+        std::nth_element(seeds.begin(), seeds.begin() + (seedCount - 1), seeds.end(),
+                         [](size_t a, size_t b)
+                         { return std::make_pair(lower[a], a) < std::make_pair(lower[b], b); });
+        for (size_t s = 0; s < seedCount; ++s)
+            measure(seeds[s]);
+        for (size_t s = 0; s < seedCount; ++s)
+            lower[seeds[s]] = -1.0f; // measured
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (lower[i] >= 0.0f)
+                measure(i);
+        }
+    }
+
+    // The settings a database is loaded with, copied under gDbMutex
+    struct LoadConfig
+    {
+        bool hasRequired = false;
+        DbMetadata required;
+        SearchChoice choice;
+        uint64_t generation = 0;
+    };
+
+    // Copies the registered metadata and search index of dbPath. Called with gDbMutex held.
+    LoadConfig loadConfigFor(const std::string &dbPath)
+    {
+        LoadConfig config;
+        auto req = gRequiredMeta.find(dbPath);
+        if (req != gRequiredMeta.end())
+        {
+            config.hasRequired = true;
+            config.required = req->second;
+        }
+        auto choice = gSearchIndex.find(dbPath);
+        if (choice != gSearchIndex.end())
+            config.choice = choice->second;
+        config.generation = gConfigGeneration;
+        return config;
+    }
+
+    /*
+    Publishes entry as the cached contents of dbPath unless the settings changed while it was built, in which
+    case the next match loads the database again. Called with gDbMutex held.
+    */
+    void publish(const std::string &dbPath, const LoadConfig &config, std::shared_ptr<const CachedFeatureDb> entry)
+    {
+        if (config.generation == gConfigGeneration)
+            gDbCache[dbPath] = std::move(entry);
+    }
+
+    /*
+    Looks up the cached entry of dbPath and reports whether it is still current: cached and, when the file can
+    be stat'ed, of the same modification time and size. Called with gDbMutex held.
+    */
+    bool cachedCurrent(const std::string &dbPath, const std::error_code &timeEc, const std::error_code &sizeEc,
+                       const std::filesystem::file_time_type &writeTime, std::uintmax_t fileSize,
+                       std::shared_ptr<const CachedFeatureDb> &out)
+    {
+        auto it = gDbCache.find(dbPath);
+        if (it == gDbCache.end())
+            return false;
+        if (!timeEc && !sizeEc && (it->second->lastWriteTime != writeTime || it->second->fileSize != fileSize))
+            return false;
+        out = it->second;
+        return true;
+    }
 
     /*
     Loads a cached feature database from the given path. If the database is not already cached
     or has been modified since the last load, it reads the database from disk and updates the cache.
+    The file is read and its search structure built under the database's own load mutex, outside gDbMutex, so
+    a slow build (e.g. an HNSW graph over 100k rows) never blocks matching against other databases.
+    Returns a snapshot that stays valid while the caller holds it.
     */
-    const CachedFeatureDb *loadCachedDb(const std::string &dbPath)
+    std::shared_ptr<const CachedFeatureDb> loadCachedDb(const std::string &dbPath)
     {
         if (dbPath.empty())
         {
             return nullptr;
         }
-        auto it = gDbCache.find(dbPath);
-        bool needsReload = (it == gDbCache.end()) || (!it->second.loaded);
 
         // time settings for cache validation
         std::error_code timeEc;
@@ -59,42 +1027,210 @@ namespace
         const auto nowWriteTime = std::filesystem::last_write_time(dbPath, timeEc);
         const auto nowFileSize = std::filesystem::file_size(dbPath, sizeEc);
 
-        if (!needsReload && !timeEc && !sizeEc)
+        std::shared_ptr<const CachedFeatureDb> cached;
+        std::shared_ptr<std::mutex> loadMutex;
         {
-            if (it->second.lastWriteTime != nowWriteTime || it->second.fileSize != nowFileSize)
-            {
-                needsReload = true;
-            }
+            std::lock_guard<std::mutex> lock(gDbMutex);
+            if (cachedCurrent(dbPath, timeEc, sizeEc, nowWriteTime, nowFileSize, cached))
+                return cached->rejected ? nullptr : cached;
+            auto &slot = gLoadMutex[dbPath];
+            if (!slot)
+                slot = std::make_shared<std::mutex>();
+            loadMutex = slot;
         }
+
         // If we need to reload (either not cached or file has changed), read the database from disk and update the cache
-        if (needsReload)
+        std::lock_guard<std::mutex> loadLock(*loadMutex);
+        LoadConfig config;
         {
-            std::vector<std::string> dbLabels;
-            std::vector<std::vector<float>> dbData;
-            if (ReadFiles::readFeaturesFromCSV(dbPath.c_str(), dbLabels, dbData) != 0 || dbData.empty())
+            // Another thread may have loaded it while this one waited
+            std::lock_guard<std::mutex> lock(gDbMutex);
+            if (cachedCurrent(dbPath, timeEc, sizeEc, nowWriteTime, nowFileSize, cached))
+                return cached->rejected ? nullptr : cached;
+            config = loadConfigFor(dbPath);
+        }
+        auto entry = std::make_shared<CachedFeatureDb>();
+        if (!timeEc)
+        {
+            entry->lastWriteTime = nowWriteTime;
+        }
+        if (!sizeEc)
+        {
+            entry->fileSize = nowFileSize;
+        }
+
+        // Reject databases whose header records a different extractor setup
+        const DbMetadata *required = config.hasRequired ? &config.required : nullptr;
+        if (required)
+        {
+            DbMetadata stored;
+            std::string reason;
+            if (dbMetadata::read(dbPath, stored) && !dbMetadata::compatible(stored, *required, &reason))
             {
+                std::cout << "[MATCH] rejecting " << dbPath << ": built with a different extractor setup ("
+                          << reason << ")\n";
+                entry->rejected = true;
+                std::lock_guard<std::mutex> lock(gDbMutex);
+                publish(dbPath, config, entry);
                 return nullptr;
             }
+        }
 
-            auto &entry = gDbCache[dbPath];
-            entry.labels = std::move(dbLabels);
-            entry.data = std::move(dbData);
-            entry.loaded = true;
-            if (!timeEc)
-            {
-                entry.lastWriteTime = nowWriteTime;
-            }
-            if (!sizeEc)
-            {
-                entry.fileSize = nowFileSize;
-            }
-            return &entry;
+        // A compressed database whose codes are current is read from them alone
+        const SearchChoice &choice = config.choice;
+        if (!timeEc && !sizeEc && choice.index == PQ_INDEX && choice.params.pq.rerank == 0 &&
+            loadCompressed(dbPath, required, choice.params.pq, *entry))
+        {
+            std::lock_guard<std::mutex> lock(gDbMutex);
+            publish(dbPath, config, entry);
+            return entry;
         }
 
-        return &it->second;
+        std::vector<std::string> labels;
+        std::vector<std::vector<float>> rows;
+        if (ReadFiles::readFeaturesFromCSV(dbPath.c_str(), labels, rows) != 0 || rows.empty() ||
+            !packRows(dbPath, labels, rows, required, *entry))
+        {
+            return nullptr;
+        }
+        buildSearchIndex(dbPath, choice, *entry);
+        std::lock_guard<std::mutex> lock(gDbMutex);
+        publish(dbPath, config, entry);
+        return entry;
     }
 } // namespace
 
+/*
+FeatureMatcher::requireMetadata registers the metadata the database at dbPath must be compatible with
+and forces the next match to reload (and re-validate) it.
+*/
+void FeatureMatcher::requireMetadata(const std::string &dbPath, const DbMetadata &expected)
+{
+    std::lock_guard<std::mutex> lock(gDbMutex);
+    gRequiredMeta[dbPath] = expected;
+    gDbCache.erase(dbPath);
+    ++gConfigGeneration;
+}
+
+/*
+FeatureMatcher::setSearchIndex selects how matchKnn searches the database at dbPath and forces the next match to
+reload it, so the search structures are built (PRUNED_SCAN: LAESA pivots; HNSW_INDEX / IVF_INDEX / PQ_INDEX: the
+graph, the cells or the codes, loaded from <db>.hnsw / <db>.ivf / <db>.pq when it matches the rows, otherwise
+built and saved). enroll keeps them up to date.
+*/
+void FeatureMatcher::setSearchIndex(const std::string &dbPath, SearchIndex index, const SearchIndexParams &params)
+{
+    std::lock_guard<std::mutex> lock(gDbMutex);
+    gSearchIndex[dbPath] = SearchChoice{index, params};
+    gDbCache.erase(dbPath);
+    ++gConfigGeneration;
+}
+
+/*
+FeatureMatcher::buildIndex selects the search structure of dbPath and loads the database right away, so the
+structure is built (and an HNSW graph, IVF cells or PQ codes persisted) now rather than by the first match. Returns false if the
+database cannot be loaded.
+*/
+bool FeatureMatcher::buildIndex(const std::string &dbPath, SearchIndex index, const SearchIndexParams &params)
+{
+    setSearchIndex(dbPath, index, params);
+    return loadCachedDb(dbPath) != nullptr;
+}
+
+/*
+FeatureMatcher::searchStats returns the work done by the searches on dbPath since the last resetSearchStats.
+*/
+SearchStats FeatureMatcher::searchStats(const std::string &dbPath)
+{
+    std::lock_guard<std::mutex> lock(gDbMutex);
+    auto it = gSearchStats.find(dbPath);
+    return (it != gSearchStats.end()) ? it->second : SearchStats();
+}
+
+void FeatureMatcher::resetSearchStats(const std::string &dbPath)
+{
+    std::lock_guard<std::mutex> lock(gDbMutex);
+    gSearchStats.erase(dbPath);
+}
+
+/*
+FeatureMatcher::searchIndexToString converts a SearchIndex to its name ("linear", "pruned", "hnsw", "ivf", "pq").
+*/
+std::string FeatureMatcher::searchIndexToString(SearchIndex index)
+{
+    switch (index)
+    {
+    case LINEAR_SCAN:
+        return "linear";
+    case PRUNED_SCAN:
+        return "pruned";
+    case HNSW_INDEX:
+        return "hnsw";
+    case IVF_INDEX:
+        return "ivf";
+    case PQ_INDEX:
+        return "pq";
+    default:
+        return "Unknown";
+    }
+}
+
+/*
+FeatureMatcher::stringToSearchIndex converts an index name back to its SearchIndex (UNKNOWN_INDEX if unrecognized).
+*/
+SearchIndex FeatureMatcher::stringToSearchIndex(const std::string &name)
+{
+    if (name == "linear")
+        return LINEAR_SCAN;
+    if (name == "pruned")
+        return PRUNED_SCAN;
+    if (name == "hnsw")
+        return HNSW_INDEX;
+    if (name == "ivf")
+        return IVF_INDEX;
+    if (name == "pq")
+        return PQ_INDEX;
+    return UNKNOWN_INDEX;
+}
+
+/*
+FeatureMatcher::setMatchLogging turns the per-query "[MATCH] best ..." lines on or off (on by default);
+errors are always printed.
+*/
+void FeatureMatcher::setMatchLogging(bool enabled)
+{
+    gLogMatches = enabled;
+}
+
+/*
+FeatureMatcher::preload installs labels and rows as the cached contents of dbPath without reading the file, for
+features that are already in memory (e.g. the evaluator's benchmarks). The entry is replaced as usual once
+the file at dbPath changes. Returns false if no row has a usable dimension.
+*/
+bool FeatureMatcher::preload(const std::string &dbPath, const std::vector<std::string> &labels,
+                             const std::vector<std::vector<float>> &rows)
+{
+    if (labels.size() != rows.size())
+    {
+        return false;
+    }
+    LoadConfig config;
+    {
+        std::lock_guard<std::mutex> lock(gDbMutex);
+        config = loadConfigFor(dbPath);
+    }
+    auto entry = std::make_shared<CachedFeatureDb>();
+    if (!packRows(dbPath, labels, rows, config.hasRequired ? &config.required : nullptr, *entry))
+    {
+        return false;
+    }
+    buildSearchIndex(dbPath, config.choice, *entry);
+    stampFile(dbPath, *entry);
+    std::lock_guard<std::mutex> lock(gDbMutex);
+    publish(dbPath, config, entry);
+    return true;
+}
+
 /*
 FeatureMatcher::match performs feature matching between a target feature vector and a database of feature vectors
 using the specified distance metric. It returns true if a valid match is found and populates bestMatch
@@ -104,115 +1240,436 @@ bool FeatureMatcher::match(
     const std::string &dbPath,
     MetricType metricType,
     MatchResult &bestMatch)
+{
+    return matchKnn(targetFeatures, dbPath, metricType, 1, MIN_DISTANCE, bestMatch);
+}
+
+/*
+FeatureMatcher::matchKnn finds the k nearest database entries of the target in a single scan (the distances of
+all rows are computed with a vectorized kernel, then streamed through a bounded max-heap, so the database is
+never sorted) and aggregates their labels with vote into decision. It returns true if a valid match is found.
+*/
+bool FeatureMatcher::matchKnn(
+    const std::vector<float> &targetFeatures,
+    const std::string &dbPath,
+    MetricType metricType,
+    size_t k,
+    LabelVote vote,
+    MatchResult &decision)
 {
     // Load the feature database from cache or disk
-    const CachedFeatureDb *cachedDb = loadCachedDb(dbPath);
-    if (cachedDb == nullptr || cachedDb->data.empty())
+    const std::shared_ptr<const CachedFeatureDb> cachedDb = loadCachedDb(dbPath);
+    if (cachedDb == nullptr || cachedDb->rows() == 0)
     {
         std::cout << "[MATCH] DB load failed/empty: " << dbPath << "\n";
         return false;
     }
-    const auto &dbLabels = cachedDb->labels;
-    const auto &dbData = cachedDb->data;
-
-    // Create the appropriate distance metric object based on the specified metric type
-    auto distanceMetric = MetricFactory::create(metricType);
-    if (!distanceMetric)
+    const CachedFeatureDb &db = *cachedDb;
+    const size_t dim = static_cast<size_t>(db.dim);
+    if (targetFeatures.size() != dim)
     {
-        std::cout << "[MATCH] invalid metric for DB: " << dbPath << "\n";
+        std::cout << "[MATCH] query dimension " << targetFeatures.size() << " does not match DB dimension "
+                  << dim << ": " << dbPath << "\n";
         return false;
     }
+    const float *query = targetFeatures.data();
+    if (db.compressed && metricType != MetricType::SSD)
+    {
+        std::cout << "[MATCH] " << dbPath << " holds PQ codes only: metric "
+                  << MetricFactory::metricTypeToString(metricType) << " needs the rows (use SSD or re-ranking)\n";
+        return false;
+    }
+
+    // The k nearest rows and the nearest row of every label are collected, then voted on
+    thread_local NearestRows nearest;
+    thread_local std::vector<MatchResult> results;
+    nearest.reset(k, db.labelNames.size());
+    SearchStats stats;
+    stats.queries = 1;
+    stats.rows = db.rows();
 
-    // Baseline uses scaled Euclidean distance:
-    // d(x,y)=sqrt(sum_i ((x_i-y_i)^2 / sigma_i^2)),
-    // where sigma_i is std-dev of dimension i over DB.
-    std::vector<double> invStd;
-    if (metricType == MetricType::SSD)
+    // The metric is resolved once per query; each branch computes the distances to all rows with a vectorized
+    // kernel specialized for the metric and the dimension (see distanceKernels.hpp)
+    const int n = static_cast<int>(dim);
+    thread_local std::vector<float> distances;
+    distances.resize(db.rows());
+    bool collected = false;
+    switch (metricType)
     {
-        const size_t dim = targetFeatures.size();
-        if (dim == 0)
+    case MetricType::SSD:
+    {
+        // SSD uses the scaled Euclidean distance d(x,y)=sqrt(sum_i ((x_i-y_i)^2 / sigma_i^2)), where sigma_i is the
+        // std-dev of dimension i over the DB (as of the last whitening, within kWhitenDrift of the current one). The DB
+        // rows are stored whitened ((x_i - mean_i) / sigma_i), so whitening the query once turns it into a plain L2
+        // distance, which is a metric: the pruned scan relies on that.
+        if (db.pq)
         {
-            std::cout << "[MATCH] empty target feature vector\n";
-            return false;
+            pqSearch(db, query, k, nearest, stats);
+            collected = true;
+            break;
         }
-        invStd.assign(dim, 1.0);
-
-        std::vector<double> mean(dim, 0.0);
-        std::vector<double> sqMean(dim, 0.0);
-        size_t usedRows = 0;
-        for (const auto &row : dbData)
+        thread_local std::vector<float> whitenedQuery;
+        whitenedQuery.resize(dim);
+        whitenQuery(db, query, whitenedQuery.data());
+        if (db.graph)
         {
-            if (row.size() != dim)
-                continue;
-            ++usedRows;
-            for (size_t i = 0; i < dim; ++i)
-            {
-                const double v = row[i];
-                mean[i] += v;
-                sqMean[i] += v * v;
-            }
+            graphSearch(db, whitenedQuery.data(), k, nearest, stats);
+            collected = true;
+            break;
         }
-        if (usedRows == 0)
+        if (db.cells)
         {
-            std::cout << "[MATCH] no compatible DB rows (dimension mismatch)\n";
-            return false;
+            cellSearch(db, query, whitenedQuery.data(), nearest, stats);
+            collected = true;
+            break;
         }
-        for (size_t i = 0; i < dim; ++i)
+        if (!db.pivotRows.empty())
         {
-            mean[i] /= static_cast<double>(usedRows);
-            sqMean[i] /= static_cast<double>(usedRows);
-            const double var = std::max(0.0, sqMean[i] - mean[i] * mean[i]);
-            const double sigma = std::sqrt(var);
-            // Avoid exploding weights on nearly-constant dimensions.
-            invStd[i] = (sigma > 1e-6) ? (1.0 / sigma) : 1.0;
+            prunedScan(db, whitenedQuery.data(), nearest, stats);
+            collected = true;
+            break;
         }
+        distanceKernels::computeMany(distanceKernels::ScaledSSD(), whitenedQuery.data(), db.whitenedRow(0), db.rows(), n,
+                                     distances.data());
+        break;
+    }
+    case MetricType::COSINE:
+        distanceKernels::cosineMany(query, db.row(0), db.norms.data(), db.rows(), n, distances.data());
+        break;
+    case MetricType::HIST_INTERSECTION:
+        distanceKernels::computeMany(distanceKernels::HistIntersection(), query, db.row(0), db.rows(), n, distances.data());
+        break;
+    default:
+        std::cout << "[MATCH] invalid metric for DB: " << dbPath << "\n";
+        return false;
+    }
+
+    if (!collected)
+    {
+        for (size_t i = 0; i < db.rows(); ++i)
+            nearest.add(i, db.labelIds[i], distances[i]);
+    }
+    {
+        std::lock_guard<std::mutex> lock(gDbMutex);
+        gSearchStats[dbPath].add(stats);
+    }
+    if (!nearest.results(db, results))
+    {
+        std::cout << "[MATCH] no finite-distance match found\n";
+        return false;
+    }
+
+    if (!FeatureMatcher::vote(results, vote, decision))
+    {
+        std::cout << "[MATCH] invalid label vote\n";
+        return false;
+    }
+    if (gLogMatches)
+    {
+        std::cout << "[MATCH] best label=" << decision.label
+                  << " dist=" << decision.distance
+                  << " metric=" << MetricFactory::metricTypeToString(metricType);
+        if (vote != MIN_DISTANCE)
+            std::cout << " vote=" << labelVoteToString(vote) << " k=" << k << " score=" << decision.score;
+        std::cout << "\n";
+    }
+    return true;
+}
+
+/*
+FeatureMatcher::vote aggregates neighbours (nearest first, as returned by matchBatch) into decision:
+- MIN_DISTANCE: decision is the nearest neighbour; score and secondScore are the negated distances of the
+  nearest entry and of the nearest entry of another label, so voteMargin() equals margin().
+- MAJORITY_VOTE / WEIGHTED_VOTE: every neighbour adds 1 (majority) or 1 / distance (weighted) to its label.
+  The highest score wins, ties going to the label whose nearest neighbour comes first. decision carries
+  the winner's nearest neighbour (label, distance, secondDistance), the runner-up label and both scores; the
+  runner-up of a unanimous vote is the nearest other label outside the k, with score 0.
+Labels are tallied in a small list, as k is small. Returns false for an empty list or an unknown vote.
+*/
+bool FeatureMatcher::vote(const std::vector<MatchResult> &neighbours, LabelVote vote, MatchResult &decision)
+{
+    if (neighbours.empty())
+    {
+        return false;
+    }
+    const MatchResult &nearest = neighbours[0];
+    if (vote == MIN_DISTANCE)
+    {
+        decision = nearest;
+        decision.score = -nearest.distance;
+        decision.secondScore = -nearest.secondDistance;
+        return true;
     }
-    // Iterate through the database and compute distances to find the best match based on the specified metric
-    bool found = false;
-    MatchResult best{"", "", 0.0f};
-    for (size_t i = 0; i < dbData.size(); ++i)
+    if (vote != MAJORITY_VOTE && vote != WEIGHTED_VOTE)
     {
-        float distance = std::numeric_limits<float>::infinity();
+        return false;
+    }
+
+    // Distances below this count as this close, so an exact duplicate does not get an infinite weight
+    constexpr float kMinVoteDistance = 1e-6f;
+    struct Tally
+    {
+        const MatchResult *nearest; // first (nearest) neighbour of the label
+        float score;
+    };
+    std::vector<Tally> tallies;
+    for (const MatchResult &n : neighbours)
+    {
+        const float weight = (vote == MAJORITY_VOTE) ? 1.0f : 1.0f / std::max(n.distance, kMinVoteDistance);
+        auto it = std::find_if(tallies.begin(), tallies.end(), [&n](const Tally &t)
+                               { return t.nearest->label == n.label; });
+        if (it == tallies.end())
+            it = tallies.insert(tallies.end(), Tally{&n, 0.0f});
+        it->score += weight;
+    }
+    size_t winner = 0;
+    for (size_t i = 1; i < tallies.size(); ++i)
+    {
+        if (tallies[i].score > tallies[winner].score)
+            winner = i;
+    }
+    size_t runnerUp = tallies.size();
+    for (size_t i = 0; i < tallies.size(); ++i)
+    {
+        if (i != winner && (runnerUp == tallies.size() || tallies[i].score > tallies[runnerUp].score))
+            runnerUp = i;
+    }
+
+    decision = *tallies[winner].nearest;
+    decision.score = tallies[winner].score;
+    if (runnerUp < tallies.size())
+    {
+        decision.secondLabel = tallies[runnerUp].nearest->label;
+        decision.secondScore = tallies[runnerUp].score;
+    }
+    else
+    {
+        decision.secondScore = 0.0f;
+    }
+    return true;
+}
+
+/*
+FeatureMatcher::labelVoteToString converts a LabelVote to its name ("min", "majority", "weighted").
+*/
+std::string FeatureMatcher::labelVoteToString(LabelVote vote)
+{
+    switch (vote)
+    {
+    case MIN_DISTANCE:
+        return "min";
+    case MAJORITY_VOTE:
+        return "majority";
+    case WEIGHTED_VOTE:
+        return "weighted";
+    default:
+        return "Unknown";
+    }
+}
+
+/*
+FeatureMatcher::stringToLabelVote converts a vote name back to its LabelVote (UNKNOWN_VOTE if unrecognized).
+*/
+LabelVote FeatureMatcher::stringToLabelVote(const std::string &name)
+{
+    if (name == "min")
+        return MIN_DISTANCE;
+    if (name == "majority")
+        return MAJORITY_VOTE;
+    if (name == "weighted")
+        return WEIGHTED_VOTE;
+    return UNKNOWN_VOTE;
+}
+
+/*
+FeatureMatcher::matchBatch matches every row of queries (m x dim, CV_32F) against the database at dbPath and
+fills results[q] with the k nearest rows of query q, nearest first (empty if query q has no finite distance).
+SSD and cosine distances of all queries are computed together, chunk by chunk of database rows, as one
+blocked matrix product (distanceKernels::dotBatch): L2 as |q|^2 + |x|^2 - 2 q.x over the whitened rows, cosine
+as the dot product divided by the cached norms. Histogram intersection has no product form and runs the
+per-query kernel on each chunk. Each chunk's distances stream into a bounded selection per query, so memory
+stays at m x kChunkRows floats whatever the database size. A compressed PQ database (SSD only) is searched
+query by query from its codes. Returns false if the database cannot be used.
+*/
+bool FeatureMatcher::matchBatch(
+    const cv::Mat &queries,
+    const std::string &dbPath,
+    MetricType metricType,
+    size_t k,
+    std::vector<std::vector<MatchResult>> &results)
+{
+    results.clear();
+    const std::shared_ptr<const CachedFeatureDb> cachedDb = loadCachedDb(dbPath);
+    if (cachedDb == nullptr || cachedDb->rows() == 0)
+    {
+        std::cout << "[MATCH] DB load failed/empty: " << dbPath << "\n";
+        return false;
+    }
+    const CachedFeatureDb &db = *cachedDb;
+    const int n = db.dim;
+    if (queries.rows > 0 && (queries.type() != CV_32F || queries.cols != n || !queries.isContinuous()))
+    {
+        std::cout << "[MATCH] query batch is not a continuous CV_32F matrix of " << n << " columns: " << dbPath << "\n";
+        return false;
+    }
+    if (metricType != MetricType::SSD && metricType != MetricType::COSINE && metricType != MetricType::HIST_INTERSECTION)
+    {
+        std::cout << "[MATCH] invalid metric for DB: " << dbPath << "\n";
+        return false;
+    }
+    if (db.compressed && metricType != MetricType::SSD)
+    {
+        std::cout << "[MATCH] " << dbPath << " holds PQ codes only: metric "
+                  << MetricFactory::metricTypeToString(metricType) << " needs the rows (use SSD or re-ranking)\n";
+        return false;
+    }
+    const size_t m = static_cast<size_t>(std::max(0, queries.rows));
+    const size_t dim = static_cast<size_t>(n);
+    results.resize(m);
+    if (m == 0)
+        return true;
+
+    const float *batch = queries.ptr<float>(0);
+    constexpr size_t kChunkRows = 4096;
+    thread_local std::vector<NearestRows> nearest;
+    nearest.resize(m);
+    for (auto &collector : nearest)
+        collector.reset(k, db.labelNames.size());
+
+    // A compressed database has no rows to multiply: each query is one pass over the codes
+    if (db.compressed)
+    {
+        SearchStats stats;
+        for (size_t q = 0; q < m; ++q)
+            pqSearch(db, batch + q * dim, k, nearest[q], stats);
+    }
+    else
+    {
+        // SSD matches in the whitened space of the rows
+        thread_local std::vector<float> whitened;
+        thread_local std::vector<float> tile;
         if (metricType == MetricType::SSD)
         {
-            // For SSD, compute the scaled Euclidean distance using the precomputed inverse standard deviations
-            if (dbData[i].size() != targetFeatures.size())
-                continue;
-            double acc = 0.0;
-            for (size_t k = 0; k < targetFeatures.size(); ++k)
-            {
-                const double diff = static_cast<double>(targetFeatures[k]) - static_cast<double>(dbData[i][k]);
-                const double z = diff * invStd[k];
-                acc += z * z;
-            }
-            distance = static_cast<float>(std::sqrt(acc));
-        }
-        else
-        {
-            distance = distanceMetric->compute(targetFeatures, dbData[i]);
+            whitened.resize(m * dim);
+            for (size_t q = 0; q < m; ++q)
+                whitenQuery(db, batch + q * dim, whitened.data() + q * dim);
+            batch = whitened.data();
         }
-        if (!std::isfinite(distance))
+        tile.resize(m * std::min(kChunkRows, db.rows()));
+        for (size_t start = 0; start < db.rows(); start += kChunkRows)
         {
-            continue;
+            const size_t count = std::min(kChunkRows, db.rows() - start);
+            switch (metricType)
+            {
+            case MetricType::SSD:
+                distanceKernels::euclideanBatch(batch, m, db.whitenedRow(start), db.whitenedSquaredNorms.data() + start,
+                                                count, n, tile.data());
+                break;
+            case MetricType::COSINE:
+                distanceKernels::cosineBatch(batch, m, db.row(start), db.norms.data() + start, count, n, tile.data());
+                break;
+            default:
+                for (size_t q = 0; q < m; ++q)
+                    distanceKernels::computeMany(distanceKernels::HistIntersection(), batch + q * dim, db.row(start), count,
+                                                 n, tile.data() + q * count);
+                break;
+            }
+            for (size_t q = 0; q < m; ++q)
+            {
+                const float *line = tile.data() + q * count;
+                for (size_t i = 0; i < count; ++i)
+                    nearest[q].add(start + i, db.labelIds[start + i], line[i]);
+            }
         }
-        if (!found || distance < best.distance)
+    }
+
+    for (size_t q = 0; q < m; ++q)
+    {
+        if (nearest[q].results(db, results[q]) && gLogMatches)
         {
-            // Update the best match if this is the first valid match found or if the distance is smaller than the current best
-            found = true;
-            best.label = dbLabels[i];
-            best.filename = dbLabels[i];
-            best.distance = distance;
+            std::cout << "[MATCH] best label=" << results[q][0].label
+                      << " dist=" << results[q][0].distance
+                      << " metric=" << MetricFactory::metricTypeToString(metricType) << "\n";
         }
     }
-    if (!found)
+    return true;
+}
+
+/*
+FeatureMatcher::enroll appends one labeled feature vector (label taken from savedPath, as in the CSV writer)
+to the database file and folds it into the cached copy: the row is appended to the matrix (in place while its
+buffer has room), the per-dimension statistics are updated with one Welford step and only the new row is
+whitened, with the frozen statistics; all rows are whitened again only when the statistics have drifted past
+kWhitenDrift. An enrollment thus costs O(dim) amortized instead of a copy and re-whitening of the whole
+database under the cache lock. An HNSW graph gets the row as one more node, IVF cells add it to the posting list
+of its nearest centroid and PQ codes get its code (a compressed database stores only that code); their files are
+brought up to date by the next load. When the database is not cached yet (or was rejected) it is simply loaded
+on the next match. Returns 0 on success, -1 if the vector does not fit the cached database or the file cannot be written.
+*/
+int FeatureMatcher::enroll(const std::string &dbPath, const std::string &savedPath, const std::vector<float> &features)
+{
+    if (dbPath.empty() || features.empty())
     {
-        std::cout << "[MATCH] no finite-distance match found\n";
-        return false;
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(gDbMutex);
+    auto it = gDbCache.find(dbPath);
+    const bool cached = (it != gDbCache.end() && !it->second->rejected);
+    if (cached && static_cast<size_t>(it->second->dim) != features.size())
+    {
+        std::cout << "[MATCH] not enrolling into " << dbPath << ": dimension " << features.size()
+                  << " does not match DB dimension " << it->second->dim << "\n";
+        return -1;
     }
 
-    bestMatch = best;
-    std::cout << "[MATCH] best label=" << bestMatch.label
-              << " dist=" << bestMatch.distance
-              << " metric=" << MetricFactory::metricTypeToString(metricType) << "\n";
-    return true;
+    std::vector<float> row(features);
+    if (csvUtil::append_image_data_csv(dbPath.c_str(), savedPath.c_str(), row, 0) != 0)
+    {
+        return -1;
+    }
+    // Keep the cached row identical to what a reload would read back (the CSV stores 4 decimals)
+    for (float &v : row)
+    {
+        char text[64];
+        std::snprintf(text, sizeof(text), "%.4f", v);
+        v = std::strtof(text, nullptr);
+    }
+    if (!cached)
+    {
+        if (it != gDbCache.end())
+            gDbCache.erase(it);
+        return 0;
+    }
+
+    // Publish a new snapshot: the old one stays valid for matchers still holding it
+    const CachedFeatureDb &old = *it->second;
+    auto entry = std::make_shared<CachedFeatureDb>(old);
+    const int n = static_cast<int>(old.rows());
+    entry->labelIds.push_back(labelIdFor(*entry, csvUtil::getLabel(savedPath)));
+    if (entry->pq)
+    {
+        entry->codes.resize(entry->rows() * entry->pq->codeSize());
+        entry->pq->encode(row.data(), 1, entry->codes.data() + static_cast<size_t>(n) * entry->pq->codeSize());
+    }
+    if (entry->compressed)
+    {
+        stampFile(dbPath, *entry);
+        gDbCache[dbPath] = entry;
+        return 0;
+    }
+    entry->data.push_back(cv::Mat(1, entry->dim, CV_32F, row.data()));
+    entry->stats.add(row.data());
+    if (whiteningDrifted(*entry))
+        whiten(*entry);
+    else
+        appendWhitened(*entry);
+    entry->norms.push_back(0.0f);
+    distanceKernels::rowNorms(entry->row(n), 1, entry->dim, &entry->norms.back());
+    if (entry->graph)
+        entry->graph->insert(entry->whitenedRow(0), entry->rows(), entry->dim);
+    if (entry->cells)
+        entry->cells->insert(entry->row(0), entry->rows(), entry->dim);
+    stampFile(dbPath, *entry);
+    gDbCache[dbPath] = entry;
+    return 0;
 }
@@ -0,0 +1,70 @@
+/*
+Claire Liu, Yu-Jing Wei
+featureStats.cpp
+
+Path: src/utils/featureStats.cpp
+Description: Welford running mean / std-dev per dimension, shared by every feature standardization.
+*/
+
+#include "featureStats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/*
+reset empties the statistics and sizes them for vectors of dim floats.
+*/
+void FeatureStats::reset(int dim)
+{
+    count_ = 0;
+    mean_.assign(static_cast<size_t>(std::max(0, dim)), 0.0);
+    m2_.assign(mean_.size(), 0.0);
+}
+
+/*
+add folds one row into the statistics with Welford's update.
+*/
+void FeatureStats::add(const float *row)
+{
+    ++count_;
+    const double n = static_cast<double>(count_);
+    for (size_t k = 0; k < mean_.size(); ++k)
+    {
+        const double v = row[k];
+        const double delta = v - mean_[k];
+        mean_[k] += delta / n;
+        m2_[k] += delta * (v - mean_[k]);
+    }
+}
+
+void FeatureStats::addRows(const float *rows, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        add(rows + i * mean_.size());
+}
+
+double FeatureStats::sigma(int k) const
+{
+    if (count_ == 0)
+        return 0.0;
+    return std::sqrt(std::max(0.0, m2_[static_cast<size_t>(k)] / static_cast<double>(count_)));
+}
+
+float FeatureStats::invStd(int k) const
+{
+    const double s = sigma(k);
+    // Avoid exploding weights on nearly-constant dimensions.
+    return (s > 1e-6) ? static_cast<float>(1.0 / s) : 1.0f;
+}
+
+void FeatureStats::standardization(std::vector<float> &meanOut, std::vector<float> &invStdOut) const
+{
+    const int n = dim();
+    meanOut.resize(static_cast<size_t>(n));
+    invStdOut.resize(static_cast<size_t>(n));
+    for (int k = 0; k < n; ++k)
+    {
+        meanOut[static_cast<size_t>(k)] = static_cast<float>(mean_[static_cast<size_t>(k)]);
+        invStdOut[static_cast<size_t>(k)] = invStd(k);
+    }
+}
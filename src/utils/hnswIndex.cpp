@@ -0,0 +1,487 @@
+/*
+Claire Liu, Yu-Jing Wei
+hnswIndex.cpp
+
+Path: src/utils/hnswIndex.cpp
+Description: HNSW graph (hierarchical navigable small world) for approximate nearest-neighbour search.
+*/
+
+#include "distanceKernels.hpp"
+#include "hnswIndex.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <thread>
+
+// namespace for internal helper functions of the graph search
+namespace
+{
+    constexpr char kMagic[8] = {'R', 'T', 'O', 'R', 'H', 'N', 'S', 'W'};
+    constexpr uint32_t kFormatVersion = 1;
+    // Layers are stored in one byte per node; the expected top layer of a million rows is about 5
+    constexpr int kMaxLevel = 255;
+
+    inline float squaredDistance(const float *x, const float *y, int dim)
+    {
+        return distanceKernels::SSD().distance<0>(x, y, dim);
+    }
+
+    /*
+    VisitedSet marks the nodes one search layer has already measured. Clearing is replaced by bumping the tag,
+    so a search costs nothing for the nodes it never touches. One set per thread.
+    */
+    struct VisitedSet
+    {
+        std::vector<uint32_t> marks;
+        uint32_t tag = 0;
+
+        void reset(size_t count)
+        {
+            if (marks.size() < count)
+                marks.resize(count, 0);
+            if (++tag == 0)
+            {
+                std::fill(marks.begin(), marks.end(), 0);
+                tag = 1;
+            }
+        }
+        // Marks node, returning false if it was already marked
+        bool insert(uint32_t node)
+        {
+            if (marks[node] == tag)
+                return false;
+            marks[node] = tag;
+            return true;
+        }
+    };
+    thread_local VisitedSet tVisited;
+
+    template <class T>
+    void writeRaw(std::ofstream &out, const T *data, size_t count)
+    {
+        out.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(count * sizeof(T)));
+    }
+
+    template <class T>
+    bool readRaw(std::ifstream &in, T *data, size_t count)
+    {
+        in.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(count * sizeof(T)));
+        return static_cast<bool>(in);
+    }
+}
+
+/*
+HnswIndex constructor stores the parameters (M is raised to 2, the smallest degree the layer draw supports);
+the graph starts empty.
+*/
+HnswIndex::HnswIndex(const Params &params) : params_(params), rng_(params.seed)
+{
+    params_.M = std::max<size_t>(2, params_.M);
+    params_.efConstruction = std::max<size_t>(1, params_.efConstruction);
+}
+
+size_t HnswIndex::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return levels_.size();
+}
+
+uint32_t *HnswIndex::links(uint32_t node, int level)
+{
+    if (level == 0)
+        return links0_.data() + static_cast<size_t>(node) * (2 * params_.M + 1);
+    return upper_[node].data() + static_cast<size_t>(level - 1) * (params_.M + 1);
+}
+
+const uint32_t *HnswIndex::links(uint32_t node, int level) const
+{
+    return const_cast<HnswIndex *>(this)->links(node, level);
+}
+
+/*
+growTo makes room for nodes size()..count-1 and draws their top layer: level l is reached with probability
+M^-l, so every layer holds about 1/M of the nodes of the layer below it.
+*/
+void HnswIndex::growTo(size_t count)
+{
+    const size_t first = levels_.size();
+    if (count <= first)
+        return;
+    levels_.resize(count);
+    links0_.resize(count * (2 * params_.M + 1), 0);
+    upper_.resize(count);
+    const double levelScale = 1.0 / std::log(static_cast<double>(params_.M));
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (size_t i = first; i < count; ++i)
+    {
+        const double u = std::max(uniform(rng_), 1e-300);
+        const int level = std::min(kMaxLevel, static_cast<int>(-std::log(u) * levelScale));
+        levels_[i] = static_cast<uint8_t>(level);
+        if (level > 0)
+            upper_[i].assign(static_cast<size_t>(level) * (params_.M + 1), 0);
+    }
+}
+
+// Copies the links of node on level into out, under the node's stripe lock when locked
+void HnswIndex::copyLinks(uint32_t node, int level, bool locked, std::vector<uint32_t> &out) const
+{
+    std::unique_lock<std::mutex> lock;
+    if (locked)
+        lock = std::unique_lock<std::mutex>(nodeLocks_[node % kLockStripes]);
+    const uint32_t *list = links(node, level);
+    out.assign(list + 1, list + 1 + list[0]);
+}
+
+/*
+searchLayer is the best-first search of one layer: starting from entry, it expands the nearest unexpanded node
+and stops once that node is farther than the ef-th nearest node found. found receives the (at most ef) nearest
+nodes, nearest first; only nodes below count are visited. computed counts the distances measured.
+*/
+void HnswIndex::searchLayer(const float *rows, size_t count, const float *query, uint32_t entry,
+                            float entryDistance, size_t ef, int level, bool locked, std::vector<Candidate> &found,
+                            size_t &computed) const
+{
+    tVisited.reset(levels_.size());
+    tVisited.insert(entry);
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> frontier; // nearest on top
+    std::priority_queue<Candidate> best;                                                      // farthest on top
+    frontier.emplace(entryDistance, entry);
+    best.emplace(entryDistance, entry);
+    std::vector<uint32_t> neighbours;
+    while (!frontier.empty())
+    {
+        const Candidate current = frontier.top();
+        if (best.size() >= ef && current.first > best.top().first)
+            break;
+        frontier.pop();
+        copyLinks(current.second, level, locked, neighbours);
+        for (uint32_t n : neighbours)
+        {
+            if (n >= count || !tVisited.insert(n))
+                continue;
+            const float d = squaredDistance(query, rows + static_cast<size_t>(n) * dim_, dim_);
+            ++computed;
+            if (best.size() < ef || d < best.top().first)
+            {
+                frontier.emplace(d, n);
+                best.emplace(d, n);
+                if (best.size() > ef)
+                    best.pop();
+            }
+        }
+    }
+    found.resize(best.size());
+    for (size_t i = found.size(); i-- > 0; best.pop())
+        found[i] = best.top();
+}
+
+/*
+selectNeighbours keeps at most max of the candidates (sorted nearest first) with the HNSW heuristic: a candidate
+is kept only if it is closer to the base node than to every candidate kept before it. Links then point in
+different directions instead of into one cluster, which keeps the graph navigable between clusters.
+*/
+void HnswIndex::selectNeighbours(const float *rows, std::vector<Candidate> &candidates, size_t max) const
+{
+    if (candidates.size() <= max)
+        return;
+    std::vector<Candidate> kept;
+    kept.reserve(max);
+    for (const Candidate &c : candidates)
+    {
+        if (kept.size() >= max)
+            break;
+        const float *x = rows + static_cast<size_t>(c.second) * dim_;
+        bool diverse = true;
+        for (const Candidate &k : kept)
+        {
+            if (squaredDistance(x, rows + static_cast<size_t>(k.second) * dim_, dim_) < c.first)
+            {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse)
+            kept.push_back(c);
+    }
+    candidates.swap(kept);
+}
+
+/*
+addNode links node into the graph: a greedy descent through the layers above its own, then on each of its
+layers an efConstruction search whose diverse nearest nodes become its links, each also linking back (a full
+link list is re-pruned with the same heuristic). With locked, link lists are only touched under their stripe
+lock and the entry point under entryMutex_, so several nodes can be added at once.
+*/
+void HnswIndex::addNode(const float *rows, uint32_t node, bool locked)
+{
+    const int level = levels_[node];
+    std::unique_lock<std::mutex> top(entryMutex_, std::defer_lock);
+    if (locked)
+        top.lock();
+    const int maxLevel = maxLevel_;
+    uint32_t entry = entry_;
+    if (maxLevel < 0)
+    {
+        entry_ = node;
+        maxLevel_ = level;
+        return;
+    }
+    // A node that raises the top layer keeps the entry point locked until it is linked
+    if (locked && level <= maxLevel)
+        top.unlock();
+
+    const size_t count = levels_.size();
+    const float *query = rows + static_cast<size_t>(node) * dim_;
+    float entryDistance = squaredDistance(query, rows + static_cast<size_t>(entry) * dim_, dim_);
+    size_t computed = 0;
+    std::vector<Candidate> found;
+    for (int l = maxLevel; l > level; --l)
+    {
+        searchLayer(rows, count, query, entry, entryDistance, 1, l, locked, found, computed);
+        entry = found[0].second;
+        entryDistance = found[0].first;
+    }
+    for (int l = std::min(level, maxLevel); l >= 0; --l)
+    {
+        searchLayer(rows, count, query, entry, entryDistance, params_.efConstruction, l, locked, found, computed);
+        // Another thread may already have linked this node to one it found
+        found.erase(std::remove_if(found.begin(), found.end(), [node](const Candidate &c)
+                                   { return c.second == node; }),
+                    found.end());
+        if (found.empty())
+            continue;
+        entry = found[0].second;
+        entryDistance = found[0].first;
+        selectNeighbours(rows, found, params_.M);
+        {
+            std::unique_lock<std::mutex> lock;
+            if (locked)
+                lock = std::unique_lock<std::mutex>(nodeLocks_[node % kLockStripes]);
+            uint32_t *own = links(node, l);
+            own[0] = static_cast<uint32_t>(found.size());
+            for (size_t i = 0; i < found.size(); ++i)
+                own[1 + i] = found[i].second;
+        }
+        const size_t max = maxLinks(l);
+        for (const Candidate &c : found)
+        {
+            std::unique_lock<std::mutex> lock;
+            if (locked)
+                lock = std::unique_lock<std::mutex>(nodeLocks_[c.second % kLockStripes]);
+            uint32_t *list = links(c.second, l);
+            if (list[0] < max)
+            {
+                list[1 + list[0]] = node;
+                ++list[0];
+                continue;
+            }
+            const float *x = rows + static_cast<size_t>(c.second) * dim_;
+            std::vector<Candidate> merged;
+            merged.reserve(max + 1);
+            merged.emplace_back(c.first, node);
+            for (uint32_t i = 0; i < list[0]; ++i)
+                merged.emplace_back(squaredDistance(x, rows + static_cast<size_t>(list[1 + i]) * dim_, dim_), list[1 + i]);
+            std::sort(merged.begin(), merged.end());
+            selectNeighbours(rows, merged, max);
+            list[0] = static_cast<uint32_t>(merged.size());
+            for (size_t i = 0; i < merged.size(); ++i)
+                list[1 + i] = merged[i].second;
+        }
+    }
+    if (level > maxLevel)
+    {
+        entry_ = node;
+        maxLevel_ = level;
+    }
+}
+
+/*
+build replaces the graph with one over rows 0..count-1 (row-major, dim floats each). With more than one thread
+(0 = one per core) the rows are handed out to the threads one at a time and linked concurrently, which
+gives a graph of the same quality in a fraction of the time, though not bit-for-bit the same one.
+*/
+void HnswIndex::build(const float *rows, size_t count, int dim, unsigned threads)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    dim_ = dim;
+    levels_.clear();
+    links0_.clear();
+    upper_.clear();
+    entry_ = 0;
+    maxLevel_ = -1;
+    rng_.seed(params_.seed);
+    growTo(count);
+    if (count == 0)
+        return;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads == 1 || count < 2)
+    {
+        for (size_t i = 0; i < count; ++i)
+            addNode(rows, static_cast<uint32_t>(i), false);
+        return;
+    }
+    addNode(rows, 0, false);
+    std::atomic<size_t> next{1};
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+            addNode(rows, static_cast<uint32_t>(i), true);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool)
+        t.join();
+}
+
+/*
+insert links the rows size()..count-1 into the graph one by one. It excludes searches while it runs; a search
+that started with fewer rows never visits the new nodes.
+*/
+void HnswIndex::insert(const float *rows, size_t count, int dim)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (levels_.empty())
+        dim_ = dim;
+    if (dim != dim_ || count <= levels_.size())
+        return;
+    const size_t first = levels_.size();
+    growTo(count);
+    for (size_t i = first; i < count; ++i)
+        addNode(rows, static_cast<uint32_t>(i), false);
+}
+
+/*
+search finds approximate nearest rows of query: a greedy descent to layer 1, then a best-first search of
+layer 0 keeping ef candidates. Larger ef raises recall and cost. When the entry point is a row added after
+count (by a later insert), the search starts from row 0 on its own top layer instead.
+*/
+size_t HnswIndex::search(const float *rows, size_t count, int dim, const float *query, size_t ef,
+                         std::vector<Candidate> &out) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    out.clear();
+    count = std::min(count, levels_.size());
+    if (maxLevel_ < 0 || count == 0 || dim != dim_)
+        return 0;
+    uint32_t entry = (entry_ < count) ? entry_ : 0;
+    const int top = (entry_ < count) ? maxLevel_ : levels_[0];
+    float entryDistance = squaredDistance(query, rows + static_cast<size_t>(entry) * dim_, dim_);
+    size_t computed = 1;
+    for (int l = top; l > 0; --l)
+    {
+        searchLayer(rows, count, query, entry, entryDistance, 1, l, false, out, computed);
+        entry = out[0].second;
+        entryDistance = out[0].first;
+    }
+    searchLayer(rows, count, query, entry, entryDistance, std::max<size_t>(1, ef), 0, false, out, computed);
+    return computed;
+}
+
+/*
+save writes the graph to path (through a temporary file renamed into place, so readers never see half a file):
+a header (magic, format version, dim, node count, M, top layer, entry point, fingerprint), the layer of every
+node, the layer-0 links and the upper-layer links. Returns false on a write error.
+*/
+bool HnswIndex::save(const std::string &path, uint64_t fingerprint) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        const uint32_t dim = static_cast<uint32_t>(dim_);
+        const uint64_t count = levels_.size();
+        const uint32_t M = static_cast<uint32_t>(params_.M);
+        const int32_t maxLevel = maxLevel_;
+        writeRaw(out, kMagic, sizeof(kMagic));
+        writeRaw(out, &kFormatVersion, 1);
+        writeRaw(out, &dim, 1);
+        writeRaw(out, &count, 1);
+        writeRaw(out, &M, 1);
+        writeRaw(out, &maxLevel, 1);
+        writeRaw(out, &entry_, 1);
+        writeRaw(out, &fingerprint, 1);
+        writeRaw(out, levels_.data(), levels_.size());
+        writeRaw(out, links0_.data(), links0_.size());
+        for (const auto &upper : upper_)
+            writeRaw(out, upper.data(), upper.size());
+        if (!out.good())
+            return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+/*
+load reads a graph written by save for rows of dim floats and returns its fingerprint. The file is rejected
+(returning false, the graph unchanged) if it is unreadable, of another format, dim or M, or has links out of range.
+*/
+bool HnswIndex::load(const std::string &path, int dim, uint64_t &fingerprint)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    char magic[sizeof(kMagic)];
+    uint32_t version = 0, fileDim = 0, M = 0, entry = 0;
+    uint64_t count = 0;
+    int32_t maxLevel = -1;
+    if (!readRaw(in, magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !readRaw(in, &version, 1) || version != kFormatVersion || !readRaw(in, &fileDim, 1) ||
+        !readRaw(in, &count, 1) || !readRaw(in, &M, 1) || !readRaw(in, &maxLevel, 1) || !readRaw(in, &entry, 1) ||
+        !readRaw(in, &fingerprint, 1))
+        return false;
+    if (static_cast<int>(fileDim) != dim || M != params_.M || count == 0 || count > UINT32_MAX || entry >= count)
+        return false;
+
+    std::vector<uint8_t> levels(count);
+    std::vector<uint32_t> links0(count * (2 * params_.M + 1));
+    if (!readRaw(in, levels.data(), levels.size()) || !readRaw(in, links0.data(), links0.size()) ||
+        levels[entry] != maxLevel)
+        return false;
+    std::vector<std::vector<uint32_t>> upper(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        upper[i].resize(static_cast<size_t>(levels[i]) * (params_.M + 1));
+        if (!readRaw(in, upper[i].data(), upper[i].size()))
+            return false;
+    }
+    // Every link list must fit its slots and point at existing nodes
+    auto valid = [count](const uint32_t *list, size_t max)
+    {
+        if (list[0] > max)
+            return false;
+        for (uint32_t i = 0; i < list[0]; ++i)
+            if (list[1 + i] >= count)
+                return false;
+        return true;
+    };
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!valid(links0.data() + i * (2 * params_.M + 1), 2 * params_.M))
+            return false;
+        for (size_t l = 0; l < levels[i]; ++l)
+            if (!valid(upper[i].data() + l * (params_.M + 1), params_.M))
+                return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    dim_ = dim;
+    levels_.swap(levels);
+    links0_.swap(links0);
+    upper_.swap(upper);
+    entry_ = entry;
+    maxLevel_ = maxLevel;
+    rng_.seed(params_.seed + static_cast<unsigned>(count)); // later inserts draw fresh layers
+    return true;
+}
@@ -0,0 +1,316 @@
+/*
+Claire Liu, Yu-Jing Wei
+ivfIndex.cpp
+
+Path: src/utils/ivfIndex.cpp
+Description: Inverted-file (IVF) index: k-means cells with a posting list of row ids per cell.
+*/
+
+#include "distanceKernels.hpp"
+#include "featureStats.hpp"
+#include "ivfIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <opencv2/core.hpp>
+
+// namespace for internal helper functions of the inverted file
+namespace
+{
+    constexpr char kMagic[8] = {'R', 'T', 'O', 'R', '_', 'I', 'V', 'F'};
+    constexpr uint32_t kFormatVersion = 3;
+    // Rows assigned per batched distance computation (one rows x lists tile)
+    constexpr size_t kAssignBlock = 256;
+
+    template <class T>
+    void writeRaw(std::ofstream &out, const T *data, size_t count)
+    {
+        out.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(count * sizeof(T)));
+    }
+
+    template <class T>
+    bool readRaw(std::ifstream &in, T *data, size_t count)
+    {
+        in.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(count * sizeof(T)));
+        return static_cast<bool>(in);
+    }
+}
+
+/*
+IvfIndex constructor stores the parameters; the index starts empty.
+*/
+IvfIndex::IvfIndex(const Params &params) : params_(params)
+{
+    params_.nprobe = std::max<size_t>(1, params_.nprobe);
+    params_.iterations = std::max(1, params_.iterations);
+    params_.trainPerList = std::max<size_t>(1, params_.trainPerList);
+}
+
+size_t IvfIndex::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return rows_;
+}
+
+size_t IvfIndex::lists() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return postings_.size();
+}
+
+size_t IvfIndex::trainedRows() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return trained_;
+}
+
+/*
+standardize writes (row - mean) * invStd, the space the centroids live in, to out (dim floats).
+*/
+void IvfIndex::standardize(const float *row, float *out) const
+{
+    for (int d = 0; d < dim_; ++d)
+        out[d] = (row[d] - mean_[d]) * invStd_[d];
+}
+
+/*
+assign writes the nearest centroid of raw rows first..first+count-1 to cells. Blocks of kAssignBlock rows are
+spread over OpenCV's worker threads; each block is standardized and gets its distances to all centroids from
+one blocked matrix product (distanceKernels::euclideanBatch).
+*/
+void IvfIndex::assign(const float *rows, size_t first, size_t count, std::vector<uint32_t> &cells) const
+{
+    cells.resize(count);
+    const size_t lists = centroidSquaredNorms_.size();
+    const int blocks = static_cast<int>((count + kAssignBlock - 1) / kAssignBlock);
+    cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range &range)
+                      {
+                          std::vector<float> tile(kAssignBlock * lists), block(kAssignBlock * dim_);
+                          for (int b = range.start; b < range.end; ++b)
+                          {
+                              const size_t start = static_cast<size_t>(b) * kAssignBlock;
+                              const size_t n = std::min(kAssignBlock, count - start);
+                              for (size_t i = 0; i < n; ++i)
+                                  standardize(rows + (first + start + i) * dim_, block.data() + i * dim_);
+                              distanceKernels::euclideanBatch(block.data(), n, centroids_.data(),
+                                                              centroidSquaredNorms_.data(), lists, dim_, tile.data());
+                              for (size_t i = 0; i < n; ++i)
+                              {
+                                  const float *line = tile.data() + i * lists;
+                                  cells[start + i] = static_cast<uint32_t>(std::min_element(line, line + lists) - line);
+                              }
+                          } });
+}
+
+/*
+build replaces the index with one over rows 0..count-1 (row-major, dim floats each). The standardization uses
+every row and is kept until the next build. The centroids are trained by cv::kmeans (k-means++ seeding,
+params.iterations Lloyd steps) on at most trainPerList standardized rows per cell, drawn with a fixed seed, which
+is enough for stable centroids at a fraction of the cost. Then every row is assigned to its nearest centroid.
+Each posting list holds its row ids in increasing order.
+*/
+void IvfIndex::build(const float *rows, size_t count, int dim)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    dim_ = dim;
+    rows_ = 0;
+    trained_ = 0;
+    mean_.clear();
+    invStd_.clear();
+    centroids_.clear();
+    centroidSquaredNorms_.clear();
+    postings_.clear();
+    if (count == 0 || dim <= 0)
+        return;
+
+    FeatureStats stats;
+    stats.reset(dim);
+    stats.addRows(rows, count);
+    stats.standardization(mean_, invStd_);
+    size_t lists = params_.lists ? params_.lists : static_cast<size_t>(std::lround(std::sqrt(static_cast<double>(count))));
+    lists = std::min(std::max<size_t>(1, lists), count);
+
+    // Training sample: a partial Fisher-Yates shuffle of the row ids, standardized
+    const size_t sampleSize = std::min(count, lists * params_.trainPerList);
+    std::vector<uint32_t> ids(count);
+    std::iota(ids.begin(), ids.end(), 0u);
+    std::mt19937 rng(static_cast<unsigned>(count));
+    for (size_t i = 0; i < sampleSize; ++i)
+        std::swap(ids[i], ids[i + rng() % (count - i)]);
+    cv::Mat sample(static_cast<int>(sampleSize), dim, CV_32F);
+    for (size_t i = 0; i < sampleSize; ++i)
+        standardize(rows + static_cast<size_t>(ids[i]) * dim, sample.ptr<float>(static_cast<int>(i)));
+
+    cv::Mat labels, centers;
+    cv::TermCriteria criteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, params_.iterations, 1e-4);
+    cv::kmeans(sample, static_cast<int>(lists), labels, criteria, 1, cv::KMEANS_PP_CENTERS, centers);
+    centroids_.assign(centers.ptr<float>(0), centers.ptr<float>(0) + lists * dim);
+    centroidSquaredNorms_.resize(lists);
+    distanceKernels::rowSquaredNorms(centroids_.data(), lists, dim, centroidSquaredNorms_.data());
+
+    std::vector<uint32_t> cells;
+    assign(rows, 0, count, cells);
+    postings_.assign(lists, {});
+    for (size_t i = 0; i < count; ++i)
+        postings_[cells[i]].push_back(static_cast<uint32_t>(i));
+    rows_ = count;
+    trained_ = count;
+}
+
+/*
+insert appends the rows size()..count-1 to the posting lists of their nearest centroids, which stay as they
+are; an index that grew far beyond the rows it was trained on should be rebuilt (see trainedRows).
+*/
+void IvfIndex::insert(const float *rows, size_t count, int dim)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (postings_.empty() || dim != dim_ || count <= rows_)
+        return;
+    std::vector<uint32_t> cells;
+    assign(rows, rows_, count - rows_, cells);
+    for (size_t i = 0; i < cells.size(); ++i)
+        postings_[cells[i]].push_back(static_cast<uint32_t>(rows_ + i));
+    rows_ = count;
+}
+
+/*
+probe ranks the centroids by their distance to the standardized query and collects the row ids of the nprobe
+nearest cells, skipping ids at or above count (rows a later insert added).
+*/
+void IvfIndex::probe(const float *query, size_t count, size_t nprobe, std::vector<uint32_t> &out) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    out.clear();
+    const size_t lists = postings_.size();
+    if (lists == 0)
+        return;
+    thread_local std::vector<float> standardized;
+    thread_local std::vector<float> distances;
+    thread_local std::vector<uint32_t> order;
+    standardized.resize(dim_);
+    standardize(query, standardized.data());
+    distances.resize(lists);
+    distanceKernels::computeMany(distanceKernels::SSD(), standardized.data(), centroids_.data(), lists, dim_,
+                                 distances.data());
+    nprobe = std::min(std::max<size_t>(1, nprobe), lists);
+    order.resize(lists);
+    std::iota(order.begin(), order.end(), 0u);
+    std::partial_sort(order.begin(), order.begin() + nprobe, order.end(), [](uint32_t a, uint32_t b)
+                      { return distances[a] < distances[b]; });
+    for (size_t p = 0; p < nprobe; ++p)
+    {
+        for (uint32_t id : postings_[order[p]])
+        {
+            if (id < count)
+                out.push_back(id);
+        }
+    }
+}
+
+/*
+save writes the index to path (through a temporary file renamed into place): a header (magic, format version,
+dim, cell count, row count, trained row count, fingerprint), the standardization, the centroids, then each posting list as its length and row ids.
+Returns false on a write error.
+*/
+bool IvfIndex::save(const std::string &path, uint64_t fingerprint) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        const uint32_t dim = static_cast<uint32_t>(dim_);
+        const uint64_t lists = postings_.size();
+        const uint64_t rows = rows_;
+        const uint64_t trained = trained_;
+        writeRaw(out, kMagic, sizeof(kMagic));
+        writeRaw(out, &kFormatVersion, 1);
+        writeRaw(out, &dim, 1);
+        writeRaw(out, &lists, 1);
+        writeRaw(out, &rows, 1);
+        writeRaw(out, &trained, 1);
+        writeRaw(out, &fingerprint, 1);
+        writeRaw(out, mean_.data(), mean_.size());
+        writeRaw(out, invStd_.data(), invStd_.size());
+        writeRaw(out, centroids_.data(), centroids_.size());
+        for (const auto &posting : postings_)
+        {
+            const uint64_t length = posting.size();
+            writeRaw(out, &length, 1);
+            writeRaw(out, posting.data(), posting.size());
+        }
+        if (!out.good())
+            return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+/*
+load reads an index written by save for rows of dim floats and returns its fingerprint. The file is rejected
+(returning false, the index unchanged) if it is unreadable, of another format or dim, or its posting lists do
+not hold every row id exactly once.
+*/
+bool IvfIndex::load(const std::string &path, int dim, uint64_t &fingerprint)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    char magic[sizeof(kMagic)];
+    uint32_t version = 0, fileDim = 0;
+    uint64_t lists = 0, rows = 0, trained = 0;
+    if (!readRaw(in, magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !readRaw(in, &version, 1) || version != kFormatVersion || !readRaw(in, &fileDim, 1) ||
+        !readRaw(in, &lists, 1) || !readRaw(in, &rows, 1) || !readRaw(in, &trained, 1) ||
+        !readRaw(in, &fingerprint, 1))
+        return false;
+    if (static_cast<int>(fileDim) != dim || lists == 0 || lists > rows || rows > UINT32_MAX || trained == 0 ||
+        trained > rows)
+        return false;
+
+    std::vector<float> mean(fileDim), invStd(fileDim), centroids(lists * fileDim);
+    if (!readRaw(in, mean.data(), mean.size()) || !readRaw(in, invStd.data(), invStd.size()) ||
+        !readRaw(in, centroids.data(), centroids.size()))
+        return false;
+    std::vector<std::vector<uint32_t>> postings(lists);
+    std::vector<uint8_t> seen(rows, 0);
+    size_t total = 0;
+    for (auto &posting : postings)
+    {
+        uint64_t length = 0;
+        if (!readRaw(in, &length, 1) || length > rows - total)
+            return false;
+        posting.resize(length);
+        if (!readRaw(in, posting.data(), posting.size()))
+            return false;
+        for (uint32_t id : posting)
+        {
+            if (id >= rows || seen[id])
+                return false;
+            seen[id] = 1;
+        }
+        total += length;
+    }
+    if (total != rows)
+        return false;
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    dim_ = dim;
+    rows_ = rows;
+    trained_ = trained;
+    mean_.swap(mean);
+    invStd_.swap(invStd);
+    centroids_.swap(centroids);
+    postings_.swap(postings);
+    centroidSquaredNorms_.resize(lists);
+    distanceKernels::rowSquaredNorms(centroids_.data(), lists, dim, centroidSquaredNorms_.data());
+    return true;
+}
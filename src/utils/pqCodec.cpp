@@ -0,0 +1,256 @@
+/*
+Claire Liu, Yu-Jing Wei
+pqCodec.cpp
+
+Path: src/utils/pqCodec.cpp
+Description: Product-quantization codec: per-subspace k-means codebooks, 8-bit codes and ADC lookup tables.
+*/
+
+#include "distanceKernels.hpp"
+#include "featureStats.hpp"
+#include "pqCodec.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <opencv2/core.hpp>
+
+// namespace for internal helper functions of the codec
+namespace
+{
+    // Rows encoded per parallel task
+    constexpr size_t kEncodeBlock = 512;
+
+    template <class T>
+    void writeRaw(std::ostream &out, const T *data, size_t count)
+    {
+        out.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(count * sizeof(T)));
+    }
+
+    template <class T>
+    bool readRaw(std::istream &in, T *data, size_t count)
+    {
+        in.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(count * sizeof(T)));
+        return static_cast<bool>(in);
+    }
+}
+
+/*
+PqCodec constructor stores the parameters; the codec is untrained until train or read.
+*/
+PqCodec::PqCodec(const Params &params) : params_(params)
+{
+    params_.iterations = std::max(1, params_.iterations);
+    params_.trainRows = std::max<size_t>(1, params_.trainRows);
+}
+
+/*
+subspacesFor returns the number of subspaces train splits dim dimensions into: params.subspaces, or dim / 8
+when it is 0, and never more than dim.
+*/
+size_t PqCodec::subspacesFor(int dim) const
+{
+    if (dim <= 0)
+        return 0;
+    return std::min<size_t>(dim, params_.subspaces ? params_.subspaces : std::max(1, dim / 8));
+}
+
+/*
+standardize writes (row - mean) * invStd, the space the codebooks live in, to out (dim floats).
+*/
+void PqCodec::standardize(const float *row, float *out) const
+{
+    for (int d = 0; d < dim_; ++d)
+        out[d] = (row[d] - mean_[d]) * invStd_[d];
+}
+
+/*
+train learns the codec from rows 0..count-1 (row-major, dim floats each). The standardization uses every row;
+the codebooks are trained on at most trainRows of them, drawn with a fixed seed. Each subspace gets its own
+cv::kmeans run (k-means++ seeding, params.iterations Lloyd steps), and the runs are spread over OpenCV's
+worker threads. Dimensions are split as evenly as possible, so dim need not be a multiple of M.
+*/
+void PqCodec::train(const float *rows, size_t count, int dim)
+{
+    dim_ = 0;
+    bounds_.clear();
+    codebooks_.clear();
+    if (count == 0 || dim <= 0)
+        return;
+    const size_t subspaces = subspacesFor(dim);
+    bounds_.resize(subspaces + 1);
+    for (size_t m = 0; m <= subspaces; ++m)
+        bounds_[m] = static_cast<int>(m * dim / subspaces);
+
+    FeatureStats stats;
+    stats.reset(dim);
+    stats.addRows(rows, count);
+    stats.standardization(mean_, invStd_);
+    dim_ = dim;
+    trainedRows_ = count;
+
+    // Training sample: a partial Fisher-Yates shuffle of the row ids, standardized
+    const size_t sampleSize = std::min(count, params_.trainRows);
+    std::vector<uint32_t> ids(count);
+    std::iota(ids.begin(), ids.end(), 0u);
+    std::mt19937 rng(static_cast<unsigned>(count));
+    for (size_t i = 0; i < sampleSize; ++i)
+        std::swap(ids[i], ids[i + rng() % (count - i)]);
+    std::vector<float> sample(sampleSize * dim);
+    for (size_t i = 0; i < sampleSize; ++i)
+        standardize(rows + static_cast<size_t>(ids[i]) * dim, sample.data() + i * dim);
+
+    centroids_ = std::min(kCentroids, sampleSize);
+    codebooks_.assign(kCentroids * dim, 0.0f);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(subspaces)), [&](const cv::Range &range)
+                      {
+                          for (int m = range.start; m < range.end; ++m)
+                          {
+                              const int begin = bounds_[m];
+                              const int width = bounds_[m + 1] - begin;
+                              cv::Mat sub(static_cast<int>(sampleSize), width, CV_32F);
+                              for (size_t i = 0; i < sampleSize; ++i)
+                                  std::memcpy(sub.ptr<float>(static_cast<int>(i)), sample.data() + i * dim + begin, width * sizeof(float));
+                              cv::Mat labels, centers;
+                              cv::TermCriteria criteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, params_.iterations, 1e-4);
+                              cv::kmeans(sub, static_cast<int>(centroids_), labels, criteria, 1, cv::KMEANS_PP_CENTERS, centers);
+                              std::memcpy(codebooks_.data() + kCentroids * begin, centers.ptr<float>(0), centroids_ * width * sizeof(float));
+                          } });
+}
+
+/*
+encode writes the code of each of rows 0..count-1 to codes (codeSize() bytes per row): per subspace, the index
+of the nearest centroid to the standardized sub-vector. Blocks of rows are spread over OpenCV's worker threads.
+*/
+void PqCodec::encode(const float *rows, size_t count, uint8_t *codes) const
+{
+    if (!trained() || count == 0)
+        return;
+    const size_t subspaces = codeSize();
+    const int blocks = static_cast<int>((count + kEncodeBlock - 1) / kEncodeBlock);
+    cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range &range)
+                      {
+                          std::vector<float> row(dim_), distances(centroids_);
+                          for (int b = range.start; b < range.end; ++b)
+                          {
+                              const size_t end = std::min(count, (static_cast<size_t>(b) + 1) * kEncodeBlock);
+                              for (size_t i = static_cast<size_t>(b) * kEncodeBlock; i < end; ++i)
+                              {
+                                  standardize(rows + i * dim_, row.data());
+                                  for (size_t m = 0; m < subspaces; ++m)
+                                  {
+                                      const int begin = bounds_[m];
+                                      distanceKernels::computeMany(distanceKernels::SSD(), row.data() + begin,
+                                                                   codebooks_.data() + kCentroids * begin, centroids_,
+                                                                   bounds_[m + 1] - begin, distances.data());
+                                      codes[i * subspaces + m] = static_cast<uint8_t>(
+                                          std::min_element(distances.begin(), distances.end()) - distances.begin());
+                                  }
+                              }
+                          } });
+}
+
+/*
+lookupTable fills table (codeSize() x kCentroids floats) with the squared distances from the standardized query
+to every centroid of every subspace. Entries of unused centroids are set to the largest float.
+*/
+void PqCodec::lookupTable(const float *query, float *table) const
+{
+    if (!trained())
+        return;
+    thread_local std::vector<float> standardized;
+    standardized.resize(dim_);
+    standardize(query, standardized.data());
+    for (size_t m = 0; m < codeSize(); ++m)
+    {
+        const int begin = bounds_[m];
+        float *line = table + m * kCentroids;
+        distanceKernels::computeMany(distanceKernels::SSD(), standardized.data() + begin,
+                                     codebooks_.data() + kCentroids * begin, centroids_, bounds_[m + 1] - begin, line);
+        std::fill(line + centroids_, line + kCentroids, std::numeric_limits<float>::max());
+    }
+}
+
+/*
+adc writes the approximate squared distances of codes 0..count-1 (codeSize() bytes each) to out: the sum over
+subspaces of table[m][code[m]]. Four subspaces are summed per step into independent accumulators.
+*/
+void PqCodec::adc(const float *table, const uint8_t *codes, size_t count, float *out) const
+{
+    const size_t subspaces = codeSize();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t *code = codes + i * subspaces;
+        float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+        size_t m = 0;
+        for (; m + 4 <= subspaces; m += 4)
+        {
+            a0 += table[m * kCentroids + code[m]];
+            a1 += table[(m + 1) * kCentroids + code[m + 1]];
+            a2 += table[(m + 2) * kCentroids + code[m + 2]];
+            a3 += table[(m + 3) * kCentroids + code[m + 3]];
+        }
+        for (; m < subspaces; ++m)
+            a0 += table[m * kCentroids + code[m]];
+        out[i] = (a0 + a1) + (a2 + a3);
+    }
+}
+
+/*
+write appends the codec to out: dim, subspace count, centroids per subspace, trained row count, the subspace
+bounds, the standardization and the codebooks. Returns false on a write error.
+*/
+bool PqCodec::write(std::ostream &out) const
+{
+    const uint32_t dim = static_cast<uint32_t>(dim_);
+    const uint32_t subspaces = static_cast<uint32_t>(codeSize());
+    const uint32_t centroids = static_cast<uint32_t>(centroids_);
+    const uint64_t trainedRows = trainedRows_;
+    writeRaw(out, &dim, 1);
+    writeRaw(out, &subspaces, 1);
+    writeRaw(out, &centroids, 1);
+    writeRaw(out, &trainedRows, 1);
+    writeRaw(out, bounds_.data(), bounds_.size());
+    writeRaw(out, mean_.data(), mean_.size());
+    writeRaw(out, invStd_.data(), invStd_.size());
+    writeRaw(out, codebooks_.data(), codebooks_.size());
+    return out.good();
+}
+
+/*
+read loads a codec written by write for vectors of dim floats. It is rejected (returning false, the codec
+unchanged) if it is unreadable, of another dim, or its subspace bounds do not partition the dimensions.
+*/
+bool PqCodec::read(std::istream &in, int dim)
+{
+    uint32_t fileDim = 0, subspaces = 0, centroids = 0;
+    uint64_t trainedRows = 0;
+    if (!readRaw(in, &fileDim, 1) || !readRaw(in, &subspaces, 1) || !readRaw(in, &centroids, 1) ||
+        !readRaw(in, &trainedRows, 1))
+        return false;
+    if (dim <= 0 || static_cast<int>(fileDim) != dim || subspaces == 0 || subspaces > fileDim ||
+        centroids == 0 || centroids > kCentroids || trainedRows < centroids)
+        return false;
+    std::vector<int> bounds(subspaces + 1);
+    std::vector<float> mean(dim), invStd(dim), codebooks(kCentroids * dim);
+    if (!readRaw(in, bounds.data(), bounds.size()) || !readRaw(in, mean.data(), mean.size()) ||
+        !readRaw(in, invStd.data(), invStd.size()) || !readRaw(in, codebooks.data(), codebooks.size()))
+        return false;
+    if (bounds.front() != 0 || bounds.back() != dim)
+        return false;
+    for (size_t m = 0; m < subspaces; ++m)
+    {
+        if (bounds[m + 1] <= bounds[m])
+            return false;
+    }
+    dim_ = dim;
+    centroids_ = centroids;
+    trainedRows_ = static_cast<size_t>(trainedRows);
+    bounds_.swap(bounds);
+    mean_.swap(mean);
+    invStd_.swap(invStd);
+    codebooks_.swap(codebooks);
+    return true;
+}
@@ -11,6 +11,7 @@ Description: Command line interface for the pre-trainer.
 #include <getopt.h>
 #include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 
 /*
 parseCLI parses the command line arguments for the pre-trainer and populates the provided references with the parsed values.
@@ -20,6 +21,7 @@ parseCLI parses the command line arguments for the pre-trainer and populates the
 - @param extractorType Reference to an ExtractorType that will be set to the parsed extractor type.
 - @param outputBase Reference to a string that will be set to the output CSV file path.
 - @param modelPath Optional pointer to a string that will be set to the CNN model path if provided.
+- @param parsedArgs Optional pointer that receives all parsed arguments (e.g. CNN thread counts).
 - @return 0 on success, -1 on failure (e.g., missing required arguments or unknown extractor type).
 */
 int PreTrainerCLI::parseCLI(
@@ -27,7 +29,8 @@ int PreTrainerCLI::parseCLI(
     std::string &dirname,
     ExtractorType &extractorType,
     std::string &outputBase,
-    std::string *modelPath)
+    std::string *modelPath,
+    Args *parsedArgs)
 {
     // Parse command line arguments
     auto args = parse(argc, argv);
@@ -53,6 +56,10 @@ int PreTrainerCLI::parseCLI(
     {
         *modelPath = args.modelPath;
     }
+    if (parsedArgs)
+    {
+        *parsedArgs = args;
+    }
     extractorType = ExtractorFactory::stringToExtractorType(args.extractorStr.c_str());
     // Check if the extractor type is valid
     if (extractorType == UNKNOWN_EXTRACTOR)
@@ -61,6 +68,19 @@ int PreTrainerCLI::parseCLI(
         printUsage(argv[0]);
         return -1;
     }
+    if (!args.indexStr.empty() && args.indexStr != "hnsw" && args.indexStr != "ivf" &&
+        args.indexStr != "pq")
+    {
+        printf("Error: unknown index type.\n\n");
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (!args.int8ModelPath.empty() && extractorType != ExtractorType::CNN)
+    {
+        printf("Error: --int8-model requires the cnn extractor.\n\n");
+        printUsage(argv[0]);
+        return -1;
+    }
     return 0; // Success
 }
 
@@ -79,13 +99,20 @@ PreTrainerCLI::Args PreTrainerCLI::parse(int argc, char *argv[])
         {"extractor", required_argument, 0, 'e'},
         {"output", required_argument, 0, 'o'},
         {"model", required_argument, 0, 'm'},
+        {"layer", required_argument, 0, 'l'},
+        {"size", required_argument, 0, 's'},
+        {"backend", required_argument, 0, 'b'},
+        {"intra-threads", required_argument, 0, 't'},
+        {"inter-threads", required_argument, 0, 'T'},
+        {"int8-model", required_argument, 0, 'q'},
+        {"index", required_argument, 0, 'x'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}};
 
     optind = 1; // reset getopt state
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "i:e:o:m:h", long_options, nullptr)) != -1)
+    while ((opt = getopt_long(argc, argv, "i:e:o:m:l:s:b:t:T:q:x:h", long_options, nullptr)) != -1)
     {
         switch (opt)
         {
@@ -103,6 +130,27 @@ PreTrainerCLI::Args PreTrainerCLI::parse(int argc, char *argv[])
         case 'm':
             args.modelPath = optarg;
             break;
+        case 'l':
+            args.layerName = optarg;
+            break;
+        case 's':
+            args.inputSize = std::atoi(optarg);
+            break;
+        case 'b':
+            args.backend = optarg;
+            break;
+        case 't':
+            args.intraOpThreads = std::atoi(optarg);
+            break;
+        case 'T':
+            args.interOpThreads = std::atoi(optarg);
+            break;
+        case 'q':
+            args.int8ModelPath = optarg;
+            break;
+        case 'x':
+            args.indexStr = optarg;
+            break;
         case 'h':
             args.showHelp = true;
             break;
@@ -121,13 +169,20 @@ Prints the usage information for the pre-trainer.
 void PreTrainerCLI::printUsage(const char *prog)
 {
     printf("usage:\n");
-    printf("  %s --input <dir> --extractor <type> --output <csv> [--model <onnx>]\n", prog);
-    printf("  %s -i <dir> -e <type> -o <csv> [-m <onnx>]\n", prog);
+    printf("  %s --input <dir> --extractor <type> --output <csv> [--model <onnx>] [--layer <name>] [--size <px>] [--backend <ort|dnn>] [--intra-threads <n>] [--inter-threads <n>] [--int8-model <onnx>] [--index hnsw|ivf|pq]\n", prog);
+    printf("  %s -i <dir> -e <type> -o <csv> [-m <onnx>] [-l <name>] [-s <px>] [-b <ort|dnn>] [-t <n>] [-T <n>] [-q <onnx>] [-x hnsw|ivf|pq]\n", prog);
     printf("\n");
     printf("options:\n");
     printf("  -i, --input      <dir>       input image directory\n");
-    printf("  -e, --extractor  <type>    baseline | cnn\n");
+    printf("  -e, --extractor  <type>    baseline | cnn | color_hist | hog\n");
     printf("  -o, --output     <csv>       output csv path\n");
     printf("  -m, --model      <onnx>      CNN model path (sets RTOR_CNN_MODEL)\n");
+    printf("  -l, --layer      <name>      CNN output used as embedding (sets RTOR_CNN_OUTPUT)\n");
+    printf("  -s, --size       <px>        CNN input size, dynamic-shape models only (sets RTOR_CNN_INPUT_SIZE)\n");
+    printf("  -b, --backend    <name>      CNN inference backend: ort | dnn (sets RTOR_CNN_BACKEND)\n");
+    printf("  -t, --intra-threads <n>      ONNX Runtime intra-op threads (sets RTOR_CNN_INTRA_THREADS)\n");
+    printf("  -T, --inter-threads <n>      ONNX Runtime inter-op threads (sets RTOR_CNN_INTER_THREADS)\n");
+    printf("  -q, --int8-model <onnx>      INT8-quantized CNN model; also builds <output>_cnn_int8.csv from the same images\n");
+    printf("  -x, --index      <name>      search index built next to the database: hnsw (<output>.hnsw) | ivf (<output>.ivf) | pq (<output>.pq)\n");
     printf("  -h, --help                 show help\n");
 }
@@ -75,6 +75,7 @@ int ReadFiles::readFilesInDir(char *dirname, std::vector<std::string> &files)
 /*
 Reads image features from a CSV file. The CSV file is expected to have a string as the first
 column (the filename) and floating point numbers as the remaining columns (the features).
+Lines starting with '#' (the metadata header) are skipped.
 The function populates the provided vectors with the filenames and their corresponding feature data.
 
 - @param filename The path to the CSV file to read.
@@ -97,7 +98,8 @@ int ReadFiles::readFeaturesFromCSV(const char *filename, std::vector<std::string
     std::string line;
     while (std::getline(ifs, line))
     {
-        if (line.empty())
+        // skip empty lines and the metadata header ("#meta,...")
+        if (line.empty() || line[0] == '#')
             continue;
 
         std::vector<std::string> tokens;
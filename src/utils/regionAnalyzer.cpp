@@ -221,19 +221,26 @@ std::vector<RegionFeatures> RegionAnalyzer::analyzeLabels(const cv::Mat &labels_
 }
 
 /*
-getShapeFeatureVector constructs a feature vector for a given region based on its geometric and second-moment features.
-It includes the percent filled, aspect ratio, and the 7 Hu invariant moments, resulting in a 9-dimensional feature vector.
+writeShapeFeatures writes the kShapeFeatureDim shape features of a region, as floats, into caller-owned storage,
+so per-frame classification needs no temporary vectors. It is the one definition of the 9-d layout: the percent
+filled, the aspect ratio and the 7 Hu invariant moments.
 */
-std::vector<double> getShapeFeatureVector(const RegionFeatures &r)
+void writeShapeFeatures(const RegionFeatures &r, float *out)
 {
-    std::vector<double> fv;
-    fv.reserve(9);
-
-    fv.push_back(r.percentFilled);
-    fv.push_back(r.aspectRatio);
+    out[0] = static_cast<float>(r.percentFilled);
+    out[1] = static_cast<float>(r.aspectRatio);
     for (int i = 0; i < 7; ++i)
     {
-        fv.push_back(r.hu[i]);
+        out[2 + i] = static_cast<float>(r.hu[i]);
     }
-    return fv;
+}
+
+/*
+getShapeFeatureVector returns the shape features of writeShapeFeatures as a vector.
+*/
+std::vector<double> getShapeFeatureVector(const RegionFeatures &r)
+{
+    float fv[kShapeFeatureDim];
+    writeShapeFeatures(r, fv);
+    return std::vector<double>(fv, fv + kShapeFeatureDim);
 }
@@ -23,8 +23,9 @@ namespace
 
 /*
 prepEmbeddingImage prepares an embedding image for a given region by performing rotation and cropping.
-It takes the input frame and region features, applies an affine transformation to align the region
-with the horizontal axis, crops the aligned region, and resizes it to the specified output size.
+It composes the rotation that aligns the region's primary axis with the horizontal axis, the crop of the
+aligned oriented bounding box and the final resize into one affine matrix, and warps only the output
+window. The per-region cost therefore depends on the output size, not on the frame size.
 The resulting embedding image is suitable for input to a CNN extractor. The function returns true if
 the preparation was successful.
 */
@@ -48,11 +49,8 @@ bool utilities::prepEmbeddingImage(
     const cv::Point2f center = region.centroid;
     const double angleDeg = -static_cast<double>(region.theta) * 180.0 / CV_PI;
     cv::Mat rotM = cv::getRotationMatrix2D(center, angleDeg, 1.0);
-    // Apply the affine transformation to the input frame to obtain a rotated image where the region is aligned horizontally
-    cv::Mat rotated;
-    cv::warpAffine(frame, rotated, rotM, frame.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
-    // Get the corners of the region's oriented bounding box (OBB) and apply the same affine transformation to them
-    // to find the corresponding axis-aligned bounding box in the rotated image
+    // Get the corners of the region's oriented bounding box (OBB) and apply the rotation to them
+    // to find the corresponding axis-aligned bounding box in the rotated frame
     cv::Point2f obbPts[4];
     region.orientedBBox.points(obbPts);
     std::array<cv::Point2f, 4> rpts = {
@@ -60,16 +58,28 @@ bool utilities::prepEmbeddingImage(
         affinePoint(rotM, obbPts[1]),
         affinePoint(rotM, obbPts[2]),
         affinePoint(rotM, obbPts[3])};
-    // Compute the axis-aligned bounding box of the transformed OBB corners to determine the cropping region in the rotated image
+    // Compute the axis-aligned bounding box of the transformed OBB corners to determine the cropping region,
+    // limited to the extent of the (same-sized) rotated frame
     std::vector<cv::Point2f> pts(rpts.begin(), rpts.end());
-    cv::Rect roi = cv::boundingRect(pts) & cv::Rect(0, 0, rotated.cols, rotated.rows);
+    cv::Rect roi = cv::boundingRect(pts) & cv::Rect(0, 0, frame.cols, frame.rows);
     if (roi.width <= 1 || roi.height <= 1)
     {
         return false;
     }
-    // Crop the aligned region from the rotated image and resize it to the desired output size for CNN input
-    cv::Mat cropped = rotated(roi).clone();
-    cv::resize(cropped, embImage, cv::Size(outputSize, outputSize), 0, 0, cv::INTER_LINEAR);
+
+    // Fold the crop translation and the resize (cv::resize pixel-center convention:
+    // u = (x - roi.x + 0.5) * sx - 0.5) into the rotation, so one warp produces the output directly
+    const double sx = static_cast<double>(outputSize) / roi.width;
+    const double sy = static_cast<double>(outputSize) / roi.height;
+    cv::Mat warpM(2, 3, CV_64F);
+    for (int c = 0; c < 3; ++c)
+    {
+        warpM.at<double>(0, c) = sx * rotM.at<double>(0, c);
+        warpM.at<double>(1, c) = sy * rotM.at<double>(1, c);
+    }
+    warpM.at<double>(0, 2) += (0.5 - roi.x) * sx - 0.5;
+    warpM.at<double>(1, 2) += (0.5 - roi.y) * sy - 0.5;
+    cv::warpAffine(frame, embImage, warpM, cv::Size(outputSize, outputSize), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
 
     if (debug)
     {